@@ -0,0 +1,280 @@
+#include "AllocationTracker.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <new>
+#include <ostream>
+#include <string>
+
+#if !defined(NDEBUG) && defined(__GLIBC__)
+#define CHAVACANO_ALLOCATION_SITES 1
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#else
+#define CHAVACANO_ALLOCATION_SITES 0
+#endif
+
+using namespace std;
+
+namespace {
+// Constant-initialized, so it works for allocations made before main()
+AllocationTracker tracker;
+
+thread_local AllocationCounts threadCounts;
+thread_local size_t threadScene = 0;
+
+void* allocate(size_t size) {
+    AllocationTracker::instance().record(size);
+    for (;;) {
+        if (void* memory = malloc(size == 0 ? 1 : size)) {
+            return memory;
+        }
+        new_handler handler = get_new_handler();
+        if (!handler) {
+            throw bad_alloc();
+        }
+        handler();
+    }
+}
+
+#if CHAVACANO_ALLOCATION_SITES
+// Set while backtrace() runs, since it allocates the first time it is
+// called on a thread, and while a report reads the table
+thread_local bool capturingSite = false;
+
+// Allocator plumbing says nothing about who asked for the memory
+bool isPlumbing(const string& function) {
+    for (const char* prefix : {"std::", "__gnu_cxx::", "void std::", "void* std::"}) {
+        if (function.compare(0, strlen(prefix), prefix) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Function name of `address`, or module+offset for addr2line when the binary
+// exports no symbols
+string describe(void* address) {
+    Dl_info info{};
+    if (dladdr(address, &info) == 0) {
+        return "?";
+    }
+    if (info.dli_sname) {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        string name = status == 0 && demangled ? demangled : info.dli_sname;
+        free(demangled);
+        return name;
+    }
+    const char* module = info.dli_fname ? strrchr(info.dli_fname, '/') : nullptr;
+    char offset[32];
+    snprintf(offset, sizeof offset, "+0x%zx",
+             static_cast<size_t>(static_cast<char*>(address) - static_cast<char*>(info.dli_fbase)));
+    return string(module ? module + 1 : (info.dli_fname ? info.dli_fname : "?")) + offset;
+}
+#endif
+}
+
+AllocationTracker& AllocationTracker::instance() {
+    return tracker;
+}
+
+bool AllocationTracker::tracksCallSites() {
+    return CHAVACANO_ALLOCATION_SITES != 0;
+}
+
+AllocationCounts AllocationTracker::thisThread() {
+    return threadCounts;
+}
+
+void AllocationTracker::record(size_t bytes) {
+    ++threadCounts.allocations;
+    threadCounts.bytes += bytes;
+    Scene& scene = scenes[threadScene];
+    scene.allocations.fetch_add(1, memory_order_relaxed);
+    scene.bytes.fetch_add(bytes, memory_order_relaxed);
+#if CHAVACANO_ALLOCATION_SITES
+    recordSite(bytes);
+#endif
+}
+
+void AllocationTracker::recordSite([[maybe_unused]] size_t bytes) {
+#if CHAVACANO_ALLOCATION_SITES
+    if (capturingSite) {
+        return;
+    }
+    capturingSite = true;
+    array<void*, kSiteFrames> frames{};
+    backtrace(frames.data(), static_cast<int>(frames.size()));
+    capturingSite = false;
+
+    uint64_t key = 14695981039346656037ull;
+    for (void* frame : frames) {
+        key = (key ^ reinterpret_cast<uintptr_t>(frame)) * 1099511628211ull;
+    }
+    key = max<uint64_t>(key, 1);
+    // Open addressing; once the table is full new stacks go uncounted
+    for (size_t probe = 0; probe < kMaxSites; ++probe) {
+        Site& site = sites[(key + probe) % kMaxSites];
+        uint64_t found = site.key.load(memory_order_acquire);
+        if (found == 0 && site.key.compare_exchange_strong(found, key, memory_order_acq_rel)) {
+            site.frames = frames;
+            found = key;
+        }
+        if (found == key) {
+            site.allocations.fetch_add(1, memory_order_relaxed);
+            site.bytes.fetch_add(bytes, memory_order_relaxed);
+            return;
+        }
+    }
+#endif
+}
+
+const char* AllocationTracker::enterScene(const char* scene) {
+    const char* previous = scenes[threadScene].name.load(memory_order_acquire);
+    size_t index = 0;
+    for (size_t i = 1; scene && i < kMaxScenes; ++i) {
+        const char* name = scenes[i].name.load(memory_order_acquire);
+        if (name == nullptr) {
+            if (scenes[i].name.compare_exchange_strong(name, scene, memory_order_acq_rel)) {
+                index = i;
+                break;
+            }
+        }
+        if (name == scene || strcmp(name, scene) == 0) {
+            index = i;
+            break;
+        }
+    }
+    // Beyond kMaxScenes, scenes share slot 0
+    threadScene = index;
+    return previous;
+}
+
+AllocationCounts AllocationTracker::total() const {
+    AllocationCounts counts;
+    for (const Scene& scene : scenes) {
+        counts.allocations += scene.allocations.load(memory_order_relaxed);
+        counts.bytes += scene.bytes.load(memory_order_relaxed);
+    }
+    return counts;
+}
+
+vector<pair<const char*, AllocationCounts>> AllocationTracker::sceneTotals() const {
+    vector<pair<const char*, AllocationCounts>> totals;
+    for (const Scene& scene : scenes) {
+        AllocationCounts counts;
+        counts.allocations = scene.allocations.load(memory_order_relaxed);
+        counts.bytes = scene.bytes.load(memory_order_relaxed);
+        if (counts.allocations == 0) continue;
+        const char* name = scene.name.load(memory_order_acquire);
+        totals.emplace_back(name ? name : "other", counts);
+    }
+    return totals;
+}
+
+void AllocationTracker::report(ostream& out, [[maybe_unused]] size_t topSites) const {
+    const AllocationCounts all = total();
+    out << fixed << setprecision(1);
+    out << "Allocations (count / KiB):\n";
+    for (const auto& [scene, counts] : sceneTotals()) {
+        out << "  " << scene << ": " << counts.allocations << " / " << static_cast<double>(counts.bytes) / 1024.0
+            << '\n';
+    }
+    out << "  total: " << all.allocations << " / " << static_cast<double>(all.bytes) / 1024.0 << '\n';
+#if CHAVACANO_ALLOCATION_SITES
+    // The report's own allocations would land in the table being read
+    capturingSite = true;
+    // Stacks that meet at the same caller are one call site
+    map<string, AllocationCounts> bySite;
+    for (const Site& site : sites) {
+        if (site.key.load(memory_order_acquire) == 0) continue;
+        // The caller is the first frame past operator new that is not
+        // library code
+        string caller = "?";
+        bool pastNew = false;
+        for (void* frame : site.frames) {
+            if (frame == nullptr) break;
+            const string function = describe(frame);
+            if (function.compare(0, 12, "operator new") == 0) {
+                pastNew = true;
+                caller = "?";
+            } else if (pastNew && caller == "?") {
+                caller = function;
+                if (!isPlumbing(function)) break;
+            } else if (pastNew && !isPlumbing(function)) {
+                caller = function;
+                break;
+            }
+        }
+        AllocationCounts& counts = bySite[caller];
+        counts.allocations += site.allocations.load(memory_order_relaxed);
+        counts.bytes += site.bytes.load(memory_order_relaxed);
+    }
+    vector<pair<string, AllocationCounts>> ranked(bySite.begin(), bySite.end());
+    sort(ranked.begin(), ranked.end(),
+         [](const auto& a, const auto& b) { return a.second.allocations > b.second.allocations; });
+    ranked.resize(min(ranked.size(), topSites));
+    out << "Busiest call sites:\n";
+    for (const auto& [caller, counts] : ranked) {
+        out << "  " << counts.allocations << " / " << static_cast<double>(counts.bytes) / 1024.0 << "  " << caller
+            << '\n';
+    }
+    capturingSite = false;
+#endif
+}
+
+// Replacing these four covers new and new[], with and without nothrow; the
+// aligned overloads keep the library's own versions and go uncounted
+void* operator new(size_t size) {
+    return allocate(size);
+}
+
+void* operator new[](size_t size) {
+    return allocate(size);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept {
+    try {
+        return allocate(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept {
+    try {
+        return allocate(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, const nothrow_t&) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory, const nothrow_t&) noexcept {
+    free(memory);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+struct AllocationCounts {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+
+    AllocationCounts operator-(const AllocationCounts& earlier) const {
+        return {allocations - earlier.allocations, bytes - earlier.bytes};
+    }
+};
+
+// Counts every allocation made through the global operator new, which
+// AllocationTracker.cpp replaces for the whole program. Counts are kept per
+// thread, for measuring a frame, and per scene, for the report. Debug builds
+// on glibc also record the call stack of each allocation and report the
+// busiest call sites; build with -g -rdynamic to get function names.
+//
+// malloc() called directly (by SFML's C dependencies, say) is not counted.
+class AllocationTracker {
+public:
+    static constexpr size_t kMaxScenes = 16;
+    static constexpr size_t kMaxSites = 4096;
+    static constexpr size_t kSiteFrames = 16;
+
+    static AllocationTracker& instance();
+    // False in release builds, where call sites are not recorded
+    static bool tracksCallSites();
+
+    // Everything the calling thread has allocated so far; subtract two
+    // readings to see what happened in between
+    static AllocationCounts thisThread();
+
+    // Called by operator new; allocates nothing itself
+    void record(size_t bytes);
+
+    // Allocations on the calling thread count toward `scene` (a literal)
+    // from now on; returns the scene they counted toward before
+    const char* enterScene(const char* scene);
+
+    AllocationCounts total() const;
+    // Scenes with any allocations, in the order they were first entered;
+    // "other" is everything made outside a scene
+    vector<pair<const char*, AllocationCounts>> sceneTotals() const;
+    // Totals per scene and, with call sites, the `topSites` busiest ones
+    void report(ostream& out, size_t topSites = 10) const;
+
+private:
+    struct Scene {
+        atomic<const char*> name{nullptr};
+        atomic<uint64_t> allocations{0};
+        atomic<uint64_t> bytes{0};
+    };
+    // One call stack; `key` is a hash of `frames`, 0 while the slot is free
+    struct Site {
+        atomic<uint64_t> key{0};
+        array<void*, kSiteFrames> frames{};
+        atomic<uint64_t> allocations{0};
+        atomic<uint64_t> bytes{0};
+    };
+
+    void recordSite(size_t bytes);
+
+    // Slot 0 collects allocations made outside any scene
+    array<Scene, kMaxScenes> scenes;
+    array<Site, kMaxSites> sites;
+};
+
+// Counts the calling thread's allocations toward `scene` while it lives
+class AllocationScene {
+public:
+    explicit AllocationScene(const char* scene) : previous(AllocationTracker::instance().enterScene(scene)) {}
+    ~AllocationScene() { AllocationTracker::instance().enterScene(previous); }
+    AllocationScene(const AllocationScene&) = delete;
+    AllocationScene& operator=(const AllocationScene&) = delete;
+
+private:
+    const char* previous;
+};
@@ -0,0 +1,38 @@
+#include "Arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+using namespace std;
+
+MonotonicArena::MonotonicArena(size_t blockBytes) : blockBytes(blockBytes) {
+    blocks.push_back({make_unique<byte[]>(blockBytes), blockBytes});
+}
+
+void MonotonicArena::reset() {
+    current = 0;
+    offset = 0;
+    used = 0;
+}
+
+void* MonotonicArena::do_allocate(size_t bytes, size_t alignment) {
+    for (;;) {
+        Block& block = blocks[current];
+        const uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+        const size_t start = ((base + offset + alignment - 1) & ~(uintptr_t{alignment} - 1)) - base;
+        if (start + bytes <= block.size) {
+            used += start + bytes - offset;
+            peak = max(peak, used);
+            offset = start + bytes;
+            return block.data.get() + start;
+        }
+        // The rest of this block is wasted until the next reset
+        used += block.size - offset;
+        ++current;
+        offset = 0;
+        if (current == blocks.size()) {
+            const size_t size = max(blockBytes, bytes + alignment);
+            blocks.push_back({make_unique<byte[]>(size), size});
+        }
+    }
+}
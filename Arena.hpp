@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+using namespace std;
+
+// Bump allocator for data that all dies at the same moment: a round's
+// bullets and ammo, a frame's HUD strings. Give it to pmr containers;
+// deallocation does nothing, and reset() takes everything back at once.
+//
+// Blocks come from the heap and are kept across resets, so once the arena
+// has grown to what a round or frame needs, using it never calls malloc.
+class MonotonicArena : public pmr::memory_resource {
+public:
+    explicit MonotonicArena(size_t blockBytes);
+
+    // Rewinds to empty. Anything still pointing into the arena dangles, so
+    // containers using it must be emptied or replaced first.
+    void reset();
+
+    size_t usedBytes() const { return used; }
+    // Most ever in use between two resets
+    size_t peakBytes() const { return peak; }
+    // Heap blocks taken so far; steady growth here means blockBytes is too small
+    size_t blockCount() const { return blocks.size(); }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    struct Block {
+        unique_ptr<byte[]> data;
+        size_t size = 0;
+    };
+
+    const size_t blockBytes;
+    vector<Block> blocks;
+    size_t current = 0;  // block being bumped
+    size_t offset = 0;   // into blocks[current]
+    size_t used = 0;
+    size_t peak = 0;
+};
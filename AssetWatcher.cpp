@@ -0,0 +1,165 @@
+#include "AssetWatcher.hpp"
+
+#include <iostream>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "SessionTrace.hpp"
+
+using namespace std;
+
+namespace {
+// Editors often save in several writes; a file is decoded once it has been
+// still this long
+constexpr auto kQuietPeriod = chrono::milliseconds(50);
+constexpr int kPollTimeoutMs = 20;
+
+// Directory part of a relative asset path, slash included; "" for the game directory
+string directoryOf(const string& path) {
+    const auto slash = path.rfind('/');
+    return slash == string::npos ? string() : path.substr(0, slash + 1);
+}
+}
+
+AssetWatcher::AssetWatcher() {
+#ifdef __linux__
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) {
+        cerr << "Warning: inotify is unavailable; assets will not hot-reload\n";
+        return;
+    }
+    worker = thread([this] { run(); });
+#else
+    cerr << "Warning: hot reload needs inotify (Linux); assets will not reload\n";
+#endif
+}
+
+AssetWatcher::~AssetWatcher() {
+    stopping.store(true, memory_order_release);
+    if (worker.joinable()) {
+        worker.join();
+    }
+#ifdef __linux__
+    if (inotifyFd >= 0) {
+        close(inotifyFd);
+    }
+#endif
+}
+
+void AssetWatcher::watchSheet(const string& path, bool strikes) {
+    watch(path, Watched{true, strikes});
+}
+
+void AssetWatcher::watchSound(const string& path) {
+    watch(path, Watched{false, false});
+}
+
+void AssetWatcher::watch(const string& path, const Watched& kind) {
+#ifdef __linux__
+    if (!active() || path.empty()) {
+        return;
+    }
+    lock_guard<mutex> guard(lock);
+    files[path] = kind;
+    const string directory = directoryOf(path);
+    for (const auto& [descriptor, prefix] : directories) {
+        if (prefix == directory) {
+            return;
+        }
+    }
+    // Saves land as a close after writing, or as a rename over the old file
+    const int descriptor =
+        inotify_add_watch(inotifyFd, directory.empty() ? "." : directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (descriptor < 0) {
+        cerr << "Warning: could not watch " << (directory.empty() ? "." : directory) << " for changes\n";
+        return;
+    }
+    directories[descriptor] = directory;
+#else
+    (void)path;
+    (void)kind;
+#endif
+}
+
+vector<ReloadedAsset> AssetWatcher::takeReloaded() {
+    vector<ReloadedAsset> taken;
+    lock_guard<mutex> guard(lock);
+    taken.swap(reloaded);
+    return taken;
+}
+
+void AssetWatcher::run() {
+#ifdef __linux__
+    SessionTrace::instance().nameThread("asset watcher");
+    alignas(inotify_event) char buffer[4096];
+    while (!stopping.load(memory_order_acquire)) {
+        pollfd ready{inotifyFd, POLLIN, 0};
+        if (poll(&ready, 1, kPollTimeoutMs) > 0) {
+            ssize_t length = 0;
+            while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+                for (const char* at = buffer; at < buffer + length;) {
+                    const auto* event = reinterpret_cast<const inotify_event*>(at);
+                    at += sizeof(inotify_event) + event->len;
+                    if (event->len == 0) {
+                        continue;
+                    }
+                    lock_guard<mutex> guard(lock);
+                    const auto directory = directories.find(event->wd);
+                    if (directory == directories.end()) {
+                        continue;
+                    }
+                    const string path = directory->second + event->name;
+                    if (files.count(path) > 0) {
+                        changed[path] = chrono::steady_clock::now();
+                    }
+                }
+            }
+        }
+
+        const auto now = chrono::steady_clock::now();
+        for (auto it = changed.begin(); it != changed.end();) {
+            if (now - it->second >= kQuietPeriod) {
+                decode(it->first);
+                it = changed.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+#endif
+}
+
+void AssetWatcher::decode(const string& path) {
+    Watched kind;
+    {
+        lock_guard<mutex> guard(lock);
+        kind = files[path];
+    }
+    TraceSpan span("hot reload", "load", path);
+    const auto start = chrono::steady_clock::now();
+    ReloadedAsset asset;
+    asset.path = path;
+    if (kind.sheet) {
+        DecodedSheet sheet;
+        if (!decodeSheet(path, kind.strikes, sheet)) {
+            return;
+        }
+        asset.sheet = move(sheet);
+    } else {
+        auto sound = make_unique<sf::SoundBuffer>();
+        if (!sound->loadFromFile(path)) {
+            cerr << "Warning: could not reload " << path << '\n';
+            return;
+        }
+        asset.sound = move(sound);
+    }
+    const auto elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start);
+    cout << "Reloaded " << path << " in " << elapsed.count() << " ms\n";
+
+    lock_guard<mutex> guard(lock);
+    reloaded.push_back(move(asset));
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <SFML/Audio.hpp>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+#include "CharacterSprites.hpp"
+
+// A watched file that changed on disk, already decoded
+struct ReloadedAsset {
+    string path;
+    optional<DecodedSheet> sheet;        // sprite sheets
+    unique_ptr<sf::SoundBuffer> sound;   // sound effects
+};
+
+// Development aid behind --hot-reload. Watches the directories of registered
+// assets with inotify and, once a changed file has been quiet for a moment,
+// decodes just that file on its own thread. The main thread picks results up
+// at a frame boundary, uploads textures and swaps them in. Linux only;
+// elsewhere it stays inactive.
+class AssetWatcher {
+public:
+    AssetWatcher();
+    ~AssetWatcher();
+    AssetWatcher(const AssetWatcher&) = delete;
+    AssetWatcher& operator=(const AssetWatcher&) = delete;
+
+    bool active() const { return inotifyFd >= 0; }
+    // Sheets are decoded like AnimatedSprite::load with the same `strikes`;
+    // anything else is decoded as a sound. Watching a path twice is harmless.
+    void watchSheet(const string& path, bool strikes);
+    void watchSound(const string& path);
+    // Everything decoded since the last call
+    vector<ReloadedAsset> takeReloaded();
+
+private:
+    struct Watched {
+        bool sheet = false;
+        bool strikes = false;
+    };
+
+    void watch(const string& path, const Watched& kind);
+    void run();
+    void decode(const string& path);
+
+    int inotifyFd = -1;
+    mutex lock;
+    map<int, string> directories;  // inotify watch descriptor -> directory prefix
+    map<string, Watched> files;
+    // Changed files waiting out the quiet period; worker thread only
+    map<string, chrono::steady_clock::time_point> changed;
+    vector<ReloadedAsset> reloaded;
+    atomic<bool> stopping{false};
+    thread worker;
+};
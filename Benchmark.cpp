@@ -0,0 +1,327 @@
+// Microbenchmarks for the per-frame hot paths of the stage.
+//
+// Run from the game directory (assets are loaded by their usual relative
+// paths). Results go to stdout as a table and, with --json <file>, to a
+// machine-readable file that can be diffed between builds.
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Arena.hpp"
+#include "AssetPaths.hpp"
+#include "BulletSystem.hpp"
+#include "CharacterSprites.hpp"
+#include "EnemyAi.hpp"
+#include "FighterHitTest.hpp"
+#include "HudText.hpp"
+#include "MatchLog.hpp"
+#include "ParticleSystem.hpp"
+#include "SpriteBatch.hpp"
+
+using namespace std;
+
+namespace {
+constexpr int kWarmupSamples = 3;
+constexpr int kSamples = 15;
+constexpr float kArenaWidth = 960.f;
+constexpr float kGroundY = 300.f;
+
+struct BenchResult {
+    string name;
+    int iterations = 0;
+    double medianNs = 0.0;
+    double minNs = 0.0;
+    double p90Ns = 0.0;
+};
+
+// Keeps results alive so the optimizer can't drop the measured work
+volatile size_t gSink = 0;
+
+// Times `iterations` calls of `body` per sample and reports ns per call.
+// `reset` runs between samples, outside the timed region.
+BenchResult runBenchmark(const string& name, int iterations, const function<void()>& body,
+                         const function<void()>& reset = nullptr) {
+    vector<double> samples;
+    samples.reserve(kSamples);
+    for (int s = 0; s < kWarmupSamples + kSamples; ++s) {
+        if (reset) reset();
+        const auto start = chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            body();
+        }
+        const auto end = chrono::steady_clock::now();
+        if (s >= kWarmupSamples) {
+            samples.push_back(chrono::duration<double, nano>(end - start).count() / iterations);
+        }
+    }
+    sort(samples.begin(), samples.end());
+    BenchResult result;
+    result.name = name;
+    result.iterations = iterations;
+    result.minNs = samples.front();
+    result.medianNs = samples[samples.size() / 2];
+    result.p90Ns = samples[min(samples.size() - 1, samples.size() * 9 / 10)];
+    return result;
+}
+
+void placeCharacters(CharacterSpriteManager& player, CharacterSpriteManager& enemy) {
+    player.setScale(sf::Vector2f{1.8f, 1.8f});
+    enemy.setScale(sf::Vector2f{1.8f, 1.8f});
+    player.setFacingDirection(true);
+    enemy.setFacingDirection(false);
+    player.setPosition(sf::Vector2f{300.f, kGroundY});
+    enemy.setPosition(sf::Vector2f{520.f, kGroundY});
+}
+
+// Alternating player/enemy bullets spread across the arena, all in flight
+void seedBullets(vector<Bullet>& bullets, size_t count) {
+    bullets.clear();
+    for (size_t i = 0; i < count; ++i) {
+        Bullet b;
+        b.fromPlayer = i % 2 == 0;
+        b.position = {Fixed::fromInt(static_cast<int>(i % 16) * static_cast<int>(kArenaWidth) / 16),
+                      Fixed::fromInt(static_cast<int>(kGroundY) + 120)};
+        b.velocity = Fixed::fromInt(b.fromPlayer ? 700 : -700);
+        bullets.push_back(b);
+    }
+}
+
+void writeJson(const string& path, const vector<BenchResult>& results) {
+    ofstream out(path);
+    out << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+            << ", \"samples\": " << kSamples << ", \"median_ns\": " << r.medianNs
+            << ", \"min_ns\": " << r.minNs << ", \"p90_ns\": " << r.p90Ns << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+}
+
+int main(int argc, char** argv) {
+    string jsonPath;
+    string filter;
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        if (arg == "--json" && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        } else {
+            cerr << "Usage: " << argv[0] << " [--json <file>] [--filter <substring>]\n";
+            return 2;
+        }
+    }
+
+    // Textures need a GL context; an offscreen target provides one without a window
+    sf::RenderTexture target;
+    if (!target.resize(sf::Vector2u{960u, 540u})) {
+        cerr << "Unable to create offscreen render target\n";
+        return 1;
+    }
+
+    CharacterSpriteManager player;
+    CharacterSpriteManager enemy;
+    if (!player.loadAll(true) || !enemy.loadAll(false)) {
+        cerr << "Unable to load character sheets; run from the game directory\n";
+        return 1;
+    }
+    placeCharacters(player, enemy);
+
+    sf::Texture bulletTexture;
+    sf::Vector2f bulletOrigin;
+    if (!loadBulletTexture(bulletTexture, bulletOrigin)) {
+        return 1;
+    }
+    const BulletShape bulletShape = makeBulletShape(bulletTexture, bulletOrigin);
+
+    sf::Font font;
+    const bool hasFont = font.openFromFile("/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf");
+
+    vector<BenchResult> results;
+    auto wanted = [&](const string& name) { return filter.empty() || name.find(filter) != string::npos; };
+    auto record = [&](BenchResult result) {
+        cout << result.name << ": median " << result.medianNs << " ns, min " << result.minNs << " ns, p90 "
+             << result.p90Ns << " ns (" << result.iterations << " iterations x " << kSamples << ")\n";
+        results.push_back(move(result));
+    };
+
+    if (wanted("AnimatedSprite::update")) {
+        AnimatedSprite& walk = player.walk;
+        record(runBenchmark("AnimatedSprite::update", 100000, [&] {
+            walk.update();
+            gSink += static_cast<size_t>(walk.currentFrame);
+        }));
+    }
+
+    if (wanted("CharacterSpriteManager::facingTransform")) {
+        // Turning is a flag now; the mirror is worked out per draw instead
+        bool faceLeft = false;
+        record(runBenchmark("CharacterSpriteManager::facingTransform", 100000, [&] {
+            player.setFacingDirection(faceLeft);
+            faceLeft = !faceLeft;
+            gSink += static_cast<size_t>(player.facingTransform().getMatrix()[12]);
+        }));
+        placeCharacters(player, enemy);
+    }
+
+    if (wanted("updateBullets")) {
+        vector<Bullet> bullets;
+        bullets.reserve(64);
+        size_t hits = 0;
+        // The fixed-point test the simulation runs, fighters where
+        // placeCharacters() puts them
+        const FixedVec2 playerFeet{Fixed::fromInt(300), Fixed::fromInt(static_cast<int>(kGroundY))};
+        const FixedVec2 enemyFeet{Fixed::fromInt(520), Fixed::fromInt(static_cast<int>(kGroundY))};
+        // Tiny steps keep every bullet in flight, so each iteration moves and
+        // collision-tests all 64 against both fighters
+        record(runBenchmark("updateBullets/64", 2000, [&] {
+            updateBullets(bullets, Fixed::ratio(1, 60000), Fixed::fromInt(static_cast<int>(kArenaWidth)),
+                          [&](const Bullet& b) {
+                const FixedRect bounds = bulletShape.boundsAt(b.position);
+                const bool hit = b.fromPlayer ? bodyOverlaps(enemy, enemyFeet, bounds)
+                                              : bodyOverlaps(player, playerFeet, bounds);
+                hits += hit ? 1 : 0;
+                return false;
+            });
+        }, [&] { seedBullets(bullets, 64); }));
+        gSink += hits;
+    }
+
+    if (wanted("EnemyAi")) {
+        // A crowd of gangsters spread over the arena, each after its own target
+        constexpr size_t kAgents = 1024;
+        AiAgents agents;
+        agents.resize(kAgents);
+        for (size_t i = 0; i < kAgents; ++i) {
+            agents.x[i] = Fixed::fromInt(static_cast<int>(i * 37 % static_cast<size_t>(kArenaWidth)));
+            agents.targetX[i] = Fixed::fromInt(static_cast<int>(i * 101 % static_cast<size_t>(kArenaWidth)));
+            agents.y[i] = Fixed::fromInt(static_cast<int>(kGroundY));
+            agents.targetY[i] = Fixed::fromInt(static_cast<int>(kGroundY) - static_cast<int>(i % 20));
+            agents.flags[i] = static_cast<uint8_t>(i % 16);
+        }
+        record(runBenchmark("EnemyAi decide+attack/1024 agents", 2000, [&] {
+            gangster::attack(agents);
+            gangster::decide(agents);
+            gSink += static_cast<size_t>(agents.direction[kAgents / 2] + 1);
+        }));
+    }
+
+    if (hasFont && wanted("HUD formatting")) {
+        sf::Text ammoText(font, "", 22);
+        sf::Text timerText(font, "", 30);
+        sf::Text actionLabel(font, "", 20);
+        // Formatted in a frame arena, as the stage does
+        MonotonicArena frameArena(4 * 1024);
+        int tick = 0;
+        record(runBenchmark("HUD formatting", 20000, [&] {
+            frameArena.reset();
+            ammoText.setString(formatAmmo(tick % 6, tick % 3, &frameArena).c_str());
+            timerText.setString(formatTimer(60 - tick % 61, &frameArena).c_str());
+            actionLabel.setString(formatLastAction("Player fired", &frameArena).c_str());
+            gSink += static_cast<size_t>(timerText.getLocalBounds().size.x);
+            ++tick;
+        }));
+    }
+
+    if (wanted("ParticleSystem")) {
+        ParticleSystem particles;
+        // ~20k live particles: death bursts refilled as fast as they expire
+        auto refill = [&] {
+            while (particles.liveCount() < 20000) {
+                particles.emit({ParticleEffect::DeathBurst, sf::Vector2f{480.f, 300.f}, 0.f});
+                particles.emit({ParticleEffect::MuzzleFlash, sf::Vector2f{300.f, 320.f}, 1.f});
+            }
+        };
+        record(runBenchmark("ParticleSystem update+build/20k", 200, [&] {
+            particles.update(1.f / 6000.f);
+            gSink += particles.liveCount();
+        }, refill));
+        refill();
+        record(runBenchmark("ParticleSystem draw/20k (offscreen)", 200, [&] {
+            target.clear();
+            gSink += static_cast<size_t>(particles.draw(target));
+            target.display();
+        }));
+    }
+
+    if (wanted("AnimatedSprite::load")) {
+        record(runBenchmark("AnimatedSprite::load", 5, [&] {
+            AnimatedSprite sheet;
+            gSink += sheet.load(kGangster1Walk) ? 1 : 0;
+        }));
+    }
+
+    if (wanted("Stage draw")) {
+        // Same layers as GameStage; the draw count stays put as bullets are added
+        sf::Sprite bulletSprite(bulletTexture);
+        bulletSprite.setOrigin(bulletOrigin);
+        bulletSprite.setScale(sf::Vector2f{kBulletScale, kBulletScale});
+        SpriteBatch batch;
+        for (const int bulletCount : {16, 256}) {
+            vector<Bullet> bullets;
+            seedBullets(bullets, static_cast<size_t>(bulletCount));
+            record(runBenchmark("Stage draw/" + to_string(bulletCount) + " bullets (offscreen)", 500, [&] {
+                target.clear(sf::Color(10, 10, 25));
+                for (int i = 0; i < 4; ++i) {
+                    batch.addRect(1, sf::FloatRect({10.f, 30.f}, {220.f, 24.f}), sf::Color(200, 40, 40));
+                }
+                for (const auto& b : bullets) {
+                    bulletSprite.setPosition(b.position.toFloat());
+                    batch.add(2, bulletSprite);
+                }
+                int layer = 3;
+                for (CharacterSpriteManager* fighter : {&player, &enemy}) {
+                    const sf::Sprite& sprite = *fighter->getCurrentSprite();
+                    batch.add(layer++, sprite.getTexture(), sprite.getTextureRect(),
+                              fighter->facingTransform() * sprite.getTransform(), sf::Color::White,
+                              fighter->getCurrentAnimation().paletteTexture());
+                }
+                gSink += static_cast<size_t>(batch.flush(target));
+                target.display();
+            }));
+        }
+    }
+
+    if (wanted("MatchLog summarize")) {
+        // A million synthetic matches in a scratch log, summarized from its index
+        const string base = (filesystem::temp_directory_path() / "chavacano_bench_matches").string();
+        filesystem::remove(base + ".bin");
+        filesystem::remove(base + ".idx");
+        {
+            MatchLog log(base);
+            vector<MatchRecord> records(1000000);
+            for (size_t i = 0; i < records.size(); ++i) {
+                MatchRecord& r = records[i];
+                r.playerCharacter = static_cast<uint8_t>(i % 2);
+                r.enemyCharacter = static_cast<uint8_t>(1 - i % 2);
+                r.playerWins = i % 3 == 0 ? 1 : 2;
+                r.enemyWins = i % 3 == 0 ? 2 : 1;
+                r.rounds = 3;
+                for (size_t round = 0; round < r.roundTicks.size(); ++round) {
+                    r.roundTicks[round] = static_cast<uint32_t>(600 + (i * 7 + round * 13) % 6600);
+                }
+                r.shots = {12, 10};
+                r.bulletHits = {5, 4};
+            }
+            log.append(records.data(), records.size());
+            record(runBenchmark("MatchLog summarize/1M", 5, [&] { gSink += log.summarize().matches; }));
+        }
+        filesystem::remove(base + ".bin");
+        filesystem::remove(base + ".idx");
+    }
+
+    if (!jsonPath.empty()) {
+        writeJson(jsonPath, results);
+    }
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include "BenchmarkMode.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+#include "AllocationTracker.hpp"
+#include "GameStage.hpp"
+
+using namespace std;
+
+namespace {
+float percentile(const vector<float>& sorted, float fraction) {
+    if (sorted.empty()) {
+        return 0.f;
+    }
+    const size_t index = min(sorted.size() - 1, static_cast<size_t>(fraction * static_cast<float>(sorted.size())));
+    return sorted[index];
+}
+
+long peakRssKilobytes() {
+#ifdef __linux__
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        return usage.ru_maxrss;
+    }
+#endif
+    return 0;
+}
+}
+
+int runStageBenchmark(sf::RenderWindow& window, GameContext& context, float seconds, bool failOnAllocations) {
+    StageStats stats;
+    // Generous upper bound so recording never reallocates mid-run
+    stats.frameTimes.reserve(static_cast<size_t>(seconds * 2000.f) + 1);
+
+    sf::Clock total;
+    int matches = 0;
+    while (window.isOpen()) {
+        const float remaining = seconds - total.getElapsedTime().asSeconds();
+        if (remaining <= 0.f) {
+            break;
+        }
+        // Alternate characters so both sheet sets get exercised
+        context.selectedCharacter = matches % 2 == 0 ? CharacterChoice::Gangster1 : CharacterChoice::Gangster3;
+
+        StageOptions options;
+        options.scriptedPlayer = true;
+        options.durationSeconds = remaining;
+        options.stats = &stats;
+        GameStage stage;
+        stage.run(window, context, options);
+        ++matches;
+    }
+
+    vector<float> sorted = stats.frameTimes;
+    sort(sorted.begin(), sorted.end());
+    const size_t frames = sorted.size();
+    const float elapsed = total.getElapsedTime().asSeconds();
+
+    cout << fixed << setprecision(3);
+    cout << "Benchmark: " << elapsed << " s, " << matches << " matches, " << frames << " frames";
+    if (elapsed > 0.f) {
+        cout << " (" << static_cast<float>(frames) / elapsed << " fps)";
+    }
+    cout << '\n';
+    cout << "Frame time ms: p50 " << percentile(sorted, 0.50f) * 1000.f
+         << "  p90 " << percentile(sorted, 0.90f) * 1000.f
+         << "  p99 " << percentile(sorted, 0.99f) * 1000.f
+         << "  p99.9 " << percentile(sorted, 0.999f) * 1000.f
+         << "  max " << (sorted.empty() ? 0.f : sorted.back() * 1000.f) << '\n';
+    cout << "Draw calls per frame: "
+         << (frames > 0 ? static_cast<double>(stats.drawCalls) / static_cast<double>(frames) : 0.0) << '\n';
+    cout << "Steady-state frames allocating: " << stats.allocatingFrames << " of " << stats.steadyFrames << " ("
+         << stats.steadyAllocations.allocations << " allocations, " << stats.steadyAllocations.bytes << " bytes)\n";
+    cout << "Peak RSS: " << peakRssKilobytes() / 1024.0 << " MiB\n";
+    if (failOnAllocations && stats.allocatingFrames > 0) {
+        cerr << "Error: " << stats.allocatingFrames << " steady-state frames allocated\n";
+        AllocationTracker::instance().report(cerr);
+        return 1;
+    }
+    return 0;
+}
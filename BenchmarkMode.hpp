@@ -0,0 +1,12 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+
+#include "GameContext.hpp"
+
+// Plays AI-vs-AI matches back to back for `seconds` of wall time with no
+// intro, selection or result screens, then prints frame-time percentiles,
+// draw calls per frame, steady-state allocations and peak RSS. Also the
+// training run for PGO builds. With `failOnAllocations`, returns 1 if any
+// frame after warm-up allocated and prints where the allocations came from.
+int runStageBenchmark(sf::RenderWindow& window, GameContext& context, float seconds, bool failOnAllocations = false);
@@ -0,0 +1,69 @@
+#include "BulletSystem.hpp"
+
+#include <iostream>
+
+#include "AssetPaths.hpp"
+#include "SpriteSheetAnalyzer.hpp"
+
+using namespace std;
+
+namespace {
+// Color-keys the bullet art and trims it to the opaque part; false with a
+// warning when the file is missing or blank
+bool trimBulletArt(SheetLayout& layout, sf::Vector2f& origin) {
+    sf::Image bulletImage;
+    if (!bulletImage.loadFromFile(kBulletSprite)) {
+        cerr << "Warning: could not load bullet sprite from " << kBulletSprite << '\n';
+        return false;
+    }
+    // Treat the top-left pixel as background and make it transparent
+    const sf::Color bg = bulletImage.getPixel(sf::Vector2u{0u, 0u});
+    applyColorKey(bulletImage, bg);
+    // The bullet art sits in a large empty canvas; keep just the opaque part
+    layout = analyzeSheet(bulletImage, 1);
+    if (layout.frames.empty()) {
+        cerr << "Warning: bullet sprite " << kBulletSprite << " is empty\n";
+        return false;
+    }
+    const auto offset = layout.frames.front().offset;
+    origin = sf::Vector2f{-static_cast<float>(offset.x), -static_cast<float>(offset.y)};
+    return true;
+}
+}
+
+bool loadBulletTexture(sf::Texture& texture, sf::Vector2f& origin) {
+    SheetLayout layout;
+    if (!trimBulletArt(layout, origin)) {
+        return false;
+    }
+    if (!texture.loadFromImage(layout.packed)) {
+        cerr << "Warning: could not create bullet texture from image " << kBulletSprite << '\n';
+        return false;
+    }
+    return true;
+}
+
+bool loadBulletShape(BulletShape& shape) {
+    SheetLayout layout;
+    sf::Vector2f origin;
+    if (!trimBulletArt(layout, origin)) {
+        return false;
+    }
+    shape = makeBulletShape(layout.packed.getSize(), origin);
+    return true;
+}
+
+BulletShape makeBulletShape(const sf::Texture& texture, const sf::Vector2f& origin) {
+    return makeBulletShape(texture.getSize(), origin);
+}
+
+BulletShape makeBulletShape(const sf::Vector2u& size, const sf::Vector2f& origin) {
+    // The origin is a whole-pixel trim offset, so the conversion is exact
+    constexpr Fixed scale = Fixed::fromDouble(kBulletScale);
+    BulletShape shape;
+    shape.offset = {-Fixed::fromInt(static_cast<int>(origin.x)) * scale,
+                    -Fixed::fromInt(static_cast<int>(origin.y)) * scale};
+    shape.size = {Fixed::fromInt(static_cast<int>(size.x)) * scale,
+                  Fixed::fromInt(static_cast<int>(size.y)) * scale};
+    return shape;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+#include "FixedPoint.hpp"
+
+// Bullets are retired once they are this far outside the arena
+constexpr Fixed kBulletMargin = Fixed::fromInt(50);
+// The bullet art is far bigger than a bullet on screen
+constexpr float kBulletScale = 0.05f;
+
+// Pure simulation data; the renderer draws one shared sprite at each position
+struct Bullet {
+    FixedVec2 position;  // where the sprite's origin lands
+    Fixed velocity;      // along x
+    bool fromPlayer = true;
+    bool active = true;
+};
+
+// World-space box of a bullet relative to its position, from the trimmed art
+struct BulletShape {
+    FixedVec2 offset;
+    FixedVec2 size;
+
+    FixedRect boundsAt(const FixedVec2& position) const {
+        return {position.x + offset.x, position.y + offset.y, size.x, size.y};
+    }
+};
+
+// Color-keys and trims the bullet art; `origin` keeps the trimmed sprite
+// anchored where the full canvas would have been
+bool loadBulletTexture(sf::Texture& texture, sf::Vector2f& origin);
+
+// The same art without touching the GPU, for headless simulations
+bool loadBulletShape(BulletShape& shape);
+
+BulletShape makeBulletShape(const sf::Texture& texture, const sf::Vector2f& origin);
+BulletShape makeBulletShape(const sf::Vector2u& size, const sf::Vector2f& origin);
+
+// Moves every live bullet, retires the ones that left the arena and hands the
+// rest to `resolveHit`, which applies any damage and returns true when the
+// bullet struck someone. `bullets` is any vector of Bullet, whatever its
+// allocator.
+template <typename Bullets, typename ResolveHit>
+void updateBullets(Bullets& bullets, Fixed delta, Fixed arenaWidth, ResolveHit&& resolveHit) {
+    if (bullets.empty()) {
+        return;
+    }
+    for (auto& b : bullets) {
+        if (!b.active) continue;
+        b.position.x += b.velocity * delta;
+        if (b.position.x < -kBulletMargin || b.position.x > arenaWidth + kBulletMargin) {
+            b.active = false;
+            continue;
+        }
+        if (resolveHit(b)) {
+            b.active = false;
+        }
+    }
+    bullets.erase(remove_if(bullets.begin(), bullets.end(),
+                            [](const Bullet& b) { return !b.active; }),
+                  bullets.end());
+}
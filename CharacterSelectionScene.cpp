@@ -4,30 +4,37 @@
 #include <array>
 #include <iostream>
 
+#include "AllocationTracker.hpp"
+#include "MatchStatsScene.hpp"
+#include "ResourceTracker.hpp"
+#include "SessionTrace.hpp"
+
 using namespace std;
 
 namespace {
-bool applyFirstFrame(sf::Sprite& sprite, const sf::Texture& texture) {
-    const auto size = texture.getSize();
-    if (size.y == 0 || size.x == 0) {
-        return false;
-    }
-    const int frameHeight = static_cast<int>(size.y);
-    int frameWidth = static_cast<int>(size.x);
-    if (frameHeight > 0) {
-        const int frames = max(1u, size.x / size.y);
-        frameWidth = static_cast<int>(size.x / frames);
-    }
-    sprite.setTextureRect(sf::IntRect(sf::Vector2i{0, 0}, sf::Vector2i{frameWidth, frameHeight}));
-    return true;
+void applyFirstFrame(sf::Sprite& sprite, const SheetFrame& frame) {
+    // Origin carries the trim offset so the pose sits where the full cell had it
+    sprite.setTextureRect(frame.trimmed);
+    sprite.setOrigin(sf::Vector2f{-static_cast<float>(frame.offset.x), -static_cast<float>(frame.offset.y)});
 }
 }
 
-bool CharacterSelectionScene::loadCharacterTexture(sf::Texture& texture, const string& path) {
-    if (!texture.loadFromFile(path)) {
+bool CharacterSelectionScene::loadCharacterTexture(sf::Texture& texture, SheetFrame& firstFrame, const string& path) {
+    TraceSpan span("load portrait", "load", path);
+    sf::Image sheet;
+    if (!sheet.loadFromFile(path)) {
         cerr << "Failed to load texture: " << path << '\n';
         return false;
     }
+    // Only the idle pose is shown here, so upload just that frame, trimmed
+    const SheetLayout layout = analyzeSheet(sheet);
+    if (layout.frames.empty() ||
+        !texture.loadFromImage(layout.packed, false, layout.frames.front().trimmed)) {
+        cerr << "Failed to load texture: " << path << '\n';
+        return false;
+    }
+    firstFrame = layout.frames.front();
+    firstFrame.trimmed.position = sf::Vector2i{0, 0};
     texture.setSmooth(true);
     return true;
 }
@@ -35,16 +42,22 @@ bool CharacterSelectionScene::loadCharacterTexture(sf::Texture& texture, const s
 void CharacterSelectionScene::run(sf::RenderWindow& window, GameContext& context) {
     sf::Texture gangster1Texture;
     sf::Texture gangster3Texture;
+    SheetFrame gangster1Frame;
+    SheetFrame gangster3Frame;
 
-    if (!loadCharacterTexture(gangster1Texture, kGangster1Idle) ||
-        !loadCharacterTexture(gangster3Texture, kGangster3Idle)) {
+    if (!loadCharacterTexture(gangster1Texture, gangster1Frame, kGangster1Idle) ||
+        !loadCharacterTexture(gangster3Texture, gangster3Frame, kGangster3Idle)) {
         return;
     }
+    ResourceScope resources("Selection");
+    AllocationScene allocations("Selection");
+    resources.track(gangster1Texture);
+    resources.track(gangster3Texture);
 
     sf::Sprite gangster1Sprite(gangster1Texture);
     sf::Sprite gangster3Sprite(gangster3Texture);
-    applyFirstFrame(gangster1Sprite, gangster1Texture);
-    applyFirstFrame(gangster3Sprite, gangster3Texture);
+    applyFirstFrame(gangster1Sprite, gangster1Frame);
+    applyFirstFrame(gangster3Sprite, gangster3Frame);
 
     gangster1Sprite.setScale(sf::Vector2f{2.3f, 2.3f});
     gangster3Sprite.setScale(sf::Vector2f{2.3f, 2.3f});
@@ -55,7 +68,13 @@ void CharacterSelectionScene::run(sf::RenderWindow& window, GameContext& context
     sf::Texture characterSelectTexture;
     unique_ptr<sf::Sprite> characterSelectSprite;
     bool hasCharacterSelect = false;
-    if (characterSelectTexture.loadFromFile("CharacterSelect.png")) {
+    bool backgroundLoaded = false;
+    {
+        TraceSpan span("load texture", "load", "CharacterSelect.png");
+        backgroundLoaded = characterSelectTexture.loadFromFile("CharacterSelect.png");
+    }
+    if (backgroundLoaded) {
+        resources.track(characterSelectTexture);
         characterSelectSprite = make_unique<sf::Sprite>(characterSelectTexture);
         const auto windowSize = window.getSize();
         const auto textureSize = characterSelectTexture.getSize();
@@ -69,6 +88,9 @@ void CharacterSelectionScene::run(sf::RenderWindow& window, GameContext& context
     selectionLabel.setCharacterSize(28);
     selectionLabel.setFillColor(sf::Color(220, 220, 220));
     selectionLabel.setPosition(sf::Vector2f{80.f, 460.f});
+    if (context.matchLog) {
+        selectionLabel.setString("Press S for match stats");
+    }
 
     bool selectionMade = false;
 
@@ -83,15 +105,21 @@ void CharacterSelectionScene::run(sf::RenderWindow& window, GameContext& context
                 if (keyEvent->code == sf::Keyboard::Key::Num1) {
                     context.selectedCharacterName = "Gangster 1";
                     context.selectedCharacter = CharacterChoice::Gangster1;
-                    context.actionHistory.push("Chose Gangster 1");
+                    context.lastAction = "Chose Gangster 1";
                     selectionLabel.setString("Selected: Gangster 1");
                     selectionMade = true;
                 } else if (keyEvent->code == sf::Keyboard::Key::Num3) {
                     context.selectedCharacterName = "Gangster 3";
                     context.selectedCharacter = CharacterChoice::Gangster3;
-                    context.actionHistory.push("Chose Gangster 3");
+                    context.lastAction = "Chose Gangster 3";
                     selectionLabel.setString("Selected: Gangster 3");
                     selectionMade = true;
+                } else if (keyEvent->code == sf::Keyboard::Key::S && context.matchLog) {
+                    MatchStatsScene stats;
+                    stats.run(window, context);
+                    if (!window.isOpen()) {
+                        return;
+                    }
                 }
             }
         }
@@ -6,12 +6,13 @@ using namespace std;
 
 #include "AssetPaths.hpp"
 #include "GameContext.hpp"
+#include "SpriteSheetAnalyzer.hpp"
 
 class CharacterSelectionScene {
 public:
     void run(sf::RenderWindow& window, GameContext& context);
 
 private:
-    bool loadCharacterTexture(sf::Texture& texture, const string& path);
+    bool loadCharacterTexture(sf::Texture& texture, SheetFrame& firstFrame, const string& path);
 };
 
@@ -0,0 +1,438 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "AssetPaths.hpp"
+#include "IndexedSheet.hpp"
+#include "SessionTrace.hpp"
+#include "SpriteHitboxes.hpp"
+#include "SpriteSheetAnalyzer.hpp"
+
+// Simulation ticks each animation frame is shown for, 0.125 s at 120 Hz.
+// Counted in whole ticks, so which frame is up (and so which hit mask a test
+// reads) never depends on float rounding.
+constexpr uint32_t kFrameTicks = 15;
+
+enum class SpriteState {
+    Walk,
+    Run,
+    Jump,
+    Shot,
+    Attack,
+    Idle,
+    Hurt,
+    Dead
+};
+
+// Per-frame tables of one sheet. Nothing changes them after loading, so
+// headless copies of an animation share one set instead of rebuilding masks.
+struct SheetTables {
+    vector<SheetFrame> frames;
+    vector<FrameHitbox> hitboxes;
+    vector<FrameMask> masks;
+};
+
+// A sheet decoded on the CPU: the packed frames ready for the GPU plus their
+// tables. Decoding touches neither GL nor any sprite, so it can run on any
+// thread.
+struct DecodedSheet {
+    sf::Image packed;
+    shared_ptr<const SheetTables> tables;
+    int cellWidth = 0;
+    int cellHeight = 0;
+};
+
+inline bool decodeSheet(const string& path, bool strikes, DecodedSheet& decoded) {
+    TraceSpan span("decode sheet", "load", path);
+    sf::Image sheet;
+    if (!sheet.loadFromFile(path)) {
+        cerr << "Failed to load sprite sheet: " << path << '\n';
+        return false;
+    }
+    // Only the trimmed frames go to the GPU; cells keep their original size
+    // for positioning and hit tables
+    SheetLayout layout = analyzeSheet(sheet);
+    if (layout.frames.empty()) {
+        cerr << "Failed to load sprite sheet: " << path << '\n';
+        return false;
+    }
+    auto built = make_shared<SheetTables>();
+    built->frames = layout.frames;
+    // Scan the alpha channel once so hit checks never touch the empty margins
+    built->hitboxes = buildHitboxTable(sheet, layout.cellWidth, layout.cellHeight,
+                                       static_cast<int>(layout.frames.size()), strikes);
+    built->masks.reserve(layout.frames.size());
+    for (const auto& frame : built->frames) {
+        built->masks.push_back(buildFrameMask(sheet, frame.cell));
+    }
+    decoded.packed = move(layout.packed);
+    decoded.tables = move(built);
+    decoded.cellWidth = layout.cellWidth;
+    decoded.cellHeight = layout.cellHeight;
+    return true;
+}
+
+struct AnimatedSprite {
+    // RGBA, or palette indices when `indexed` (see IndexedSheet.hpp)
+    sf::Texture texture;
+    sf::Texture palette;
+    bool indexed = false;
+    unique_ptr<sf::Sprite> sprite;
+    int frameWidth = 0;
+    int frameHeight = 0;
+    int frameCount = 1;
+    int currentFrame = 0;
+    uint32_t frameTicks = 0;  // ticks the current frame has been shown
+    shared_ptr<const SheetTables> tables;
+    // Where the sheet came from, so a changed file can find its animation again
+    string source;
+    bool strikes = false;
+
+    // Without `upload` only the tables are built: no texture, no sprite and
+    // no GL context needed
+    bool load(const string& path, bool isDeadSprite = false, bool strikes = false, bool upload = true) {
+        DecodedSheet decoded;
+        if (!decodeSheet(path, strikes, decoded)) {
+            return false;
+        }
+        if (upload) {
+            TraceSpan span("upload sheet", "load", path);
+            // The sheets are a few dozen colors at most, so they go up as a
+            // quarter-size index texture plus a palette where shaders allow
+            indexed = uploadIndexed(decoded.packed, texture, palette);
+            if (!indexed) {
+                if (!texture.loadFromImage(decoded.packed)) {
+                    cerr << "Failed to load sprite sheet: " << path << '\n';
+                    return false;
+                }
+                texture.setSmooth(true);
+            }
+            sprite = make_unique<sf::Sprite>(texture);
+        }
+        source = path;
+        this->strikes = strikes;
+        tables = move(decoded.tables);
+        frameWidth = decoded.cellWidth;
+        frameHeight = decoded.cellHeight;
+        frameCount = static_cast<int>(tables->frames.size());
+        // For dead sprite, always show first frame (don't animate)
+        if (isDeadSprite) {
+            currentFrame = 0;
+        }
+        applyFrame(0);
+        return true;
+    }
+
+    // Swaps in a reloaded sheet. The caller keeps `replacement` alive; the
+    // animation carries on from the same frame where the new strip has one.
+    // Reloaded sheets are always RGBA.
+    void adoptSheet(const sf::Texture& replacement, shared_ptr<const SheetTables> reloaded, int cellWidth,
+                    int cellHeight) {
+        indexed = false;
+        tables = move(reloaded);
+        frameWidth = cellWidth;
+        frameHeight = cellHeight;
+        frameCount = max(1, static_cast<int>(tables->frames.size()));
+        if (sprite) {
+            sprite->setTexture(replacement);
+        }
+        applyFrame(currentFrame % frameCount);
+    }
+
+    // Takes another animation's tables for a headless copy; playback starts over
+    void shareTables(const AnimatedSprite& other) {
+        tables = other.tables;
+        source = other.source;
+        strikes = other.strikes;
+        frameWidth = other.frameWidth;
+        frameHeight = other.frameHeight;
+        frameCount = other.frameCount;
+        currentFrame = 0;
+        frameTicks = 0;
+    }
+
+    bool loaded() const { return tables != nullptr; }
+    // What SpriteBatch needs next to `texture` to draw this sheet
+    const sf::Texture* paletteTexture() const { return indexed ? &palette : nullptr; }
+
+    const SheetTables& sheet() const {
+        static const SheetTables kNoTables;
+        return tables ? *tables : kNoTables;
+    }
+
+    // Shows frame `index`; the origin carries the trim offset so the pose
+    // lands where it sat in the untrimmed cell
+    void applyFrame(int index) {
+        currentFrame = index;
+        const auto& frames = sheet().frames;
+        if (sprite && !frames.empty()) {
+            const auto& frame = frames[static_cast<size_t>(index) % frames.size()];
+            sprite->setTextureRect(frame.trimmed);
+            sprite->setOrigin(sf::Vector2f{-static_cast<float>(frame.offset.x), -static_cast<float>(frame.offset.y)});
+        }
+    }
+
+    void setPosition(const sf::Vector2f& pos) {
+        if (sprite) {
+            sprite->setPosition(pos);
+        }
+    }
+    void setScale(const sf::Vector2f& scale) {
+        if (sprite) {
+            sprite->setScale(scale);
+        }
+    }
+
+    // Advances one simulation tick
+    void update() {
+        if (++frameTicks >= kFrameTicks) {
+            frameTicks = 0;
+            applyFrame((currentFrame + 1) % frameCount);
+        }
+    }
+
+    // RAM held by the hit tables and alpha masks of this sheet
+    size_t collisionBytes() const {
+        size_t bytes = sheet().hitboxes.size() * sizeof(FrameHitbox);
+        for (const auto& mask : sheet().masks) {
+            bytes += mask.bits.size() * sizeof(uint64_t);
+        }
+        return bytes;
+    }
+
+    // Hurtbox of the frame currently shown, in untrimmed cell pixels
+    sf::IntRect cellHurtbox() const {
+        const auto& hitboxes = sheet().hitboxes;
+        if (hitboxes.empty()) {
+            return sf::IntRect(sf::Vector2i{0, 0}, sf::Vector2i{frameWidth, frameHeight});
+        }
+        return hitboxes[static_cast<size_t>(currentFrame) % hitboxes.size()].hurtbox;
+    }
+
+    // Reach of the whole strike in cell pixels; melee resolves on press, so
+    // every active frame of the swing counts. Falls back to the body for
+    // contact hits.
+    sf::IntRect cellStrikeReach() const {
+        sf::IntRect reach;
+        bool any = false;
+        for (const auto& frame : sheet().hitboxes) {
+            if (!frame.hasHitbox) continue;
+            if (!any) {
+                reach = frame.hitbox;
+                any = true;
+                continue;
+            }
+            const int left = min(reach.position.x, frame.hitbox.position.x);
+            const int top = min(reach.position.y, frame.hitbox.position.y);
+            const int right = max(reach.position.x + reach.size.x, frame.hitbox.position.x + frame.hitbox.size.x);
+            const int bottom = max(reach.position.y + reach.size.y, frame.hitbox.position.y + frame.hitbox.size.y);
+            reach = sf::IntRect(sf::Vector2i{left, top}, sf::Vector2i{right - left, bottom - top});
+        }
+        return any ? reach : cellHurtbox();
+    }
+
+    // True if any opaque pixel of the current frame lies in a cell-space rect
+    bool cellMaskHits(const sf::IntRect& cellRect) const {
+        const auto& masks = sheet().masks;
+        if (masks.empty()) {
+            return true;
+        }
+        return masks[static_cast<size_t>(currentFrame) % masks.size()].anyInRect(cellRect);
+    }
+};
+
+struct CharacterSpriteManager {
+    AnimatedSprite idle;
+    AnimatedSprite walk;
+    AnimatedSprite run;
+    AnimatedSprite jump;
+    AnimatedSprite shot;
+    AnimatedSprite attack;
+    AnimatedSprite hurt;
+    AnimatedSprite dead;
+    SpriteState currentState = SpriteState::Walk;
+    SpriteState previousState = SpriteState::Walk;
+    // Ticks spent in the current one-time animation and how many it lasts,
+    // advanced by update() so they follow simulation time
+    uint32_t actionElapsed = 0;
+    uint32_t actionDuration = 0;
+    sf::Vector2f baseScale{1.8f, 1.8f};
+    sf::Vector2f position;
+    // Sprites always hold the art's own pose; facing the other way is applied
+    // when drawing (see facingTransform)
+    bool facingLeft = true;
+    
+    bool isFacingLeft() const { return facingLeft; }
+
+    array<const AnimatedSprite*, 8> animations() const {
+        return {&idle, &walk, &run, &jump, &shot, &attack, &hurt, &dead};
+    }
+    
+    bool loadAll(bool isGangster1, bool upload = true) {
+        if (isGangster1) {
+            return idle.load(kGangster1Idle, false, false, upload) &&
+                   walk.load(kGangster1Walk, false, false, upload) &&
+                   run.load(kGangster1Run, false, false, upload) &&
+                   jump.load(kGangster1Jump, false, false, upload) &&
+                   shot.load(kGangster1Shot, false, false, upload) &&
+                   attack.load(kGangster1Attack1, false, true, upload) &&
+                   hurt.load(kGangster1Hurt, false, false, upload) &&
+                   dead.load(kGangster1Dead, true, false, upload); // true = is dead sprite, don't animate
+        } else {
+            return idle.load(kGangster3Idle, false, false, upload) &&
+                   walk.load(kGangster3Walk, false, false, upload) &&
+                   run.load(kGangster3Run, false, false, upload) &&
+                   jump.load(kGangster3Jump, false, false, upload) &&
+                   shot.load(kGangster3Shot, false, false, upload) &&
+                   attack.load(kGangster3Attack, false, true, upload) &&
+                   hurt.load(kGangster3Hurt, false, false, upload) &&
+                   dead.load(kGangster3Dead, true, false, upload); // true = is dead sprite, don't animate
+        }
+    }
+
+    // The animation loaded from `path`, if any
+    AnimatedSprite* findBySource(const string& path) {
+        for (AnimatedSprite* animation : {&idle, &walk, &run, &jump, &shot, &attack, &hurt, &dead}) {
+            if (animation->source == path) {
+                return animation;
+            }
+        }
+        return nullptr;
+    }
+
+    // Back to where a fresh load starts: walking, in the art's own facing,
+    // every strip on its first frame. Keeps the sheets.
+    void restart() {
+        currentState = SpriteState::Walk;
+        previousState = SpriteState::Walk;
+        actionElapsed = 0;
+        actionDuration = 0;
+        facingLeft = true;
+        for (AnimatedSprite* animation : {&idle, &walk, &run, &jump, &shot, &attack, &hurt, &dead}) {
+            animation->frameTicks = 0;
+            animation->applyFrame(0);
+        }
+    }
+
+    // Headless copy of a character loaded with loadAll(..., false)
+    void shareTables(const CharacterSpriteManager& other) {
+        idle.shareTables(other.idle);
+        walk.shareTables(other.walk);
+        run.shareTables(other.run);
+        jump.shareTables(other.jump);
+        shot.shareTables(other.shot);
+        attack.shareTables(other.attack);
+        hurt.shareTables(other.hurt);
+        dead.shareTables(other.dead);
+    }
+    
+    void setScale(const sf::Vector2f& scale) {
+        baseScale = scale;
+        for (AnimatedSprite* animation : {&idle, &walk, &run, &jump, &shot, &attack, &hurt, &dead}) {
+            animation->setScale(baseScale);
+        }
+    }
+    
+    void setFacingDirection(bool faceLeft) {
+        facingLeft = faceLeft;
+    }
+
+    // Mirrors the art-facing sprites to the other side when drawn. The axis
+    // is the middle of the walk cell, as in FighterHitTest's cellToWorld, so
+    // a turn leaves the fighter's cell where it was.
+    sf::Transform facingTransform() const {
+        if (facingLeft) {
+            return sf::Transform::Identity;
+        }
+        const float axis = position.x + static_cast<float>(walk.frameWidth) * std::abs(baseScale.x) / 2.f;
+        return sf::Transform(-1.f, 0.f, 2.f * axis, 0.f, 1.f, 0.f, 0.f, 0.f, 1.f);
+    }
+
+    void setPosition(const sf::Vector2f& pos) {
+        position = pos;
+        for (AnimatedSprite* animation : {&idle, &walk, &run, &jump, &shot, &attack, &hurt, &dead}) {
+            animation->setPosition(pos);
+        }
+    }
+    
+    bool canChangeState() const {
+        // Don't allow state changes if we're in a one-time animation
+        return actionDuration == 0 || actionElapsed >= actionDuration;
+    }
+    
+    // A nonzero `durationTicks` makes it a one-time animation
+    void changeState(SpriteState newState, uint32_t durationTicks = 0) {
+        if (newState != currentState) {
+            // Save previous state only if not in a one-time animation
+            if (actionDuration == 0) {
+                previousState = currentState;
+            }
+            currentState = newState;
+            actionElapsed = 0;
+            actionDuration = durationTicks;
+        }
+    }
+    
+    // Advances one simulation tick
+    void update() {
+        idle.update();
+        walk.update();
+        run.update();
+        jump.update();
+        shot.update();
+        attack.update();
+        hurt.update();
+        // Don't animate dead sprite - show static first frame
+        // dead.update(); // Commented out to prevent animation
+        
+        // Return from one-time animations to previous state
+        ++actionElapsed;
+        if (actionDuration > 0 && actionElapsed >= actionDuration) {
+            changeState(previousState);
+            actionDuration = 0;
+        }
+    }
+    
+    sf::Sprite* getCurrentSprite() {
+        sf::Sprite* sprite = nullptr;
+        switch (currentState) {
+            case SpriteState::Idle: sprite = idle.sprite.get(); break;
+            case SpriteState::Walk: sprite = walk.sprite.get(); break;
+            case SpriteState::Run: sprite = run.sprite.get(); break;
+            case SpriteState::Jump: sprite = jump.sprite.get(); break;
+            case SpriteState::Shot: sprite = shot.sprite.get(); break;
+            case SpriteState::Attack: sprite = attack.sprite.get(); break;
+            case SpriteState::Hurt: sprite = hurt.sprite.get(); break;
+            case SpriteState::Dead: sprite = dead.sprite.get(); break;
+            default: sprite = idle.sprite.get(); break;
+        }
+        // Fallback to idle sprite if current sprite is null
+        return sprite ? sprite : idle.sprite.get();
+    }
+
+    const AnimatedSprite& getCurrentAnimation() const {
+        switch (currentState) {
+            case SpriteState::Walk: return walk.loaded() ? walk : idle;
+            case SpriteState::Run: return run.loaded() ? run : idle;
+            case SpriteState::Jump: return jump.loaded() ? jump : idle;
+            case SpriteState::Shot: return shot.loaded() ? shot : idle;
+            case SpriteState::Attack: return attack.loaded() ? attack : idle;
+            case SpriteState::Hurt: return hurt.loaded() ? hurt : idle;
+            case SpriteState::Dead: return dead.loaded() ? dead : idle;
+            default: return idle;
+        }
+    }
+    AnimatedSprite& getCurrentAnimation() {
+        return const_cast<AnimatedSprite&>(static_cast<const CharacterSpriteManager&>(*this).getCurrentAnimation());
+    }
+};
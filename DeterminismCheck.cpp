@@ -0,0 +1,52 @@
+#include "DeterminismCheck.hpp"
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "InputBuffer.hpp"
+#include "StageSimulation.hpp"
+
+using namespace std;
+
+namespace {
+// Five seconds of game time between lines
+constexpr int kReportInterval = kSimulationRate * 5;
+
+void printHash(const char* label, int value, uint64_t hash) {
+    cout << label << ' ' << value << ": " << hex << setw(16) << setfill('0') << hash << dec << setfill(' ') << '\n';
+}
+}
+
+int runDeterminismCheck(int ticks) {
+    // Hit tables only: no window, no GL context, so it runs without a display
+    CharacterSpriteManager gangster1;
+    CharacterSpriteManager gangster3;
+    BulletShape bulletShape;
+    if (!gangster1.loadAll(true, false) || !gangster3.loadAll(false, false) || !loadBulletShape(bulletShape)) {
+        cerr << "Unable to load the stage; run from the game directory\n";
+        return 1;
+    }
+    uint64_t combined = 0;
+    int ticksRun = 0;
+    int matches = 0;
+    while (ticksRun < ticks) {
+        StageSimulation simulation(true);
+        // Alternate characters like the benchmark does
+        simulation.loadShared(matches % 2 == 0, gangster1, gangster3, bulletShape);
+        // Scripted on both sides, so nothing is ever queued
+        InputBuffer input;
+        while (ticksRun < ticks && !simulation.matchOver()) {
+            simulation.step(input);
+            ++ticksRun;
+            if (ticksRun % kReportInterval == 0) {
+                printHash("tick", ticksRun, simulation.stateHash());
+            }
+        }
+        combined = (combined ^ simulation.stateHash()) * 1099511628211ull;
+        ++matches;
+        printHash("match", matches, simulation.stateHash());
+    }
+    printHash("final after ticks", ticksRun, combined);
+    return 0;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// Runs scripted AI-vs-AI matches headlessly for `ticks` simulation ticks and
+// prints the state hash every few seconds of game time. Two builds (other
+// compiler, CPU or flags) that print the same lines simulate bit-exactly.
+// Needs a GL context for loading the sheets, nothing else.
+int runDeterminismCheck(int ticks);
+
+// Five minutes of game time at 120 Hz, several full matches
+constexpr int kDefaultHashTicks = 120 * 60 * 5;
@@ -1,27 +1,214 @@
+#include <SFML/Audio.hpp>
 #include <SFML/Graphics.hpp>
+#include <cstdlib>
 #include <iostream>
 #include <memory>
+#include <optional>
+#include <string>
 
+#include "AllocationTracker.hpp"
+#include "AssetWatcher.hpp"
+#include "BenchmarkMode.hpp"
 #include "CharacterSelectionScene.hpp"
+#include "DeterminismCheck.hpp"
+#include "FrameCapture.hpp"
 #include "GameContext.hpp"
 #include "GameStage.hpp"
 #include "IntroductionScene.hpp"
+#include "MatchLog.hpp"
+#include "MusicEngine.hpp"
+#include "ResourceTracker.hpp"
+#include "SessionTrace.hpp"
+#include "SpectatorMode.hpp"
+#include "SpectatorStream.hpp"
+#include "Telemetry.hpp"
 
 using namespace std;
 
-int main() {
+namespace {
+// Prints the asset memory report however main exits
+struct ResourceReportAtExit {
+    ~ResourceReportAtExit() { ResourceTracker::instance().report(cout); }
+};
+
+// Prints the --alloc-report however main exits
+struct AllocationReportAtExit {
+    bool enabled = false;
+    ~AllocationReportAtExit() {
+        if (enabled) {
+            AllocationTracker::instance().report(cout);
+        }
+    }
+};
+
+// Writes the --telemetry file a last time however main exits
+struct TelemetryAtExit {
+    ~TelemetryAtExit() { Telemetry::instance().stop(); }
+};
+
+// Writes the --trace file however main exits
+struct TraceAtExit {
+    ~TraceAtExit() { SessionTrace::instance().finish(); }
+};
+}
+
+int main(int argc, char** argv) {
+    // --benchmark [seconds]: scripted AI-vs-AI run with no videos or menus
+    bool benchmark = false;
+    float benchmarkSeconds = 30.f;
+    // --sim-hash [ticks]: print simulation state hashes to diff between builds
+    int hashTicks = 0;
+    // --serve-spectators [port], --spectate [host[:port]], --spectator-loopback [clients]
+    optional<unsigned short> servePort;
+    optional<string> spectateAddress;
+    int loopbackSpectators = 0;
+    // --record [file]: encode every stage frame to a video with ffmpeg
+    optional<string> recordPath;
+    // --hot-reload: swap in sheets and sounds as they change on disk
+    bool hotReload = false;
+    // --match-log <base>: where results go (<base>.bin and <base>.idx);
+    // --match-stats: print a summary of them and exit
+    string matchLogBase = "matches";
+    bool matchStats = false;
+    // --level <file>: fight on a scrolling level (.txt source or baked .map)
+    string levelPath;
+    // --trace [file]: write the whole session as a Chrome trace_event timeline
+    optional<string> tracePath;
+    // --assert-no-alloc: with --benchmark, fail if a steady-state frame allocates;
+    // --alloc-report: print heap allocations per scene (and call site) at exit
+    bool assertNoAlloc = false;
+    // --telemetry [file]: keep gameplay counters in a Prometheus text file
+    optional<string> telemetryPath;
+    AllocationReportAtExit allocationReport;
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        if (arg == "--benchmark") {
+            benchmark = true;
+            if (i + 1 < argc && atof(argv[i + 1]) > 0.0) {
+                benchmarkSeconds = static_cast<float>(atof(argv[++i]));
+            }
+        } else if (arg == "--sim-hash") {
+            hashTicks = kDefaultHashTicks;
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0) {
+                hashTicks = atoi(argv[++i]);
+            }
+        } else if (arg == "--serve-spectators") {
+            servePort = kSpectatorPort;
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0) {
+                servePort = static_cast<unsigned short>(atoi(argv[++i]));
+            }
+        } else if (arg == "--spectate") {
+            spectateAddress = "127.0.0.1";
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                spectateAddress = argv[++i];
+            }
+        } else if (arg == "--spectator-loopback") {
+            loopbackSpectators = 100;
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0) {
+                loopbackSpectators = atoi(argv[++i]);
+            }
+        } else if (arg == "--record") {
+            recordPath = "match.mp4";
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                recordPath = argv[++i];
+            }
+        } else if (arg == "--hot-reload") {
+            hotReload = true;
+        } else if (arg == "--match-log" && i + 1 < argc) {
+            matchLogBase = argv[++i];
+        } else if (arg == "--level" && i + 1 < argc) {
+            levelPath = argv[++i];
+        } else if (arg == "--trace") {
+            tracePath = "trace.json";
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                tracePath = argv[++i];
+            }
+        } else if (arg == "--assert-no-alloc") {
+            assertNoAlloc = true;
+        } else if (arg == "--alloc-report") {
+            allocationReport.enabled = true;
+        } else if (arg == "--telemetry") {
+            telemetryPath = "chavacano.prom";
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                telemetryPath = argv[++i];
+            }
+        } else if (arg == "--match-stats") {
+            matchStats = true;
+        } else if (arg == "--memory-budget" && i + 1 < argc) {
+            // MiB of textures, sound and collision data before a warning is printed
+            ResourceTracker::instance().setBudget(static_cast<size_t>(atof(argv[++i]) * 1024.0 * 1024.0));
+        }
+    }
+
+    // Declared first so it is written after every other thread has stopped
+    TraceAtExit traceWriter;
+    if (tracePath && SessionTrace::instance().start(*tracePath)) {
+        SessionTrace::instance().nameThread("main");
+        cout << "Tracing the session to " << *tracePath << '\n';
+    }
+    TelemetryAtExit telemetryWriter;
+    if (telemetryPath && Telemetry::instance().start(*telemetryPath)) {
+        cout << "Writing telemetry to " << *telemetryPath << '\n';
+    }
+
+    if (matchStats) {
+        // Reads only the index; no window needed
+        MatchLog matchLog(matchLogBase);
+        if (!matchLog.isOpen()) {
+            return 1;
+        }
+        cout << formatMatchSummary(matchLog.summarize());
+        return 0;
+    }
+    if (hashTicks > 0) {
+        // Headless too: the check loads hit tables only
+        return runDeterminismCheck(hashTicks);
+    }
+
+    optional<TraceSpan> windowSpan;
+    windowSpan.emplace("create window", "scene");
     sf::RenderWindow window(sf::VideoMode({960u, 540u}), "El Chavacano", sf::Style::Resize | sf::Style::Close);
-    window.setFramerateLimit(60);
+    windowSpan.reset();
+    if (loopbackSpectators > 0) {
+        window.setVisible(false);
+        return runSpectatorLoopback(loopbackSpectators, 10.f);
+    }
+    if (benchmark) {
+        // Uncapped, unsynced, hidden and silent: measure the frame, not the display
+        window.setVisible(false);
+        window.setFramerateLimit(0);
+        window.setVerticalSyncEnabled(false);
+        sf::Listener::setGlobalVolume(0.f);
+    } else {
+        window.setFramerateLimit(60);
+    }
 
     GameContext context;
+    context.levelPath = levelPath;
+    ResourceScope globalResources("Global");
+    MusicEngine music;
+    context.music = &music;
+    globalResources.track(ResourceCategory::MusicStream, music.bufferBytes());
+    ResourceReportAtExit resourceReport;
     const string fontPath = "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf";
-    if (!context.font.openFromFile(fontPath)) {
+    bool fontLoaded = false;
+    {
+        TraceSpan span("load font", "load", fontPath);
+        fontLoaded = context.font.openFromFile(fontPath);
+    }
+    if (!fontLoaded) {
         cerr << "Unable to load font from: " << fontPath << '\n';
         return 1;
     }
 
     const string backgroundPath = "Background.png";
-    if (context.backgroundTexture.loadFromFile(backgroundPath)) {
+    bool backgroundLoaded = false;
+    {
+        TraceSpan span("load texture", "load", backgroundPath);
+        backgroundLoaded = context.backgroundTexture.loadFromFile(backgroundPath);
+    }
+    if (backgroundLoaded) {
+        globalResources.track(context.backgroundTexture);
         context.backgroundSprite = make_unique<sf::Sprite>(context.backgroundTexture);
         const auto bounds = context.backgroundSprite->getLocalBounds();
         const float scaleX = static_cast<float>(window.getSize().x) / bounds.size.x;
@@ -32,8 +219,56 @@ int main() {
         cerr << "Warning: Could not load background image at " << backgroundPath << '\n';
     }
 
+    if (benchmark) {
+        return runStageBenchmark(window, context, benchmarkSeconds, assertNoAlloc);
+    }
+    if (spectateAddress) {
+        string host = *spectateAddress;
+        unsigned short port = kSpectatorPort;
+        if (const auto colon = host.rfind(':'); colon != string::npos) {
+            port = static_cast<unsigned short>(atoi(host.c_str() + colon + 1));
+            host.resize(colon);
+        }
+        return runSpectator(window, context, host, port);
+    }
+    unique_ptr<SpectatorServer> spectatorServer;
+    if (servePort) {
+        spectatorServer = make_unique<SpectatorServer>(*servePort);
+        if (spectatorServer->listening()) {
+            context.spectators = spectatorServer.get();
+            cout << "Serving spectators on port " << spectatorServer->port() << '\n';
+        }
+    }
+    unique_ptr<FrameCapture> frameCapture;
+    if (recordPath) {
+        frameCapture = make_unique<FrameCapture>(*recordPath, window.getSize(), 60);
+        if (frameCapture->recording()) {
+            context.capture = frameCapture.get();
+            cout << "Recording stages to " << *recordPath << '\n';
+        }
+    }
+    unique_ptr<AssetWatcher> assetWatcher;
+    if (hotReload) {
+        assetWatcher = make_unique<AssetWatcher>();
+        if (assetWatcher->active()) {
+            context.assets = assetWatcher.get();
+        }
+    }
+
+    // Benchmark and headless modes returned above, so only real matches get here
+    optional<TraceSpan> matchLogSpan;
+    matchLogSpan.emplace("open match log", "load", matchLogBase);
+    MatchLog matchLog(matchLogBase);
+    if (matchLog.isOpen()) {
+        context.matchLog = &matchLog;
+    }
+    matchLogSpan.reset();
+
     IntroductionScene intro;
-    intro.run(window, context);
+    {
+        TraceSpan span("intro", "scene");
+        intro.run(window, context);
+    }
     if (!window.isOpen()) {
         return 0;
     }
@@ -41,13 +276,19 @@ int main() {
     // Main game loop - allows replaying
     while (window.isOpen()) {
         CharacterSelectionScene selection;
-        selection.run(window, context);
+        {
+            TraceSpan span("character selection", "scene");
+            selection.run(window, context);
+        }
         if (!window.isOpen()) {
             return 0;
         }
 
         GameStage stage;
-        stage.run(window, context);
+        {
+            TraceSpan span("stage", "scene");
+            stage.run(window, context);
+        }
         
         // If window is still open after game ends, loop back to character selection
         // (GameStage will handle PlayAgain screen and exit if ESC is pressed)
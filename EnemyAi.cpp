@@ -0,0 +1,25 @@
+#include "EnemyAi.hpp"
+
+using namespace std;
+
+void AiAgents::resize(size_t count) {
+    x.resize(count);
+    y.resize(count);
+    targetX.resize(count);
+    targetY.resize(count);
+    flags.resize(count);
+    direction.resize(count);
+    running.resize(count);
+    jump.resize(count);
+    intent.resize(count);
+}
+
+namespace gangster {
+void decide(AiAgents& agents) {
+    bt::tickAll<Decide>(agents);
+}
+
+void attack(AiAgents& agents) {
+    bt::tickAll<Attack>(agents);
+}
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+#include "FixedPoint.hpp"
+
+// What an agent does with its weapon this tick
+enum class AiIntent : uint8_t {
+    None,
+    Melee,
+    Shoot
+};
+
+// State bits an agent's tree can test
+enum AiFlag : uint8_t {
+    kAiAirborne = 1 << 0,
+    kAiReloading = 1 << 1,
+    kAiMeleeReady = 1 << 2,  // off cooldown and free to change animation
+    kAiGunReady = 1 << 3     // loaded, off cooldown and free to change animation
+};
+
+// Every AI agent as parallel component arrays; agent i is index i of each.
+// The caller fills the inputs, and a tree writes only the outputs of the
+// nodes that run, so the rest keep what the caller put there.
+struct AiAgents {
+    // Inputs, in world units
+    vector<Fixed> x;
+    vector<Fixed> y;
+    vector<Fixed> targetX;
+    vector<Fixed> targetY;
+    vector<uint8_t> flags;  // AiFlag bits
+    // Outputs
+    vector<int8_t> direction;  // -1, 0 or +1 along x
+    vector<uint8_t> running;
+    vector<uint8_t> jump;  // start a jump now
+    vector<AiIntent> intent;
+
+    size_t size() const { return x.size(); }
+    void resize(size_t count);
+};
+
+// Behavior-tree nodes. A node is a type with a static tick() that returns
+// whether it succeeded for agent `i`; composites take their children as
+// template arguments. A whole tree is therefore one type, instantiated and
+// inlined at compile time, with no per-node allocation or virtual call.
+namespace bt {
+// Ticks children in order until one succeeds
+template <class... Children>
+struct Selector {
+    static bool tick(AiAgents& agents, size_t i) { return (Children::tick(agents, i) || ...); }
+};
+
+// Ticks children in order until one fails
+template <class... Children>
+struct Sequence {
+    static bool tick(AiAgents& agents, size_t i) { return (Children::tick(agents, i) && ...); }
+};
+
+template <class Child>
+struct Not {
+    static bool tick(AiAgents& agents, size_t i) { return !Child::tick(agents, i); }
+};
+
+// Ticks `Child` for its effects and succeeds whatever it returns
+template <class Child>
+struct Succeed {
+    static bool tick(AiAgents& agents, size_t i) {
+        Child::tick(agents, i);
+        return true;
+    }
+};
+
+template <uint8_t Flag>
+struct Has {
+    static bool tick(AiAgents& agents, size_t i) { return (agents.flags[i] & Flag) != 0; }
+};
+
+// The target is at least Min and less than Max away along x
+template <int Min, int Max>
+struct TargetWithin {
+    static bool tick(AiAgents& agents, size_t i) {
+        const Fixed distance = fixedAbs(agents.x[i] - agents.targetX[i]);
+        return distance >= Fixed::fromInt(Min) && distance < Fixed::fromInt(Max);
+    }
+};
+
+// The target stands less than Tolerance above or below the agent
+template <int Tolerance>
+struct TargetLevel {
+    static bool tick(AiAgents& agents, size_t i) {
+        return fixedAbs(agents.y[i] - agents.targetY[i]) < Fixed::fromInt(Tolerance);
+    }
+};
+
+// Steers so the agent's x minus the target's stays within [Min, Max] and
+// stands still inside it; with Run, it runs whenever it moves
+template <int Min, int Max, bool Run>
+struct HoldOffset {
+    static bool tick(AiAgents& agents, size_t i) {
+        const Fixed offset = agents.x[i] - agents.targetX[i];
+        const int8_t direction = offset > Fixed::fromInt(Max) ? -1 : offset < Fixed::fromInt(Min) ? 1 : 0;
+        agents.direction[i] = direction;
+        agents.running[i] = Run && direction != 0;
+        return true;
+    }
+};
+
+// Always moves, running, toward standing Offset to the right of the target;
+// at exactly Offset it keeps closing in, like the enemy always has from afar
+template <int Offset>
+struct Approach {
+    static bool tick(AiAgents& agents, size_t i) {
+        agents.direction[i] = agents.x[i] - agents.targetX[i] > Fixed::fromInt(Offset) ? -1 : 1;
+        agents.running[i] = 1;
+        return true;
+    }
+};
+
+struct Jump {
+    static bool tick(AiAgents& agents, size_t i) {
+        agents.jump[i] = 1;
+        return true;
+    }
+};
+
+template <AiIntent Intent>
+struct Intend {
+    static bool tick(AiAgents& agents, size_t i) {
+        agents.intent[i] = Intent;
+        return true;
+    }
+};
+
+// Ticks `Tree` once for every agent
+template <class Tree>
+void tickAll(AiAgents& agents) {
+    const size_t count = agents.size();
+    for (size_t i = 0; i < count; ++i) {
+        Tree::tick(agents, i);
+    }
+}
+}
+
+// The stage's enemy gangster. It keeps to the right of its target: close in
+// from afar, hang back to shoot at mid range, and stand its ground to swing
+// when close.
+namespace gangster {
+constexpr int kMeleeRange = 120;
+constexpr int kGunRange = 300;
+// Hop when the target is this close and on the same footing
+constexpr int kJumpRange = 80;
+constexpr int kJumpLevelTolerance = 10;
+
+// Where to move, every decision interval. Decisions are skipped in the air
+// unless the agent is busy reloading anyway.
+using Decide = bt::Sequence<
+    bt::Selector<bt::Has<kAiReloading>, bt::Not<bt::Has<kAiAirborne>>>,
+    bt::Selector<bt::Sequence<bt::TargetWithin<0, kMeleeRange>, bt::HoldOffset<-40, 60, true>>,
+                 bt::Sequence<bt::TargetWithin<kMeleeRange, kGunRange>, bt::HoldOffset<-80, 180, false>>,
+                 bt::Approach<100>>,
+    bt::Succeed<bt::Sequence<bt::Not<bt::Has<kAiAirborne>>, bt::TargetWithin<0, kJumpRange>,
+                             bt::TargetLevel<kJumpLevelTolerance>, bt::Jump>>>;
+
+// Whether to swing or shoot, every tick
+using Attack = bt::Selector<
+    bt::Sequence<bt::TargetWithin<0, kMeleeRange>, bt::Has<kAiMeleeReady>, bt::Intend<AiIntent::Melee>>,
+    bt::Sequence<bt::TargetWithin<kMeleeRange, kGunRange>, bt::Has<kAiGunReady>, bt::Intend<AiIntent::Shoot>>>;
+
+// The trees over every agent, compiled once in EnemyAi.cpp
+void decide(AiAgents& agents);
+void attack(AiAgents& agents);
+}
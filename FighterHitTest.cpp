@@ -0,0 +1,47 @@
+#include "FighterHitTest.hpp"
+
+using namespace std;
+
+namespace {
+// The inverse of cellToWorld(), rounded outwards to whole cell pixels
+sf::IntRect worldToCell(const CharacterSpriteManager& sprites, const FixedVec2& feet, const FixedRect& world) {
+    Fixed left;
+    Fixed right;
+    if (sprites.isFacingLeft()) {
+        left = (world.left - feet.x) / kFighterScale;
+        right = (world.right() - feet.x) / kFighterScale;
+    } else {
+        const Fixed pivot = feet.x + Fixed::fromInt(sprites.walk.frameWidth) * kFighterScale;
+        left = (pivot - world.right()) / kFighterScale;
+        right = (pivot - world.left) / kFighterScale;
+    }
+    const Fixed top = (world.top - feet.y) / kFighterScale;
+    const Fixed bottom = (world.bottom() - feet.y) / kFighterScale;
+    const int x = left.floorToInt();
+    const int y = top.floorToInt();
+    return sf::IntRect(sf::Vector2i{x, y}, sf::Vector2i{right.ceilToInt() - x + 1, bottom.ceilToInt() - y + 1});
+}
+}
+
+FixedRect cellToWorld(const CharacterSpriteManager& sprites, const FixedVec2& feet, const sf::IntRect& cell) {
+    FixedRect world;
+    world.top = feet.y + Fixed::fromInt(cell.position.y) * kFighterScale;
+    world.width = Fixed::fromInt(cell.size.x) * kFighterScale;
+    world.height = Fixed::fromInt(cell.size.y) * kFighterScale;
+    const Fixed left = Fixed::fromInt(cell.position.x) * kFighterScale;
+    if (sprites.isFacingLeft()) {
+        world.left = feet.x + left;
+    } else {
+        const Fixed pivot = feet.x + Fixed::fromInt(sprites.walk.frameWidth) * kFighterScale;
+        world.left = pivot - left - world.width;
+    }
+    return world;
+}
+
+bool bodyOverlaps(const CharacterSpriteManager& sprites, const FixedVec2& feet, const FixedRect& world) {
+    const AnimatedSprite& body = sprites.getCurrentAnimation();
+    if (!cellToWorld(sprites, feet, body.cellHurtbox()).overlaps(world)) {
+        return false;
+    }
+    return body.cellMaskHits(worldToCell(sprites, feet, world));
+}
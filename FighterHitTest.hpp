@@ -0,0 +1,20 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+
+using namespace std;
+
+#include "CharacterSprites.hpp"
+#include "FixedPoint.hpp"
+
+// Fighters are drawn at this scale, and every hit test works in it
+constexpr Fixed kFighterScale = Fixed::fromDouble(1.8);
+
+// Fixed-point twin of the sprite transform and facingTransform(): a cell
+// pixel lands at feet + scale * pixel, and a flipped fighter mirrors across
+// its walk cell. `feet` is the top left of the fighter's cell.
+FixedRect cellToWorld(const CharacterSpriteManager& sprites, const FixedVec2& feet, const sf::IntRect& cell);
+
+// Pixel-accurate test of a world rect against the fighter's current pose:
+// tight hurtbox first, then the frame's alpha mask under the rect
+bool bodyOverlaps(const CharacterSpriteManager& sprites, const FixedVec2& feet, const FixedRect& world);
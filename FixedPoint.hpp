@@ -0,0 +1,94 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+
+using namespace std;
+
+// Q16.16 fixed-point number for the gameplay path. Every operation is integer
+// arithmetic, so a simulation produces the same bits on any compiler, CPU or
+// set of float flags. Range is about +/-32767 with a resolution of 1/65536,
+// plenty for an arena a thousand pixels wide.
+class Fixed {
+public:
+    static constexpr int kFractionBits = 16;
+    static constexpr int32_t kOne = 1 << kFractionBits;
+
+    constexpr Fixed() = default;
+
+    static constexpr Fixed fromRaw(int32_t raw) {
+        Fixed f;
+        f.value = raw;
+        return f;
+    }
+    static constexpr Fixed fromInt(int v) { return fromRaw(static_cast<int32_t>(v) * kOne); }
+    // Only for constants: evaluated at compile time, so the rounding is the same in every build
+    static constexpr Fixed fromDouble(double v) {
+        return fromRaw(static_cast<int32_t>(v * kOne + (v < 0 ? -0.5 : 0.5)));
+    }
+    static constexpr Fixed ratio(int numerator, int denominator) {
+        return fromRaw(static_cast<int32_t>((static_cast<int64_t>(numerator) * kOne) / denominator));
+    }
+
+    constexpr int32_t raw() const { return value; }
+    // For drawing only; nothing read back from a float feeds the simulation
+    constexpr float toFloat() const { return static_cast<float>(value) / static_cast<float>(kOne); }
+    // Rounds towards negative infinity
+    constexpr int floorToInt() const { return value >> kFractionBits; }
+    constexpr int ceilToInt() const { return (value + kOne - 1) >> kFractionBits; }
+
+    constexpr Fixed operator-() const { return fromRaw(-value); }
+    constexpr Fixed operator+(Fixed o) const { return fromRaw(value + o.value); }
+    constexpr Fixed operator-(Fixed o) const { return fromRaw(value - o.value); }
+    constexpr Fixed operator*(Fixed o) const {
+        return fromRaw(static_cast<int32_t>((static_cast<int64_t>(value) * o.value) >> kFractionBits));
+    }
+    constexpr Fixed operator/(Fixed o) const {
+        return fromRaw(static_cast<int32_t>((static_cast<int64_t>(value) * kOne) / o.value));
+    }
+    constexpr Fixed operator*(int k) const { return fromRaw(value * k); }
+    Fixed& operator+=(Fixed o) { value += o.value; return *this; }
+    Fixed& operator-=(Fixed o) { value -= o.value; return *this; }
+
+    constexpr bool operator==(Fixed o) const { return value == o.value; }
+    constexpr bool operator!=(Fixed o) const { return value != o.value; }
+    constexpr bool operator<(Fixed o) const { return value < o.value; }
+    constexpr bool operator<=(Fixed o) const { return value <= o.value; }
+    constexpr bool operator>(Fixed o) const { return value > o.value; }
+    constexpr bool operator>=(Fixed o) const { return value >= o.value; }
+
+private:
+    int32_t value = 0;
+};
+
+constexpr Fixed fixedAbs(Fixed v) { return v < Fixed() ? -v : v; }
+constexpr Fixed fixedMin(Fixed a, Fixed b) { return b < a ? b : a; }
+constexpr Fixed fixedMax(Fixed a, Fixed b) { return a < b ? b : a; }
+constexpr Fixed fixedClamp(Fixed v, Fixed low, Fixed high) { return fixedMin(fixedMax(v, low), high); }
+
+struct FixedVec2 {
+    Fixed x;
+    Fixed y;
+
+    constexpr FixedVec2 operator+(FixedVec2 o) const { return {x + o.x, y + o.y}; }
+    constexpr FixedVec2 operator-(FixedVec2 o) const { return {x - o.x, y - o.y}; }
+    FixedVec2& operator+=(FixedVec2 o) { x += o.x; y += o.y; return *this; }
+    sf::Vector2f toFloat() const { return {x.toFloat(), y.toFloat()}; }
+};
+
+struct FixedRect {
+    Fixed left;
+    Fixed top;
+    Fixed width;
+    Fixed height;
+
+    constexpr Fixed right() const { return left + width; }
+    constexpr Fixed bottom() const { return top + height; }
+    constexpr FixedVec2 center() const {
+        return {left + Fixed::fromRaw(width.raw() / 2), top + Fixed::fromRaw(height.raw() / 2)};
+    }
+    constexpr bool overlaps(const FixedRect& o) const {
+        return left < o.right() && right() > o.left && top < o.bottom() && bottom() > o.top;
+    }
+    sf::FloatRect toFloat() const { return {{left.toFloat(), top.toFloat()}, {width.toFloat(), height.toFloat()}}; }
+};
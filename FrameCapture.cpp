@@ -0,0 +1,185 @@
+#include "FrameCapture.hpp"
+
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <optional>
+
+#include "SessionTrace.hpp"
+
+using namespace std;
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+namespace {
+// From glext.h, which GL 1.1 platforms do not ship
+constexpr GLenum kPixelPackBuffer = 0x88EB;
+constexpr GLenum kStreamRead = 0x88E1;
+constexpr GLenum kReadOnly = 0x88B8;
+
+// How long the writer sleeps when there is nothing to write
+constexpr auto kWriterIdle = chrono::milliseconds(2);
+
+template <typename Function>
+bool loadFunction(Function& function, const char* name) {
+    function = reinterpret_cast<Function>(sf::Context::getFunction(name));
+    return function != nullptr;
+}
+
+// Takes one index off a queue, if there is one
+template <typename Queue>
+optional<size_t> takeOne(Queue& queue) {
+    optional<size_t> taken;
+    queue.drainWhile([&](const size_t&) { return !taken; }, [&](size_t index) { taken = index; });
+    return taken;
+}
+}
+
+bool FrameCapture::PixelBufferApi::load() {
+    return loadFunction(genBuffers, "glGenBuffers") && loadFunction(deleteBuffers, "glDeleteBuffers") &&
+           loadFunction(bindBuffer, "glBindBuffer") && loadFunction(bufferData, "glBufferData") &&
+           loadFunction(mapBuffer, "glMapBuffer") && loadFunction(unmapBuffer, "glUnmapBuffer") &&
+           loadFunction(readPixels, "glReadPixels");
+}
+
+FrameCapture::FrameCapture(const string& path, sf::Vector2u size, unsigned framesPerSecond)
+    : path(path), size(size), frameBytes(static_cast<size_t>(size.x) * size.y * 4) {
+    if (!gl.load()) {
+        // A synchronous fallback would stall every frame, which is what this avoids
+        cerr << "Warning: pixel buffer objects are unavailable; not recording\n";
+        return;
+    }
+
+    // GL reads rows bottom-up, so the encoder flips them back
+    const string command = "ffmpeg -loglevel error -y -f rawvideo -pix_fmt rgba -s " + to_string(size.x) + "x" +
+                           to_string(size.y) + " -r " + to_string(framesPerSecond) +
+                           " -i - -vf vflip -c:v libx264 -preset veryfast -pix_fmt yuv420p \"" + path + "\"";
+#ifndef _WIN32
+    // An encoder that exits early should end the recording, not the game
+    signal(SIGPIPE, SIG_IGN);
+#endif
+    encoder = popen(command.c_str(), "w");
+    if (!encoder) {
+        cerr << "Warning: could not start ffmpeg; not recording\n";
+        return;
+    }
+
+    gl.genBuffers(static_cast<GLsizei>(pixelBuffers.size()), pixelBuffers.data());
+    for (GLuint buffer : pixelBuffers) {
+        gl.bindBuffer(kPixelPackBuffer, buffer);
+        gl.bufferData(kPixelPackBuffer, static_cast<ptrdiff_t>(frameBytes), nullptr, kStreamRead);
+    }
+    gl.bindBuffer(kPixelPackBuffer, 0);
+
+    frames.resize(kPendingFrames);
+    for (size_t i = 0; i < frames.size(); ++i) {
+        frames[i].resize(frameBytes);
+        freeFrames.push(i);
+    }
+    writer = thread([this] { write(); });
+}
+
+FrameCapture::~FrameCapture() {
+    if (pixelBuffers[0] != 0) {
+        // Buffer objects are shared between SFML contexts, so this works even
+        // after the window is gone
+        sf::Context context;
+        for (size_t i = 0; i < kReadbackDelay; ++i) {
+            const size_t slot = (frameCount + i) % kReadbackDelay;
+            if (inFlight[slot]) {
+                collect(slot);
+            }
+        }
+        gl.deleteBuffers(static_cast<GLsizei>(pixelBuffers.size()), pixelBuffers.data());
+    }
+    if (writer.joinable()) {
+        stopping.store(true, memory_order_release);
+        writer.join();
+    }
+    if (encoder) {
+        pclose(encoder);
+        const CaptureStats totals = stats();
+        cout << "Recorded " << totals.written << " frames to " << path;
+        if (totals.dropped > 0) {
+            cout << " (" << totals.dropped << " dropped)";
+        }
+        cout << '\n';
+    }
+}
+
+void FrameCapture::capture(sf::RenderWindow& window) {
+    if (!recording() || encoderFailed.load(memory_order_relaxed)) {
+        return;
+    }
+    // The pixel buffers are read from the window's own context
+    if (!window.setActive(true)) {
+        return;
+    }
+    const size_t slot = frameCount % kReadbackDelay;
+    if (inFlight[slot]) {
+        collect(slot);
+    }
+    // With a pack buffer bound, glReadPixels only queues the copy. Rows past
+    // a shrunken window read as undefined.
+    gl.bindBuffer(kPixelPackBuffer, pixelBuffers[slot]);
+    gl.readPixels(0, 0, static_cast<GLsizei>(size.x), static_cast<GLsizei>(size.y), GL_RGBA, GL_UNSIGNED_BYTE,
+                  nullptr);
+    gl.bindBuffer(kPixelPackBuffer, 0);
+    inFlight[slot] = true;
+    ++frameCount;
+}
+
+void FrameCapture::collect(size_t slot) {
+    inFlight[slot] = false;
+    gl.bindBuffer(kPixelPackBuffer, pixelBuffers[slot]);
+    const void* pixels = gl.mapBuffer(kPixelPackBuffer, kReadOnly);
+    const optional<size_t> frame = pixels ? takeOne(freeFrames) : nullopt;
+    if (frame) {
+        memcpy(frames[*frame].data(), pixels, frameBytes);
+        filledFrames.push(*frame);
+    } else {
+        dropped.fetch_add(1, memory_order_relaxed);
+    }
+    if (pixels) {
+        gl.unmapBuffer(kPixelPackBuffer);
+    }
+    gl.bindBuffer(kPixelPackBuffer, 0);
+}
+
+void FrameCapture::write() {
+    SessionTrace::instance().nameThread("frame capture");
+    while (true) {
+        // Read the flag first: whatever was queued before it was set is
+        // visible to the drain below
+        const bool finishing = stopping.load(memory_order_acquire);
+        const size_t drained = filledFrames.drain([&](size_t index) {
+            if (!encoderFailed.load(memory_order_relaxed)) {
+                if (fwrite(frames[index].data(), 1, frameBytes, encoder) == frameBytes) {
+                    written.fetch_add(1, memory_order_relaxed);
+                } else {
+                    cerr << "Warning: ffmpeg stopped accepting frames; recording ends here\n";
+                    encoderFailed.store(true, memory_order_relaxed);
+                }
+            }
+            freeFrames.push(index);
+        });
+        if (drained == 0) {
+            if (finishing) {
+                return;
+            }
+            this_thread::sleep_for(kWriterIdle);
+        }
+    }
+}
+
+CaptureStats FrameCapture::stats() const {
+    CaptureStats result;
+    result.captured = frameCount;
+    result.written = written.load(memory_order_relaxed);
+    result.dropped = dropped.load(memory_order_relaxed);
+    return result;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <SFML/OpenGL.hpp>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+#include "SpscQueue.hpp"
+
+struct CaptureStats {
+    uint64_t captured = 0;  // frames handed to capture()
+    uint64_t written = 0;   // frames the encoder accepted
+    uint64_t dropped = 0;   // frames lost because the writer fell behind
+};
+
+// Records the window to a video file without stalling the frame. Each
+// capture() queues a copy of the back buffer into one of a ring of GPU pixel
+// buffers and returns at once; the buffer is mapped kReadbackDelay frames
+// later, when the copy has long finished, and its pixels go to a writer
+// thread that pipes raw RGBA into ffmpeg.
+//
+// Must be created and fed on the thread that draws the window.
+class FrameCapture {
+public:
+    static constexpr size_t kReadbackDelay = 3;
+    // Frames buffered between the readback and the writer (8 MiB at 960x540)
+    static constexpr size_t kPendingFrames = 4;
+
+    FrameCapture(const string& path, sf::Vector2u size, unsigned framesPerSecond);
+    // Collects the frames still in flight and waits for the encoder
+    ~FrameCapture();
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    bool recording() const { return encoder != nullptr && pixelBuffers[0] != 0; }
+    // Call after the frame is drawn and before window.display()
+    void capture(sf::RenderWindow& window);
+    CaptureStats stats() const;
+
+private:
+    // Buffer-object entry points; they are not in the GL 1.1 headers, so
+    // they come from the context at runtime
+    struct PixelBufferApi {
+        void(APIENTRY* genBuffers)(GLsizei, GLuint*) = nullptr;
+        void(APIENTRY* deleteBuffers)(GLsizei, const GLuint*) = nullptr;
+        void(APIENTRY* bindBuffer)(GLenum, GLuint) = nullptr;
+        void(APIENTRY* bufferData)(GLenum, ptrdiff_t, const void*, GLenum) = nullptr;
+        void*(APIENTRY* mapBuffer)(GLenum, GLenum) = nullptr;
+        GLboolean(APIENTRY* unmapBuffer)(GLenum) = nullptr;
+        void(APIENTRY* readPixels)(GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, void*) = nullptr;
+
+        bool load();
+    };
+
+    void collect(size_t slot);
+    void write();
+
+    string path;
+    sf::Vector2u size;
+    size_t frameBytes = 0;
+    PixelBufferApi gl;
+    array<GLuint, kReadbackDelay> pixelBuffers{};
+    array<bool, kReadbackDelay> inFlight{};
+    uint64_t frameCount = 0;
+
+    FILE* encoder = nullptr;
+    vector<vector<uint8_t>> frames;
+    SpscQueue<size_t, kPendingFrames> freeFrames;    // writer -> draw thread
+    SpscQueue<size_t, kPendingFrames> filledFrames;  // draw thread -> writer
+    atomic<uint64_t> written{0};
+    atomic<uint64_t> dropped{0};
+    atomic<bool> encoderFailed{false};
+    atomic<bool> stopping{false};
+    thread writer;
+};
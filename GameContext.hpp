@@ -2,11 +2,16 @@
 
 #include <SFML/Graphics.hpp>
 #include <memory>
-#include <stack>
 #include <string>
 
 using namespace std;
 
+class AssetWatcher;
+class FrameCapture;
+class MatchLog;
+class MusicEngine;
+class SpectatorServer;
+
 enum class CharacterChoice {
     Gangster1,
     Gangster3
@@ -19,6 +24,21 @@ struct GameContext {
     bool hasBackground = false;
     string selectedCharacterName = "Gangster 1";
     CharacterChoice selectedCharacter = CharacterChoice::Gangster1;
-    stack<string> actionHistory;
+    // The newest action, which the HUD shows. Literals only, so noting one
+    // never copies or allocates.
+    const char* lastAction = nullptr;
+    bool showPerfOverlay = false;
+    // Set by --serve-spectators; every stage streams to it
+    SpectatorServer* spectators = nullptr;
+    // Set by --record; every stage frame goes to it
+    FrameCapture* capture = nullptr;
+    // Set by --hot-reload; stages register their sheets and sounds with it
+    AssetWatcher* assets = nullptr;
+    // Set by --level; empty fights on the single-screen arena
+    string levelPath;
+    // Every finished match is appended here; null if the log could not open
+    MatchLog* matchLog = nullptr;
+    // Owned by main for the whole session, so tracks crossfade across scenes
+    MusicEngine* music = nullptr;
 };
 
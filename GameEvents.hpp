@@ -0,0 +1,68 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+using namespace std;
+
+#include "FixedPoint.hpp"
+#include "SpscQueue.hpp"
+
+enum class GameEventType : uint8_t {
+    Fired,
+    Hit,         // a bullet landed
+    Melee,       // a swing, landed or not
+    Reloaded,
+    Died,
+    RoundEnded
+};
+
+// Something that happened in the fight, for whoever wants to react to it.
+// `fighter` is 0 for the player and 1 for the enemy, as in MatchStats: the
+// shooter or attacker for Fired, Hit and Melee, whoever reloaded or went
+// down, and the winner for RoundEnded.
+struct GameEvent {
+    GameEventType type = GameEventType::Fired;
+    uint8_t fighter = 0;
+    bool landed = false;    // Melee only
+    bool tommyGun = false;  // Fired and Hit: the shooter is gangster 1
+    uint32_t roundTicks = 0;  // ticks into the round
+    Fixed damage;           // health taken by Hit and a landed Melee
+    sf::Vector2f position;  // muzzle, point of impact or the body's centre
+    float direction = 0.f;  // +1/-1 along x, 0 for all around
+};
+
+constexpr size_t kGameEventQueueDepth = 512;
+using GameEventQueue = SpscQueue<GameEvent, kGameEventQueueDepth>;
+
+// Hands each frame's events to every consumer as one batch. The simulation
+// only pushes into the queue, so adding a consumer costs the simulation
+// thread nothing; each one runs once per frame on the draw thread.
+class GameEventDispatcher {
+public:
+    using Consumer = function<void(const GameEvent* events, size_t count)>;
+
+    GameEventDispatcher() { batch.reserve(kGameEventQueueDepth); }
+
+    void subscribe(Consumer consumer) { consumers.push_back(move(consumer)); }
+
+    // Drains `queue` and calls every consumer with what was in it; returns
+    // the number of events. Consumers are skipped on frames with none.
+    size_t dispatch(GameEventQueue& queue) {
+        batch.clear();
+        queue.drain([&](const GameEvent& event) { batch.push_back(event); });
+        if (!batch.empty()) {
+            for (const Consumer& consumer : consumers) {
+                consumer(batch.data(), batch.size());
+            }
+        }
+        return batch.size();
+    }
+
+private:
+    vector<Consumer> consumers;
+    vector<GameEvent> batch;  // never grows past the queue's depth
+};
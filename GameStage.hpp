@@ -1,14 +1,33 @@
 #pragma once
 
 #include <SFML/Graphics.hpp>
+#include <cstdint>
 #include <queue>
+#include <vector>
 
 using namespace std;
 
+#include "AllocationTracker.hpp"
 #include "GameContext.hpp"
 
+// Filled in by non-interactive runs (see --benchmark in ElChavacano.cpp)
+struct StageStats {
+    vector<float> frameTimes;  // seconds between consecutive presented frames
+    uint64_t drawCalls = 0;
+    // Frames past each stage's warm-up, how many of them allocated on the
+    // main or the simulation thread, and what they allocated
+    uint64_t steadyFrames = 0;
+    uint64_t allocatingFrames = 0;
+    AllocationCounts steadyAllocations;
+};
+
+struct StageOptions {
+    bool scriptedPlayer = false;  // AI drives the player too; result screens are skipped
+    float durationSeconds = 0.f;  // stop after this much play time, 0 = no limit
+    StageStats* stats = nullptr;
+};
+
 class GameStage {
 public:
-    void run(sf::RenderWindow& window, GameContext& context);
+    void run(sf::RenderWindow& window, GameContext& context, const StageOptions& options = {});
 };
-
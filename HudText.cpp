@@ -0,0 +1,34 @@
+#include "HudText.hpp"
+
+#include <charconv>
+
+using namespace std;
+
+namespace {
+void appendInt(pmr::string& text, int value) {
+    char digits[12];
+    const auto result = to_chars(begin(digits), end(digits), value);
+    text.append(digits, result.ptr);
+}
+}
+
+pmr::string formatAmmo(int ammo, int reloads, pmr::memory_resource* memory) {
+    pmr::string text("Ammo: ", memory);
+    appendInt(text, ammo);
+    text += " | Reloads: ";
+    appendInt(text, reloads);
+    return text;
+}
+
+pmr::string formatTimer(int secondsLeft, pmr::memory_resource* memory) {
+    pmr::string text("Timer: ", memory);
+    appendInt(text, secondsLeft);
+    text += 's';
+    return text;
+}
+
+pmr::string formatLastAction(string_view action, pmr::memory_resource* memory) {
+    pmr::string text("Last: ", memory);
+    text += action;
+    return text;
+}
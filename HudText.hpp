@@ -0,0 +1,13 @@
+#pragma once
+
+#include <memory_resource>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+// Strings shown on the stage HUD, built in `memory`. The stage passes its
+// frame arena, so formatting them each frame never touches the heap.
+pmr::string formatAmmo(int ammo, int reloads, pmr::memory_resource* memory = pmr::get_default_resource());
+pmr::string formatTimer(int secondsLeft, pmr::memory_resource* memory = pmr::get_default_resource());
+pmr::string formatLastAction(string_view action, pmr::memory_resource* memory = pmr::get_default_resource());
@@ -0,0 +1,86 @@
+#include "IndexedSheet.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+using namespace std;
+
+namespace {
+uint32_t packColor(sf::Color color) {
+    return static_cast<uint32_t>(color.r) << 24 | static_cast<uint32_t>(color.g) << 16 |
+           static_cast<uint32_t>(color.b) << 8 | color.a;
+}
+}
+
+bool indexImage(const sf::Image& image, IndexedImage& indexed) {
+    const sf::Vector2u size = image.getSize();
+    const uint8_t* pixels = image.getPixelsPtr();
+    IndexedImage result;
+    result.size = size;
+    result.indices.resize(static_cast<size_t>(size.x) * size.y);
+    result.palette.push_back(sf::Color::Transparent);
+    unordered_map<uint32_t, uint8_t> lookup;
+    // Runs of one color are common in pixel art; skip the map for them. The
+    // starting key is transparent, which never gets this far.
+    uint32_t lastColor = 0;
+    uint8_t lastIndex = 0;
+    for (size_t i = 0; i < result.indices.size(); ++i) {
+        const uint8_t* p = pixels + i * 4;
+        if (p[3] == 0) {
+            result.indices[i] = 0;
+            continue;
+        }
+        const sf::Color color(p[0], p[1], p[2], p[3]);
+        const uint32_t key = packColor(color);
+        if (key != lastColor) {
+            auto found = lookup.find(key);
+            if (found == lookup.end()) {
+                if (result.palette.size() == kPaletteColors) {
+                    return false;
+                }
+                found = lookup.emplace(key, static_cast<uint8_t>(result.palette.size())).first;
+                result.palette.push_back(color);
+            }
+            lastColor = key;
+            lastIndex = found->second;
+        }
+        result.indices[i] = lastIndex;
+    }
+    indexed = move(result);
+    return true;
+}
+
+sf::Image packIndices(const IndexedImage& indexed) {
+    const unsigned width = (indexed.size.x + kIndicesPerTexel - 1) / kIndicesPerTexel;
+    // sf::Image has no writable pixel pointer; build the rows and copy once
+    vector<uint8_t> texels(static_cast<size_t>(width) * indexed.size.y * 4, 0);
+    for (unsigned y = 0; y < indexed.size.y; ++y) {
+        const uint8_t* row = indexed.indices.data() + static_cast<size_t>(y) * indexed.size.x;
+        uint8_t* out = texels.data() + static_cast<size_t>(y) * width * 4;
+        // Texel channels follow pixels left to right, so a row is a straight copy
+        copy(row, row + indexed.size.x, out);
+    }
+    return sf::Image(sf::Vector2u{width, indexed.size.y}, texels.data());
+}
+
+sf::Image paletteImage(const vector<sf::Color>& palette) {
+    sf::Image image(sf::Vector2u{kPaletteColors, 1}, sf::Color::Transparent);
+    for (size_t i = 0; i < palette.size() && i < kPaletteColors; ++i) {
+        image.setPixel(sf::Vector2u{static_cast<unsigned>(i), 0}, palette[i]);
+    }
+    return image;
+}
+
+bool uploadIndexed(const sf::Image& image, sf::Texture& indices, sf::Texture& palette) {
+    IndexedImage indexed;
+    if (!sf::Shader::isAvailable() || !indexImage(image, indexed)) {
+        return false;
+    }
+    if (!indices.loadFromImage(packIndices(indexed)) || !palette.loadFromImage(paletteImage(indexed.palette))) {
+        return false;
+    }
+    // Indices cannot be blended; a filtered lookup would mix unrelated colors
+    indices.setSmooth(false);
+    palette.setSmooth(false);
+    return true;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+constexpr unsigned kPaletteColors = 256;
+// Indices stored in each RGBA texel of an index texture, one per channel
+constexpr unsigned kIndicesPerTexel = 4;
+
+// An image as palette indices. Index 0 is every fully transparent pixel.
+struct IndexedImage {
+    sf::Vector2u size;
+    vector<uint8_t> indices;  // row-major
+    vector<sf::Color> palette;
+};
+
+// False if `image` has more than kPaletteColors colors
+bool indexImage(const sf::Image& image, IndexedImage& indexed);
+// Four indices per texel: pixel x of a row is channel x % 4 of texel x / 4.
+// The texture is a quarter of the RGBA one; the tail of a row is index 0.
+sf::Image packIndices(const IndexedImage& indexed);
+// kPaletteColors x 1; unused entries are transparent
+sf::Image paletteImage(const vector<sf::Color>& palette);
+
+// Uploads `image` as an index texture and a palette, both unfiltered. False,
+// with nothing uploaded, when shaders are unavailable or the image has too
+// many colors; the caller then uploads it as RGBA. Index textures are drawn
+// through the sprite shader (see SpriteShader.hpp).
+bool uploadIndexed(const sf::Image& image, sf::Texture& indices, sf::Texture& palette);
@@ -0,0 +1,72 @@
+#include "InputBuffer.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+// Headroom on top of the measured frame work before the present deadline
+constexpr auto kLatchMargin = chrono::microseconds(1500);
+}
+
+optional<InputAction> actionForKey(sf::Keyboard::Key key) {
+    switch (key) {
+    case sf::Keyboard::Key::Left: return InputAction::Left;
+    case sf::Keyboard::Key::Right: return InputAction::Right;
+    case sf::Keyboard::Key::Down: return InputAction::Run;
+    case sf::Keyboard::Key::Up: return InputAction::Jump;
+    case sf::Keyboard::Key::A: return InputAction::Shoot;
+    case sf::Keyboard::Key::S: return InputAction::Melee;
+    case sf::Keyboard::Key::R: return InputAction::Reload;
+    case sf::Keyboard::Key::Enter: return InputAction::Start;
+    default: return nullopt;
+    }
+}
+
+void LatencyTracker::record(InputClock::duration latency) {
+    samples[next] = chrono::duration<float, milli>(latency).count();
+    next = (next + 1) % kWindow;
+    count = min(count + 1, kWindow);
+}
+
+float LatencyTracker::averageMs() const {
+    if (count == 0) {
+        return 0.f;
+    }
+    float sum = 0.f;
+    for (size_t i = 0; i < count; ++i) {
+        sum += samples[i];
+    }
+    return sum / static_cast<float>(count);
+}
+
+float LatencyTracker::worstMs() const {
+    float worst = 0.f;
+    for (size_t i = 0; i < count; ++i) {
+        worst = max(worst, samples[i]);
+    }
+    return worst;
+}
+
+LateLatchPacer::LateLatchPacer(float framesPerSecond)
+    : period(chrono::duration_cast<InputClock::duration>(chrono::duration<float>(1.f / framesPerSecond))),
+      workEstimate(period / 4),
+      nextPresent(InputClock::now() + period),
+      latchTime(InputClock::now()) {}
+
+InputClock::time_point LateLatchPacer::latchDeadline() const {
+    return nextPresent - workEstimate - kLatchMargin;
+}
+
+void LateLatchPacer::presented() {
+    const auto now = InputClock::now();
+    const auto work = now - latchTime;
+    // Grow at once on a slow frame, shrink slowly so one quick frame doesn't
+    // make the next latch too late
+    workEstimate = work > workEstimate ? work : (workEstimate * 15 + work) / 16;
+    workEstimate = min(workEstimate, period);
+    nextPresent += period;
+    if (nextPresent < now) {
+        nextPresent = now + period;
+    }
+}
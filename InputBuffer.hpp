@@ -0,0 +1,106 @@
+#pragma once
+
+#include <SFML/Window.hpp>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <thread>
+
+using namespace std;
+
+#include "SpscQueue.hpp"
+
+using InputClock = chrono::steady_clock;
+
+enum class InputAction {
+    Left,
+    Right,
+    Run,
+    Jump,
+    Shoot,
+    Melee,
+    Reload,
+    Start
+};
+
+struct InputEvent {
+    InputAction action = InputAction::Left;
+    bool pressed = false;
+    InputClock::time_point time;
+};
+
+// Gameplay meaning of a key, if it has one
+optional<InputAction> actionForKey(sf::Keyboard::Key key);
+
+// Gameplay input on its way from the event loop to the simulation. The event
+// loop pushes with the earliest time each event can have arrived; the
+// simulation drains everything up to the moment it starts a tick, in arrival
+// order.
+class InputBuffer {
+public:
+    static constexpr size_t kCapacity = 256;
+
+    // Returns false (and drops the event) if the simulation has fallen that far behind
+    bool push(const InputEvent& event) { return events.push(event); }
+
+    template <typename Apply>
+    size_t drain(InputClock::time_point until, Apply&& apply) {
+        return events.drainWhile([until](const InputEvent& event) { return event.time <= until; }, apply);
+    }
+
+private:
+    SpscQueue<InputEvent, kCapacity> events;
+};
+
+// Input-to-display latency over the last few inputs that reached the screen,
+// measured from their InputEvent::time
+class LatencyTracker {
+public:
+    static constexpr size_t kWindow = 32;
+
+    void record(InputClock::duration latency);
+    float averageMs() const;
+    float worstMs() const;
+
+private:
+    array<float, kWindow> samples{};
+    size_t count = 0;
+    size_t next = 0;
+};
+
+// Frame pacing that sleeps *before* the frame reads the newest snapshot
+// instead of after the frame is shown (which is what setFramerateLimit does).
+// The snapshot is then read only as early as the frame's own work needs, so a
+// tick that lands late in the frame still makes the next present. Input does
+// not wait for the latch: the stage pumps events throughout the sleep.
+class LateLatchPacer {
+public:
+    // How often the sleep wakes to pump events
+    static constexpr auto kPumpInterval = chrono::milliseconds(1);
+
+    explicit LateLatchPacer(float framesPerSecond);
+
+    // Sleeps until the last safe moment to read a snapshot for the next
+    // frame, calling `pump` every kPumpInterval meanwhile
+    template <typename Pump>
+    void waitForLatch(Pump&& pump) {
+        const auto latchAt = latchDeadline();
+        for (auto now = InputClock::now(); now < latchAt; now = InputClock::now()) {
+            this_thread::sleep_until(min(latchAt, now + kPumpInterval));
+            pump();
+        }
+        latchTime = InputClock::now();
+    }
+    // Call right after window.display() returns
+    void presented();
+
+private:
+    InputClock::time_point latchDeadline() const;
+
+    InputClock::duration period;
+    InputClock::duration workEstimate;
+    InputClock::time_point nextPresent;
+    InputClock::time_point latchTime;
+};
@@ -1,6 +1,5 @@
 #include "IntroductionScene.hpp"
 
-#include <SFML/Audio.hpp>
 #include <memory>
 #include <string>
 #include <vector>
@@ -8,9 +7,20 @@
 #include <thread>
 #include <chrono>
 
+#include "AllocationTracker.hpp"
+#include "MusicEngine.hpp"
+#include "ResourceTracker.hpp"
+#include "SessionTrace.hpp"
+
 using namespace std;
 
+namespace {
+const MusicCue kIntroMusic{{"Intro/GodfatherTheme.mp3"}};
+}
+
 void IntroductionScene::run(sf::RenderWindow& window, GameContext& context) {
+    ResourceScope resources("Intro");
+    AllocationScene allocations("Intro");
     // Play intro video first
     bool videoPlaying = false;
     bool videoFinished = false;
@@ -18,13 +28,16 @@ void IntroductionScene::run(sf::RenderWindow& window, GameContext& context) {
     
     #ifdef __linux__
     // Try to get video duration using ffprobe
-    FILE* pipe = popen("ffprobe -v error -show_entries format=duration -of default=noprint_wrappers=1:nokey=1 Intro/Intro.mp4 2>/dev/null", "r");
-    if (pipe) {
-        char buffer[128];
-        if (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-            videoDuration = atof(buffer);
+    {
+        TraceSpan span("ffprobe", "video", "Intro/Intro.mp4");
+        FILE* pipe = popen("ffprobe -v error -show_entries format=duration -of default=noprint_wrappers=1:nokey=1 Intro/Intro.mp4 2>/dev/null", "r");
+        if (pipe) {
+            char buffer[128];
+            if (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
+                videoDuration = atof(buffer);
+            }
+            pclose(pipe);
         }
-        pclose(pipe);
     }
     
     // Check if ffplay is available
@@ -33,7 +46,10 @@ void IntroductionScene::run(sf::RenderWindow& window, GameContext& context) {
         // Hide the game window temporarily while video plays
         window.setVisible(false);
         string cmd = "ffplay -autoexit -fs -loglevel quiet Intro/Intro.mp4 2>/dev/null";
-        system(cmd.c_str());
+        {
+            TraceSpan span("ffplay", "video", "Intro/Intro.mp4");
+            system(cmd.c_str());
+        }
         window.setVisible(true);
         videoPlaying = true;
         videoFinished = true; // Video has finished playing
@@ -47,12 +63,14 @@ void IntroductionScene::run(sf::RenderWindow& window, GameContext& context) {
     unique_ptr<sf::Sprite> sprite;
     bool waitingForEnter = false;
     
-    // Load music (will play after video)
-    sf::Music music;
-    bool musicPlaying = false;
-    
     // Load Start.png
-    if (texture.loadFromFile("Intro/Start.png")) {
+    bool startLoaded = false;
+    {
+        TraceSpan span("load texture", "load", "Intro/Start.png");
+        startLoaded = texture.loadFromFile("Intro/Start.png");
+    }
+    if (startLoaded) {
+        resources.track(texture);
         sprite = make_unique<sf::Sprite>(texture);
         // Scale to fit window
         const auto windowSize = window.getSize();
@@ -67,9 +85,6 @@ void IntroductionScene::run(sf::RenderWindow& window, GameContext& context) {
         while (auto eventOpt = window.pollEvent()) {
             const auto& event = *eventOpt;
             if (event.is<sf::Event::Closed>()) {
-                if (musicPlaying) {
-                    music.stop();
-                }
                 window.close();
                 return;
             }
@@ -79,11 +94,9 @@ void IntroductionScene::run(sf::RenderWindow& window, GameContext& context) {
                 const auto& keyEvent = event.getIf<sf::Event::KeyPressed>();
                 if (keyEvent && keyEvent->code == sf::Keyboard::Key::Enter) {
                     if (waitingForEnter && !showingVideo) {
-                        // ENTER pressed - stop music and proceed
-                        if (musicPlaying) {
-                            music.stop();
-                        }
-                        context.actionHistory.push("Intro finished");
+                        // ENTER pressed - proceed; the theme plays on through selection
+                        // and crossfades into the stage's music
+                        context.lastAction = "Intro finished";
                         return;
                     }
                 }
@@ -96,10 +109,8 @@ void IntroductionScene::run(sf::RenderWindow& window, GameContext& context) {
             if (!waitingForEnter) {
                 showingVideo = false;
                 // Now start music and show Start.png
-                if (music.openFromFile("Intro/GodfatherTheme.mp3")) {
-                    music.setLooping(true);
-                    music.play();
-                    musicPlaying = true;
+                if (context.music) {
+                    context.music->play(kIntroMusic);
                 }
                 waitingForEnter = true;
             }
@@ -108,10 +119,8 @@ void IntroductionScene::run(sf::RenderWindow& window, GameContext& context) {
             if (!videoFinished) {
                 showingVideo = false;
                 videoFinished = true;
-                if (music.openFromFile("Intro/GodfatherTheme.mp3")) {
-                    music.setLooping(true);
-                    music.play();
-                    musicPlaying = true;
+                if (context.music) {
+                    context.music->play(kIntroMusic);
                 }
                 waitingForEnter = true;
             }
@@ -127,11 +136,6 @@ void IntroductionScene::run(sf::RenderWindow& window, GameContext& context) {
         }
         window.display();
     }
-    
-    // Cleanup
-    if (musicPlaying) {
-        music.stop();
-    }
 }
 
 
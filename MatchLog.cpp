@@ -0,0 +1,347 @@
+#include "MatchLog.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include "StageSimulation.hpp"
+
+using namespace std;
+
+namespace {
+// Both files start with a magic, a version and the size of what follows, so
+// a layout change is caught instead of misread
+struct FileHeader {
+    char magic[4] = {};
+    uint16_t version = 1;
+    uint16_t recordSize = 0;
+};
+static_assert(sizeof(FileHeader) == 8, "FileHeader is an on-disk format");
+
+constexpr char kLogMagic[4] = {'E', 'C', 'M', 'L'};
+constexpr char kIndexMagic[4] = {'E', 'C', 'M', 'X'};
+// Records read per fread when the index is rebuilt
+constexpr size_t kRebuildChunk = 4096;
+// By CharacterChoice
+constexpr const char* kCharacterNames[kMatchCharacters] = {"Gangster 1", "Gangster 3"};
+
+uint32_t recordChecksum(const MatchRecord& record) {
+    uint32_t hash = 2166136261u;
+    const auto* bytes = reinterpret_cast<const unsigned char*>(&record);
+    for (size_t i = 0; i < offsetof(MatchRecord, checksum); ++i) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+MatchIndexEntry indexEntryFor(const MatchRecord& record) {
+    MatchIndexEntry entry;
+    if (record.checksum != recordChecksum(record)) {
+        return entry;
+    }
+    entry.playerCharacter = record.playerCharacter;
+    entry.enemyCharacter = record.enemyCharacter;
+    entry.playerWon = record.playerWins > record.enemyWins ? 1 : 0;
+    entry.rounds = min<uint8_t>(record.rounds, static_cast<uint8_t>(entry.roundTicks.size()));
+    for (size_t i = 0; i < entry.roundTicks.size(); ++i) {
+        entry.roundTicks[i] = static_cast<uint16_t>(min<uint32_t>(record.roundTicks[i], UINT16_MAX));
+    }
+    entry.playerShots = record.shots[0];
+    entry.playerHits = record.bulletHits[0];
+    entry.playerDamage = record.damage[0];
+    return entry;
+}
+
+FileHeader headerFor(const char (&magic)[4], size_t recordSize) {
+    FileHeader header;
+    memcpy(header.magic, magic, sizeof(header.magic));
+    header.recordSize = static_cast<uint16_t>(recordSize);
+    return header;
+}
+
+bool readHeader(FILE* file, const FileHeader& expected) {
+    FileHeader header;
+    return fseek(file, 0, SEEK_SET) == 0 && fread(&header, sizeof(header), 1, file) == 1 &&
+           memcmp(&header, &expected, sizeof(header)) == 0;
+}
+
+// Opens `path` for reading and appending, creating it with `header` if it
+// does not exist yet
+FILE* openOrCreate(const string& path, const FileHeader& header) {
+    if (FILE* file = fopen(path.c_str(), "r+b")) {
+        return file;
+    }
+    FILE* file = fopen(path.c_str(), "w+b");
+    if (file && (fwrite(&header, sizeof(header), 1, file) != 1 || fflush(file) != 0)) {
+        fclose(file);
+        return nullptr;
+    }
+    return file;
+}
+
+size_t sizeOf(const string& path) {
+    error_code error;
+    const auto size = filesystem::file_size(path, error);
+    return error ? 0 : static_cast<size_t>(size);
+}
+}
+
+MatchLog::MatchLog(const string& basePath) : logPath(basePath + ".bin"), indexPath(basePath + ".idx") {
+    if (!openLog() || !openIndex()) {
+        cerr << "Warning: match results will not be saved to " << logPath << '\n';
+        if (log) {
+            fclose(log);
+            log = nullptr;
+        }
+    }
+}
+
+MatchLog::~MatchLog() {
+    unmapIndex();
+    if (log) {
+        fclose(log);
+    }
+    if (index) {
+        fclose(index);
+    }
+}
+
+bool MatchLog::openLog() {
+    const FileHeader header = headerFor(kLogMagic, sizeof(MatchRecord));
+    log = openOrCreate(logPath, header);
+    if (!log) {
+        cerr << "Warning: could not open " << logPath << '\n';
+        return false;
+    }
+    if (!readHeader(log, header)) {
+        // Someone else's file, or an older layout; leave it alone
+        cerr << "Warning: " << logPath << " is not a match log this build can read\n";
+        return false;
+    }
+    const size_t body = sizeOf(logPath) - sizeof(FileHeader);
+    recordCount = body / sizeof(MatchRecord);
+    if (body % sizeof(MatchRecord) != 0) {
+        // An append cut short; drop the partial record so the next one lines up
+        fclose(log);
+        log = nullptr;
+        error_code error;
+        filesystem::resize_file(logPath, sizeof(FileHeader) + recordCount * sizeof(MatchRecord), error);
+        log = error ? nullptr : fopen(logPath.c_str(), "r+b");
+        if (!log) {
+            cerr << "Warning: could not trim the partial record at the end of " << logPath << '\n';
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MatchLog::openIndex() {
+    const FileHeader header = headerFor(kIndexMagic, sizeof(MatchIndexEntry));
+    index = openOrCreate(indexPath, header);
+    size_t indexed = 0;
+    if (index && readHeader(index, header)) {
+        const size_t body = sizeOf(indexPath) - sizeof(FileHeader);
+        indexed = body / sizeof(MatchIndexEntry);
+        if (body % sizeof(MatchIndexEntry) != 0 || indexed > recordCount) {
+            indexed = SIZE_MAX;
+        }
+    } else {
+        indexed = SIZE_MAX;
+    }
+    if (indexed == SIZE_MAX) {
+        // Not one of ours, or out of step with the log: it is only derived
+        // data, so start it over
+        if (index) {
+            fclose(index);
+        }
+        index = fopen(indexPath.c_str(), "w+b");
+        if (!index || fwrite(&header, sizeof(header), 1, index) != 1) {
+            cerr << "Warning: could not create " << indexPath << '\n';
+            return false;
+        }
+        indexed = 0;
+    }
+    entryCount = indexed;
+    if (indexed < recordCount && !extendIndex(indexed)) {
+        return false;
+    }
+    mapIndex();
+    return true;
+}
+
+bool MatchLog::extendIndex(size_t from) {
+    vector<MatchRecord> records(kRebuildChunk);
+    vector<MatchIndexEntry> built(kRebuildChunk);
+    if (fseek(index, 0, SEEK_END) != 0) {
+        return false;
+    }
+    for (size_t next = from; next < recordCount;) {
+        const size_t count = min(kRebuildChunk, recordCount - next);
+        if (fseek(log, static_cast<long>(sizeof(FileHeader) + next * sizeof(MatchRecord)), SEEK_SET) != 0 ||
+            fread(records.data(), sizeof(MatchRecord), count, log) != count) {
+            cerr << "Warning: could not read " << logPath << " to index it\n";
+            return false;
+        }
+        transform(records.begin(), records.begin() + static_cast<ptrdiff_t>(count), built.begin(), indexEntryFor);
+        if (fseek(index, 0, SEEK_END) != 0 || fwrite(built.data(), sizeof(MatchIndexEntry), count, index) != count) {
+            cerr << "Warning: could not write " << indexPath << '\n';
+            return false;
+        }
+        next += count;
+        entryCount = next;
+    }
+    return fflush(index) == 0;
+}
+
+void MatchLog::mapIndex() {
+    unmapIndex();
+    if (entryCount == 0) {
+        return;
+    }
+    const size_t bytes = sizeof(FileHeader) + entryCount * sizeof(MatchIndexEntry);
+#ifndef _WIN32
+    void* mapped = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fileno(index), 0);
+    if (mapped != MAP_FAILED) {
+        // Summaries walk it front to back
+        posix_madvise(mapped, bytes, POSIX_MADV_SEQUENTIAL);
+        mapping = mapped;
+        mappingBytes = bytes;
+        entries = reinterpret_cast<const MatchIndexEntry*>(static_cast<const char*>(mapped) + sizeof(FileHeader));
+        return;
+    }
+#endif
+    loadedEntries.resize(entryCount);
+    if (fseek(index, static_cast<long>(sizeof(FileHeader)), SEEK_SET) != 0 ||
+        fread(loadedEntries.data(), sizeof(MatchIndexEntry), entryCount, index) != entryCount) {
+        cerr << "Warning: could not read " << indexPath << '\n';
+        loadedEntries.clear();
+        entryCount = 0;
+        return;
+    }
+    entries = loadedEntries.data();
+}
+
+void MatchLog::unmapIndex() {
+#ifndef _WIN32
+    if (mapping) {
+        munmap(mapping, mappingBytes);
+    }
+#endif
+    mapping = nullptr;
+    mappingBytes = 0;
+    entries = nullptr;
+    loadedEntries.clear();
+}
+
+bool MatchLog::append(const MatchRecord& record) {
+    return append(&record, 1);
+}
+
+bool MatchLog::append(const MatchRecord* records, size_t count) {
+    if (!isOpen() || count == 0) {
+        return isOpen();
+    }
+    vector<MatchRecord> sealed(records, records + count);
+    vector<MatchIndexEntry> built(count);
+    for (size_t i = 0; i < count; ++i) {
+        sealed[i].checksum = recordChecksum(sealed[i]);
+        built[i] = indexEntryFor(sealed[i]);
+    }
+    // The log goes first: an index entry must never point past it. If the
+    // index write fails, the next open catches up from the log.
+    if (fseek(log, 0, SEEK_END) != 0 || fwrite(sealed.data(), sizeof(MatchRecord), count, log) != count ||
+        fflush(log) != 0) {
+        cerr << "Warning: could not append to " << logPath << '\n';
+        return false;
+    }
+    recordCount += count;
+    if (entryCount + count == recordCount && fseek(index, 0, SEEK_END) == 0 &&
+        fwrite(built.data(), sizeof(MatchIndexEntry), count, index) == count && fflush(index) == 0) {
+        entryCount = recordCount;
+    } else {
+        cerr << "Warning: could not update " << indexPath << "; it is rebuilt next start\n";
+    }
+    mapIndex();
+    return true;
+}
+
+MatchSummary MatchLog::summarize() {
+    const auto start = chrono::steady_clock::now();
+    MatchSummary summary;
+    // Round lengths are small integers, so a histogram finds the median in
+    // the same pass that counts wins, with no sort
+    roundHistogram.assign(UINT16_MAX + 1, 0);
+    uint64_t shots = 0;
+    uint64_t hits = 0;
+    for (size_t i = 0; i < entryCount; ++i) {
+        const MatchIndexEntry& entry = entries[i];
+        if (entry.rounds == 0) {
+            continue;
+        }
+        ++summary.matches;
+        summary.rounds += entry.rounds;
+        if (entry.playerCharacter < kMatchCharacters) {
+            CharacterResults& results = summary.characters[entry.playerCharacter];
+            ++results.matches;
+            results.wins += entry.playerWon;
+        }
+        for (int round = 0; round < entry.rounds; ++round) {
+            ++roundHistogram[entry.roundTicks[static_cast<size_t>(round)]];
+        }
+        shots += entry.playerShots;
+        hits += entry.playerHits;
+    }
+
+    if (summary.rounds > 0) {
+        // Average of the two middle rounds; they are the same one for an odd count
+        const uint64_t lowRank = (summary.rounds - 1) / 2;
+        const uint64_t highRank = summary.rounds / 2;
+        uint64_t seen = 0;
+        size_t low = 0;
+        size_t high = 0;
+        for (size_t ticks = 0; ticks < roundHistogram.size(); ++ticks) {
+            if (seen <= lowRank && lowRank < seen + roundHistogram[ticks]) {
+                low = ticks;
+            }
+            if (seen <= highRank && highRank < seen + roundHistogram[ticks]) {
+                high = ticks;
+                break;
+            }
+            seen += roundHistogram[ticks];
+        }
+        summary.medianRoundSeconds = static_cast<double>(low + high) / 2.0 / kSimulationRate;
+    }
+    if (shots > 0) {
+        summary.playerAccuracy = static_cast<double>(hits) / static_cast<double>(shots);
+    }
+    summary.queryMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return summary;
+}
+
+string formatMatchSummary(const MatchSummary& summary) {
+    ostringstream out;
+    out << fixed << setprecision(1);
+    out << summary.matches << " matches, " << summary.rounds << " rounds\n";
+    for (int character = 0; character < kMatchCharacters; ++character) {
+        const CharacterResults& results = summary.characters[static_cast<size_t>(character)];
+        out << kCharacterNames[character] << ": " << results.matches << " played";
+        if (results.matches > 0) {
+            out << ", " << 100.0 * static_cast<double>(results.wins) / static_cast<double>(results.matches)
+                << "% won";
+        }
+        out << '\n';
+    }
+    out << "Median round: " << summary.medianRoundSeconds << " s\n";
+    out << "Shot accuracy: " << 100.0 * summary.playerAccuracy << "%\n";
+    out << setprecision(2) << "Summarized in " << summary.queryMs << " ms\n";
+    return out.str();
+}
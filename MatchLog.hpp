@@ -0,0 +1,106 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// One finished match as it is stored in the log. Index 0 of each pair is the
+// player, 1 the enemy; characters are CharacterChoice values. Records are
+// written as raw bytes, so a log only reads back on a machine of the same
+// byte order.
+struct MatchRecord {
+    uint64_t timestamp = 0;  // seconds since the epoch
+    uint8_t playerCharacter = 0;
+    uint8_t enemyCharacter = 0;
+    uint8_t playerWins = 0;
+    uint8_t enemyWins = 0;
+    uint8_t rounds = 0;
+    uint8_t reserved[3] = {};
+    array<uint32_t, 3> roundTicks{};  // kSimulationRate ticks per round
+    array<uint16_t, 2> damage{};
+    array<uint16_t, 2> shots{};
+    array<uint16_t, 2> bulletHits{};
+    array<uint16_t, 2> meleeHits{};
+    uint32_t checksum = 0;  // FNV-1a of everything above; set by append()
+};
+static_assert(sizeof(MatchRecord) == 48, "MatchRecord is an on-disk format");
+
+// What queries read: 16 bytes per match, entry i describing record i. It can
+// always be rebuilt from the log.
+struct MatchIndexEntry {
+    uint8_t playerCharacter = 0;
+    uint8_t enemyCharacter = 0;
+    uint8_t playerWon = 0;
+    uint8_t rounds = 0;  // 0 marks a record that failed its checksum
+    array<uint16_t, 3> roundTicks{};  // clamped; a round lasts at most 7200
+    uint16_t playerShots = 0;
+    uint16_t playerHits = 0;  // bullets only, to match the shots
+    uint16_t playerDamage = 0;
+};
+static_assert(sizeof(MatchIndexEntry) == 16, "MatchIndexEntry is an on-disk format");
+
+constexpr int kMatchCharacters = 2;
+
+struct CharacterResults {
+    uint64_t matches = 0;
+    uint64_t wins = 0;
+};
+
+struct MatchSummary {
+    uint64_t matches = 0;
+    uint64_t rounds = 0;
+    // The player's results with each character
+    array<CharacterResults, kMatchCharacters> characters{};
+    double medianRoundSeconds = 0.0;
+    double playerAccuracy = 0.0;  // bullet hits per shot
+    double queryMs = 0.0;
+};
+
+// Several lines of text, for the stats screen and --match-stats
+string formatMatchSummary(const MatchSummary& summary);
+
+// Append-only store of match results. `<base>.bin` holds every MatchRecord
+// in full; `<base>.idx` holds one MatchIndexEntry per record and is memory
+// mapped, so a summary is one sequential pass over 16 MB per million matches.
+//
+// A record cut short by a crash is trimmed when the log is opened, and an
+// index that is missing, stale or short is rebuilt or extended from the log.
+class MatchLog {
+public:
+    explicit MatchLog(const string& basePath);
+    ~MatchLog();
+    MatchLog(const MatchLog&) = delete;
+    MatchLog& operator=(const MatchLog&) = delete;
+
+    bool isOpen() const { return log != nullptr && index != nullptr; }
+    size_t size() const { return entryCount; }
+    bool append(const MatchRecord& record);
+    bool append(const MatchRecord* records, size_t count);
+    MatchSummary summarize();
+
+private:
+    bool openLog();
+    bool openIndex();
+    bool extendIndex(size_t from);
+    void mapIndex();
+    void unmapIndex();
+
+    string logPath;
+    string indexPath;
+    FILE* log = nullptr;
+    FILE* index = nullptr;
+    size_t recordCount = 0;
+
+    const MatchIndexEntry* entries = nullptr;
+    size_t entryCount = 0;
+    void* mapping = nullptr;
+    size_t mappingBytes = 0;
+    // Without mmap (Windows, or if mapping fails) the index is read in
+    vector<MatchIndexEntry> loadedEntries;
+    vector<uint32_t> roundHistogram;  // reused by summarize()
+};
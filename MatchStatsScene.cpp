@@ -0,0 +1,62 @@
+#include "MatchStatsScene.hpp"
+
+#include "MatchLog.hpp"
+
+using namespace std;
+
+void MatchStatsScene::run(sf::RenderWindow& window, GameContext& context) {
+    if (!context.matchLog) {
+        return;
+    }
+    // The log only grows between matches, so one summary lasts the scene
+    const MatchSummary summary = context.matchLog->summarize();
+
+    sf::Text title(context.font, "Match stats");
+    title.setCharacterSize(40);
+    title.setFillColor(sf::Color::White);
+    title.setStyle(sf::Text::Bold);
+    title.setPosition(sf::Vector2f{80.f, 60.f});
+
+    sf::Text body(context.font, summary.matches > 0 ? formatMatchSummary(summary) : "No matches played yet\n");
+    body.setCharacterSize(26);
+    body.setLineSpacing(1.3f);
+    body.setFillColor(sf::Color(220, 220, 220));
+    body.setPosition(sf::Vector2f{80.f, 140.f});
+
+    sf::Text hint(context.font, "Press ESC to go back");
+    hint.setCharacterSize(20);
+    hint.setFillColor(sf::Color(160, 160, 160));
+    hint.setPosition(sf::Vector2f{80.f, 480.f});
+
+    while (window.isOpen()) {
+        while (auto eventOpt = window.pollEvent()) {
+            const auto& event = *eventOpt;
+            if (event.is<sf::Event::Closed>()) {
+                window.close();
+                return;
+            }
+            if (const auto keyEvent = event.getIf<sf::Event::KeyPressed>()) {
+                if (keyEvent->code == sf::Keyboard::Key::Escape || keyEvent->code == sf::Keyboard::Key::Enter ||
+                    keyEvent->code == sf::Keyboard::Key::S) {
+                    return;
+                }
+            }
+        }
+
+        if (context.hasBackground && context.backgroundSprite) {
+            window.clear();
+            window.draw(*context.backgroundSprite);
+            // Dim the art so the numbers stay readable
+            sf::RectangleShape shade(
+                sf::Vector2f{static_cast<float>(window.getSize().x), static_cast<float>(window.getSize().y)});
+            shade.setFillColor(sf::Color(0, 0, 0, 170));
+            window.draw(shade);
+        } else {
+            window.clear(sf::Color(12, 12, 30));
+        }
+        window.draw(title);
+        window.draw(body);
+        window.draw(hint);
+        window.display();
+    }
+}
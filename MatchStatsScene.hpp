@@ -0,0 +1,12 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+
+#include "GameContext.hpp"
+
+// Win rates, round lengths and accuracy over every logged match. Shown from
+// character selection; any of ESC, ENTER or S goes back.
+class MatchStatsScene {
+public:
+    void run(sf::RenderWindow& window, GameContext& context);
+};
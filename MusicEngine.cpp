@@ -0,0 +1,329 @@
+#include "MusicEngine.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+using namespace std;
+
+#include "SessionTrace.hpp"
+
+namespace {
+constexpr unsigned kMusicSampleRate = 44100;
+// Decoded ahead of the audio callback, per deck
+constexpr size_t kRingFrames = kMusicSampleRate / 2;
+// Frames mixed per audio callback
+constexpr size_t kMixFrames = 1024;
+// Source frames read from a stem's file at a time
+constexpr size_t kDecodeFrames = 4096;
+// The decode thread tops the buffers up this often
+constexpr chrono::milliseconds kDecodeInterval(10);
+constexpr float kCrossfadeSeconds = 1.5f;
+constexpr float kLayerFadeSeconds = 1.f;
+// Cutoff of the low-pass filter at brightness 0; at 1 it is bypassed
+constexpr float kMutedCutoffHz = 400.f;
+constexpr float kOpenCutoffHz = 16000.f;
+constexpr float kPi = 3.14159265f;
+
+int16_t toSample(float value) {
+    return static_cast<int16_t>(clamp(value, -32768.f, 32767.f));
+}
+
+// Moves `value` toward `target` by at most `step`
+float approach(float value, float target, float step) {
+    return value < target ? min(value + step, target) : max(value - step, target);
+}
+}
+
+bool MusicCue::empty() const {
+    return none_of(stems.begin(), stems.end(), [](const char* stem) { return stem != nullptr; });
+}
+
+bool MusicCue::operator==(const MusicCue& other) const {
+    for (size_t layer = 0; layer < kMusicLayers; ++layer) {
+        const char* a = stems[layer];
+        const char* b = other.stems[layer];
+        if (a != b && (a == nullptr || b == nullptr || strcmp(a, b) != 0)) {
+            return false;
+        }
+    }
+    return volume == other.volume;
+}
+
+MusicEngine::Output::Output(MusicEngine& engine) : engine(engine) {
+    initialize(2, kMusicSampleRate, {sf::SoundChannel::FrontLeft, sf::SoundChannel::FrontRight});
+}
+
+MusicEngine::Output::~Output() {
+    // SFML requires streams to stop before their data source goes away
+    stop();
+}
+
+bool MusicEngine::Output::onGetData(Chunk& data) {
+    engine.mix(engine.mixed.data(), kMixFrames);
+    data.samples = engine.mixed.data();
+    data.sampleCount = engine.mixed.size();
+    // Never ends; with nothing playing it streams silence
+    return true;
+}
+
+MusicEngine::MusicEngine() : output(*this) {
+    for (size_t layer = 0; layer < kMusicLayers; ++layer) {
+        layerTargets[layer].store(MusicMix().layers[layer], memory_order_relaxed);
+    }
+    for (Deck& deck : decks) {
+        deck.ring.assign(kRingFrames * kMusicLayers * 2, 0);
+    }
+    accumulated.assign(kMixFrames * 2, 0.f);
+    mixed.assign(kMixFrames * 2, 0);
+    decoder = thread([this] { run(); });
+    output.play();
+}
+
+MusicEngine::~MusicEngine() {
+    output.stop();
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    decoder.join();
+}
+
+void MusicEngine::play(const MusicCue& cue, const MusicMix& mix) {
+    setMix(mix);
+    {
+        lock_guard<mutex> guard(lock);
+        pending = cue;
+    }
+    wake.notify_one();
+}
+
+void MusicEngine::stop() {
+    play(MusicCue());
+}
+
+void MusicEngine::setMix(const MusicMix& mix) {
+    for (size_t layer = 0; layer < kMusicLayers; ++layer) {
+        layerTargets[layer].store(clamp(mix.layers[layer], 0.f, 1.f), memory_order_relaxed);
+    }
+    brightnessTarget.store(clamp(mix.brightness, 0.f, 1.f), memory_order_relaxed);
+}
+
+size_t MusicEngine::bufferBytes() const {
+    size_t bytes = mixed.size() * sizeof(int16_t) + accumulated.size() * sizeof(float);
+    for (const Deck& deck : decks) {
+        bytes += deck.ring.size() * sizeof(int16_t);
+    }
+    return bytes;
+}
+
+void MusicEngine::run() {
+    SessionTrace::instance().nameThread("music");
+    unique_lock<mutex> guard(lock);
+    while (!stopping) {
+        if (pending) {
+            const MusicCue cue = *pending;
+            guard.unlock();
+            const bool started = startDeck(cue);
+            guard.lock();
+            // A newer request that came in meanwhile is handled next time round
+            if (started && pending && *pending == cue) {
+                pending.reset();
+            }
+        }
+        guard.unlock();
+        for (Deck& deck : decks) {
+            if (deck.live.load(memory_order_acquire)) {
+                fill(deck);
+            }
+        }
+        guard.lock();
+        // Not waiting on a predicate: a cue that found no free deck is retried
+        // after the next interval, once the crossfade has released one
+        if (!stopping) {
+            wake.wait_for(guard, kDecodeInterval);
+        }
+    }
+}
+
+bool MusicEngine::startDeck(const MusicCue& cue) {
+    Deck* current = nullptr;
+    Deck* idle = nullptr;
+    for (Deck& deck : decks) {
+        if (!deck.live.load(memory_order_acquire)) {
+            idle = &deck;
+        } else if (!deck.fadingOut.load(memory_order_relaxed)) {
+            current = &deck;
+        }
+    }
+    if (cue.empty()) {
+        if (current) {
+            current->fadingOut.store(true, memory_order_release);
+        }
+        return true;
+    }
+    if (current && current->cue == cue) {
+        return true;
+    }
+    if (!idle) {
+        // Both decks are busy mid-crossfade
+        return false;
+    }
+    bool opened = false;
+    for (size_t layer = 0; layer < kMusicLayers; ++layer) {
+        idle->stems[layer] = Stem();
+        if (cue.stems[layer] != nullptr && openStem(idle->stems[layer], cue.stems[layer])) {
+            opened = true;
+        }
+    }
+    if (!opened) {
+        // Keep whatever is playing rather than fading to silence
+        return true;
+    }
+    idle->cue = cue;
+    idle->written.store(0, memory_order_relaxed);
+    idle->consumed.store(0, memory_order_relaxed);
+    fill(*idle);
+    if (current) {
+        current->fadingOut.store(true, memory_order_release);
+    }
+    idle->fadingOut.store(false, memory_order_relaxed);
+    idle->generation.fetch_add(1, memory_order_relaxed);
+    // Publishes the deck, its cue and its first buffer to the audio callback
+    idle->live.store(true, memory_order_release);
+    return true;
+}
+
+bool MusicEngine::openStem(Stem& stem, const char* path) {
+    // Layers are optional: a track without a combat stem just has none
+    error_code ignored;
+    if (!filesystem::exists(path, ignored)) {
+        return false;
+    }
+    TraceSpan span("open music", "load", path);
+    auto file = make_unique<sf::InputSoundFile>();
+    if (!file->openFromFile(path) || file->getChannelCount() == 0 || file->getSampleRate() == 0) {
+        cerr << "Warning: could not open music " << path << '\n';
+        return false;
+    }
+    stem.channels = file->getChannelCount();
+    stem.step = static_cast<double>(file->getSampleRate()) / kMusicSampleRate;
+    stem.source.assign(kDecodeFrames * stem.channels, 0);
+    stem.file = move(file);
+    stem.previous = sourceFrame(stem);
+    stem.next = sourceFrame(stem);
+    return true;
+}
+
+bool MusicEngine::readSource(Stem& stem) {
+    uint64_t count = stem.file->read(stem.source.data(), stem.source.size());
+    if (count < stem.channels) {
+        // End of the stem: loop it
+        stem.file->seek(0);
+        count = stem.file->read(stem.source.data(), stem.source.size());
+    }
+    stem.sourceAt = 0;
+    stem.sourceEnd = static_cast<size_t>(count - count % stem.channels);
+    return stem.sourceEnd > 0;
+}
+
+array<float, 2> MusicEngine::sourceFrame(Stem& stem) {
+    if (stem.sourceAt >= stem.sourceEnd && !readSource(stem)) {
+        return {0.f, 0.f};
+    }
+    const int16_t* frame = stem.source.data() + stem.sourceAt;
+    stem.sourceAt += stem.channels;
+    // Mono plays on both sides; channels past the first two are dropped
+    return {static_cast<float>(frame[0]), static_cast<float>(stem.channels > 1 ? frame[1] : frame[0])};
+}
+
+array<float, 2> MusicEngine::nextFrame(Stem& stem) {
+    // Linear interpolation is plenty for music that is 44.1 or 48 kHz already
+    while (stem.phase >= 1.0) {
+        stem.previous = stem.next;
+        stem.next = sourceFrame(stem);
+        stem.phase -= 1.0;
+    }
+    const float t = static_cast<float>(stem.phase);
+    stem.phase += stem.step;
+    return {stem.previous[0] + (stem.next[0] - stem.previous[0]) * t,
+            stem.previous[1] + (stem.next[1] - stem.previous[1]) * t};
+}
+
+void MusicEngine::fill(Deck& deck) {
+    const uint64_t written = deck.written.load(memory_order_relaxed);
+    const uint64_t space = kRingFrames - (written - deck.consumed.load(memory_order_acquire));
+    for (uint64_t i = 0; i < space; ++i) {
+        int16_t* frame = deck.ring.data() + ((written + i) % kRingFrames) * kMusicLayers * 2;
+        for (size_t layer = 0; layer < kMusicLayers; ++layer) {
+            Stem& stem = deck.stems[layer];
+            const array<float, 2> samples = stem.file ? nextFrame(stem) : array<float, 2>{0.f, 0.f};
+            frame[layer * 2] = toSample(samples[0]);
+            frame[layer * 2 + 1] = toSample(samples[1]);
+        }
+    }
+    deck.written.store(written + space, memory_order_release);
+}
+
+void MusicEngine::mix(int16_t* samples, size_t frames) {
+    fill_n(accumulated.begin(), frames * 2, 0.f);
+    const float fadeStep = 1.f / (kCrossfadeSeconds * kMusicSampleRate);
+    const float layerStep = 1.f / (kLayerFadeSeconds * kMusicSampleRate);
+    array<float, kMusicLayers> targets;
+    for (size_t layer = 0; layer < kMusicLayers; ++layer) {
+        targets[layer] = layerTargets[layer].load(memory_order_relaxed);
+    }
+    for (Deck& deck : decks) {
+        if (!deck.live.load(memory_order_acquire)) {
+            continue;
+        }
+        const uint32_t generation = deck.generation.load(memory_order_relaxed);
+        if (deck.seenGeneration != generation) {
+            // A new track fades in with the mix as it stands
+            deck.seenGeneration = generation;
+            deck.fade = 0.f;
+            deck.gains = targets;
+        }
+        const float fadeTarget = deck.fadingOut.load(memory_order_acquire) ? 0.f : 1.f;
+        const float volume = deck.cue.volume / 100.f;
+        const uint64_t consumed = deck.consumed.load(memory_order_relaxed);
+        const uint64_t available = deck.written.load(memory_order_acquire) - consumed;
+        const size_t ready = static_cast<size_t>(min<uint64_t>(frames, available));
+        if (ready < frames) {
+            underrunCount.fetch_add(1, memory_order_relaxed);
+        }
+        for (size_t i = 0; i < ready; ++i) {
+            deck.fade = approach(deck.fade, fadeTarget, fadeStep);
+            const int16_t* frame = deck.ring.data() + ((consumed + i) % kRingFrames) * kMusicLayers * 2;
+            float left = 0.f;
+            float right = 0.f;
+            for (size_t layer = 0; layer < kMusicLayers; ++layer) {
+                deck.gains[layer] = approach(deck.gains[layer], targets[layer], layerStep);
+                left += frame[layer * 2] * deck.gains[layer];
+                right += frame[layer * 2 + 1] * deck.gains[layer];
+            }
+            accumulated[i * 2] += left * deck.fade * volume;
+            accumulated[i * 2 + 1] += right * deck.fade * volume;
+        }
+        deck.consumed.store(consumed + ready, memory_order_release);
+        if (fadeTarget == 0.f && deck.fade == 0.f) {
+            // Hands the deck back to the decode thread
+            deck.live.store(false, memory_order_release);
+        }
+    }
+
+    // Brightness moves once per callback, which is smooth enough at ~23 ms
+    const float chunkSeconds = static_cast<float>(frames) / kMusicSampleRate;
+    brightness = approach(brightness, brightnessTarget.load(memory_order_relaxed), chunkSeconds / kLayerFadeSeconds);
+    const float cutoff = kMutedCutoffHz * pow(kOpenCutoffHz / kMutedCutoffHz, brightness);
+    const float alpha = brightness >= 1.f ? 1.f : 1.f - exp(-2.f * kPi * cutoff / kMusicSampleRate);
+    for (size_t i = 0; i < frames * 2; ++i) {
+        float& state = lowPass[i % 2];
+        state += alpha * (accumulated[i] - state);
+        samples[i] = toSample(state);
+    }
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <SFML/Audio.hpp>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Stems per track, mixed in sync: calm, combat and low health on the stage
+constexpr size_t kMusicLayers = 3;
+
+// A track to play. Stems are file paths (literals) that all start together
+// and loop on their own; a null or missing stem is a silent layer.
+struct MusicCue {
+    array<const char*, kMusicLayers> stems{};
+    float volume = 100.f;  // 0-100, like sf::SoundSource
+
+    bool empty() const;
+    bool operator==(const MusicCue& other) const;
+};
+
+// How loud each layer of the playing track is (0-1) and how open its sound
+// is: 1 plays it as is, lower values muffle it through a low-pass filter.
+// Changes glide over a second rather than jumping.
+struct MusicMix {
+    array<float, kMusicLayers> layers{1.f, 0.f, 0.f};
+    float brightness = 1.f;
+};
+
+// All the game's music, streamed through one SFML stream fed by one decode
+// thread. Each track's stems are decoded ahead into a fixed-size ring
+// buffer, so the audio callback only mixes and memory never grows. play()
+// opens the next track on the decode thread while the current one keeps
+// going, then crossfades, so there is no gap between scenes.
+class MusicEngine {
+public:
+    MusicEngine();
+    ~MusicEngine();
+    MusicEngine(const MusicEngine&) = delete;
+    MusicEngine& operator=(const MusicEngine&) = delete;
+
+    // Crossfades to `cue` and glides to `mix`; asking for the track already
+    // playing only changes the mix
+    void play(const MusicCue& cue, const MusicMix& mix = MusicMix());
+    // Fades the playing track out
+    void stop();
+    // Takes effect on the playing track and carries over to the next one
+    void setMix(const MusicMix& mix);
+    void setVolume(float volume) { output.setVolume(volume); }
+
+    // Read-ahead buffers for both decks, allocated once
+    size_t bufferBytes() const;
+    // Audio callbacks that found a deck's buffer short and played silence
+    uint64_t underruns() const { return underrunCount.load(memory_order_relaxed); }
+
+private:
+    // One stem being decoded and resampled to the output rate
+    struct Stem {
+        unique_ptr<sf::InputSoundFile> file;
+        unsigned channels = 0;
+        double step = 1.0;   // source frames per output frame
+        double phase = 0.0;  // position between `previous` and `next`
+        array<float, 2> previous{};
+        array<float, 2> next{};
+        vector<int16_t> source;  // decoded, not yet resampled
+        size_t sourceAt = 0;
+        size_t sourceEnd = 0;
+    };
+    // A track and its ring buffer. The decode thread owns a deck until it
+    // sets `live`; the audio callback owns it again once it clears `live`.
+    struct Deck {
+        MusicCue cue;
+        array<Stem, kMusicLayers> stems;  // decode thread only
+        vector<int16_t> ring;             // frames of kMusicLayers stereo samples
+        atomic<uint64_t> written{0};      // frames, advanced by the decode thread
+        atomic<uint64_t> consumed{0};     // frames, advanced by the audio callback
+        atomic<bool> live{false};
+        atomic<bool> fadingOut{false};
+        atomic<uint32_t> generation{0};  // bumped each time the deck starts a track
+        // Audio callback only
+        uint32_t seenGeneration = 0;
+        float fade = 0.f;
+        array<float, kMusicLayers> gains{};
+    };
+
+    class Output : public sf::SoundStream {
+    public:
+        explicit Output(MusicEngine& engine);
+        ~Output() override;
+
+    protected:
+        bool onGetData(Chunk& data) override;
+        void onSeek(sf::Time) override {}
+
+    private:
+        MusicEngine& engine;
+    };
+
+    void run();
+    bool startDeck(const MusicCue& cue);
+    bool openStem(Stem& stem, const char* path);
+    void fill(Deck& deck);
+    array<float, 2> nextFrame(Stem& stem);
+    array<float, 2> sourceFrame(Stem& stem);
+    bool readSource(Stem& stem);
+    void mix(int16_t* samples, size_t frames);
+
+    array<Deck, 2> decks;
+    // Targets set by the main thread, followed by the audio callback
+    array<atomic<float>, kMusicLayers> layerTargets;
+    atomic<float> brightnessTarget{1.f};
+    // Audio callback only
+    float brightness = 1.f;
+    array<float, 2> lowPass{};
+    vector<float> accumulated;
+    vector<int16_t> mixed;
+    atomic<uint64_t> underrunCount{0};
+
+    mutex lock;
+    condition_variable wake;
+    optional<MusicCue> pending;  // guarded by `lock`
+    bool stopping = false;       // guarded by `lock`
+    thread decoder;
+    Output output;
+};
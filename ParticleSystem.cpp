@@ -0,0 +1,192 @@
+#include "ParticleSystem.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+constexpr float kPi = 3.14159265f;
+constexpr unsigned kGlowTextureSize = 32;
+constexpr unsigned kSolidTextureSize = 4;
+
+// White radial falloff; tinted per particle through the vertex color
+sf::Image makeGlowImage() {
+    sf::Image image(sf::Vector2u{kGlowTextureSize, kGlowTextureSize}, sf::Color::Transparent);
+    const float centre = (kGlowTextureSize - 1) / 2.f;
+    for (unsigned y = 0; y < kGlowTextureSize; ++y) {
+        for (unsigned x = 0; x < kGlowTextureSize; ++x) {
+            const float dx = (static_cast<float>(x) - centre) / centre;
+            const float dy = (static_cast<float>(y) - centre) / centre;
+            const float falloff = max(0.f, 1.f - sqrt(dx * dx + dy * dy));
+            image.setPixel(sf::Vector2u{x, y},
+                           sf::Color(255, 255, 255, static_cast<uint8_t>(255.f * falloff * falloff)));
+        }
+    }
+    return image;
+}
+}
+
+ParticleSystem::ParticleSystem() {
+    for (Layer* layer : {&glow, &solid}) {
+        for (vector<float>* values : {&layer->x, &layer->y, &layer->vx, &layer->vy, &layer->life, &layer->lifetime,
+                                      &layer->size, &layer->gravity}) {
+            values->resize(kCapacityPerLayer);
+        }
+        layer->color.resize(kCapacityPerLayer);
+        // Grow once to the worst case so later resizes never reallocate
+        layer->vertices.resize(kCapacityPerLayer * 6);
+        layer->vertices.clear();
+    }
+    if (glow.texture.loadFromImage(makeGlowImage())) {
+        glow.texture.setSmooth(true);
+    }
+    (void)solid.texture.loadFromImage(
+        sf::Image(sf::Vector2u{kSolidTextureSize, kSolidTextureSize}, sf::Color::White));
+    glow.blend = sf::BlendAdd;
+    solid.blend = sf::BlendAlpha;
+}
+
+float ParticleSystem::random(float low, float high) {
+    // xorshift32: cheap, allocation-free and good enough for sparks
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return low + (high - low) * (static_cast<float>(rngState >> 8) / static_cast<float>(1u << 24));
+}
+
+void ParticleSystem::spawn(Layer& layer, const sf::Vector2f& position, float angle, float speed, float lifetime,
+                           float size, float gravity, sf::Color color) {
+    if (layer.count >= kCapacityPerLayer) {
+        return;  // Full: the oldest sparks are about to die anyway
+    }
+    const size_t i = layer.count++;
+    layer.x[i] = position.x;
+    layer.y[i] = position.y;
+    layer.vx[i] = cos(angle) * speed;
+    layer.vy[i] = sin(angle) * speed;
+    layer.life[i] = lifetime;
+    layer.lifetime[i] = lifetime;
+    layer.size[i] = size;
+    layer.gravity[i] = gravity;
+    layer.color[i] = color;
+}
+
+void ParticleSystem::spray(Layer& layer, int count, const sf::Vector2f& position, float baseAngle, float spread,
+                           float minSpeed, float maxSpeed, float minLife, float maxLife, float minSize,
+                           float maxSize, float gravity, sf::Color color) {
+    for (int n = 0; n < count; ++n) {
+        spawn(layer, position, baseAngle + random(-spread, spread), random(minSpeed, maxSpeed),
+              random(minLife, maxLife), random(minSize, maxSize), gravity, color);
+    }
+}
+
+void ParticleSystem::emit(const EffectEvent& event) {
+    // Screen y grows downwards, so "up" is -pi/2
+    const float forward = event.direction < 0.f ? kPi : 0.f;
+    switch (event.effect) {
+    case ParticleEffect::MuzzleFlash:
+        spray(glow, 10, event.position, forward, 0.35f, 60.f, 220.f, 0.06f, 0.12f, 10.f, 22.f, 0.f,
+              sf::Color(255, 200, 90));
+        break;
+    case ParticleEffect::ShellCasing:
+        // Ejected up and back over the shooter's shoulder
+        spray(solid, 1, event.position, -kPi / 2.f - (event.direction < 0.f ? -0.5f : 0.5f), 0.2f, 160.f, 260.f,
+              0.6f, 0.9f, 3.f, 3.f, 900.f, sf::Color(200, 160, 60));
+        break;
+    case ParticleEffect::Blood:
+        spray(solid, 24, event.position, forward, 0.8f, 80.f, 320.f, 0.35f, 0.7f, 2.f, 4.5f, 700.f,
+              sf::Color(170, 0, 0));
+        break;
+    case ParticleEffect::DeathBurst:
+        spray(solid, 160, event.position, -kPi / 2.f, kPi * 0.6f, 60.f, 380.f, 0.5f, 1.1f, 2.f, 5.f, 700.f,
+              sf::Color(150, 0, 0));
+        break;
+    }
+}
+
+void ParticleSystem::update(float delta) {
+    for (Layer* layerPtr : {&glow, &solid}) {
+        Layer& layer = *layerPtr;
+        const size_t count = layer.count;
+        float* x = layer.x.data();
+        float* y = layer.y.data();
+        float* vx = layer.vx.data();
+        float* vy = layer.vy.data();
+        float* life = layer.life.data();
+        const float* gravity = layer.gravity.data();
+        // Straight loops over plain arrays, which the compiler vectorises
+        for (size_t i = 0; i < count; ++i) {
+            vy[i] += gravity[i] * delta;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            x[i] += vx[i] * delta;
+            y[i] += vy[i] * delta;
+            life[i] -= delta;
+        }
+
+        // Retire dead particles by moving the last live one into their slot
+        size_t live = count;
+        for (size_t i = 0; i < live;) {
+            if (life[i] > 0.f) {
+                ++i;
+                continue;
+            }
+            --live;
+            x[i] = x[live];
+            y[i] = y[live];
+            vx[i] = vx[live];
+            vy[i] = vy[live];
+            life[i] = life[live];
+            layer.lifetime[i] = layer.lifetime[live];
+            layer.size[i] = layer.size[live];
+            layer.gravity[i] = layer.gravity[live];
+            layer.color[i] = layer.color[live];
+        }
+        layer.count = live;
+
+        // Two triangles per particle; resize stays inside the capacity reserved up front
+        layer.vertices.resize(live * 6);
+        const sf::Vector2f texSize(layer.texture.getSize());
+        for (size_t i = 0; i < live; ++i) {
+            const float half = layer.size[i] * 0.5f;
+            sf::Color color = layer.color[i];
+            color.a = static_cast<uint8_t>(255.f * min(1.f, life[i] / layer.lifetime[i]));
+            const sf::Vector2f topLeft{x[i] - half, y[i] - half};
+            const sf::Vector2f bottomRight{x[i] + half, y[i] + half};
+            sf::Vertex* quad = &layer.vertices[i * 6];
+            quad[0] = {topLeft, color, {0.f, 0.f}};
+            quad[1] = {{bottomRight.x, topLeft.y}, color, {texSize.x, 0.f}};
+            quad[2] = {{topLeft.x, bottomRight.y}, color, {0.f, texSize.y}};
+            quad[3] = quad[2];
+            quad[4] = quad[1];
+            quad[5] = {bottomRight, color, texSize};
+        }
+    }
+}
+
+int ParticleSystem::draw(sf::RenderTarget& target) const {
+    int drawCalls = 0;
+    for (const Layer* layer : {&glow, &solid}) {
+        if (layer->count == 0) continue;
+        sf::RenderStates states(&layer->texture);
+        states.blendMode = layer->blend;
+        target.draw(layer->vertices, states);
+        ++drawCalls;
+    }
+    return drawCalls;
+}
+
+size_t ParticleSystem::liveCount() const {
+    return glow.count + solid.count;
+}
+
+array<const sf::Texture*, 2> ParticleSystem::textures() const {
+    return {&glow.texture, &solid.texture};
+}
+
+size_t ParticleSystem::memoryBytes() const {
+    // Eight float arrays and a color array per layer, plus its vertices
+    constexpr size_t perParticle = 8 * sizeof(float) + sizeof(sf::Color) + 6 * sizeof(sf::Vertex);
+    return 2 * kCapacityPerLayer * perParticle;
+}
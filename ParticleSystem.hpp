@@ -0,0 +1,67 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+enum class ParticleEffect {
+    MuzzleFlash,
+    ShellCasing,
+    Blood,
+    DeathBurst
+};
+
+// Where an effect should play; direction is +1/-1 along x, 0 for all around
+struct EffectEvent {
+    ParticleEffect effect = ParticleEffect::MuzzleFlash;
+    sf::Vector2f position;
+    float direction = 0.f;
+};
+
+// Purely visual particles. Storage is structure-of-arrays with a fixed
+// capacity per texture, allocated once; each texture is drawn as a single
+// vertex array, so the cost per frame is two draw calls however many
+// particles are alive.
+class ParticleSystem {
+public:
+    static constexpr size_t kCapacityPerLayer = 32768;
+
+    // Builds the particle textures, so it needs a GL context
+    ParticleSystem();
+
+    void emit(const EffectEvent& event);
+    // Moves and ages every particle, then rebuilds the vertex arrays
+    void update(float delta);
+    // Returns the number of draw calls issued
+    int draw(sf::RenderTarget& target) const;
+
+    size_t liveCount() const;
+    // Textures only; the CPU-side arrays are counted by memoryBytes()
+    array<const sf::Texture*, 2> textures() const;
+    size_t memoryBytes() const;
+
+private:
+    // Particles sharing one texture and blend mode
+    struct Layer {
+        vector<float> x, y, vx, vy, life, lifetime, size, gravity;
+        vector<sf::Color> color;
+        size_t count = 0;
+        sf::VertexArray vertices{sf::PrimitiveType::Triangles};
+        sf::Texture texture;
+        sf::BlendMode blend = sf::BlendAlpha;
+    };
+
+    void spawn(Layer& layer, const sf::Vector2f& position, float angle, float speed, float lifetime, float size,
+               float gravity, sf::Color color);
+    void spray(Layer& layer, int count, const sf::Vector2f& position, float baseAngle, float spread,
+               float minSpeed, float maxSpeed, float minLife, float maxLife, float minSize, float maxSize,
+               float gravity, sf::Color color);
+    float random(float low, float high);
+
+    Layer glow;   // additive soft dots: flashes
+    Layer solid;  // opaque chips: blood, casings
+    uint32_t rngState = 0x9E3779B9u;
+};
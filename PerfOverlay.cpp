@@ -0,0 +1,104 @@
+#include "PerfOverlay.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "ResourceTracker.hpp"
+
+using namespace std;
+
+namespace {
+constexpr float kRefreshInterval = 0.25f;
+
+double mebibytes(size_t bytes) {
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+}
+
+PerfOverlay::PerfOverlay(const sf::Font& font)
+    : text(font, "", 14) {
+    text.setFillColor(sf::Color(180, 255, 180));
+    text.setPosition(sf::Vector2f{14.f, 96.f});
+    panel.setFillColor(sf::Color(0, 0, 0, 170));
+    panel.setPosition(sf::Vector2f{8.f, 90.f});
+    rebuild();
+}
+
+void PerfOverlay::update(float delta) {
+    frameTimeSum += delta;
+    worstFrameTime = max(worstFrameTime, delta);
+    ++frames;
+    refreshTimer += delta;
+    if (refreshTimer < kRefreshInterval) {
+        return;
+    }
+    averageFrameTime = frameTimeSum / static_cast<float>(frames);
+    shownWorstFrameTime = worstFrameTime;
+    if (allocationFrames > 0) {
+        shownAllocationsPerFrame = static_cast<double>(frameAllocationSum.allocations) / allocationFrames;
+        shownBytesPerFrame = static_cast<double>(frameAllocationSum.bytes) / allocationFrames;
+        shownWorstAllocations = worstFrameAllocations;
+    }
+    allocationFrames = 0;
+    frameAllocationSum = AllocationCounts();
+    worstFrameAllocations = 0;
+    refreshTimer = 0.f;
+    frameTimeSum = 0.f;
+    worstFrameTime = 0.f;
+    frames = 0;
+    rebuild();
+}
+
+void PerfOverlay::setInputLatency(float averageMs, float worstMs) {
+    inputLatencyMs = averageMs;
+    worstInputLatencyMs = worstMs;
+}
+
+void PerfOverlay::setFrameAllocations(const AllocationCounts& frame) {
+    ++allocationFrames;
+    frameAllocationSum.allocations += frame.allocations;
+    frameAllocationSum.bytes += frame.bytes;
+    worstFrameAllocations = max(worstFrameAllocations, frame.allocations);
+}
+
+void PerfOverlay::rebuild() {
+    ostringstream oss;
+    oss << fixed << setprecision(1);
+    const float fps = averageFrameTime > 0.f ? 1.f / averageFrameTime : 0.f;
+    oss << "FPS " << fps << "  frame " << averageFrameTime * 1000.f << " ms  worst "
+        << shownWorstFrameTime * 1000.f << " ms\n";
+    if (inputLatencyMs >= 0.f) {
+        oss << "Input " << inputLatencyMs << " ms  worst " << worstInputLatencyMs << " ms\n";
+    } else {
+        oss << "Input -\n";
+    }
+    // Includes this overlay's own rebuilds, a few a second
+    oss << "Alloc " << shownAllocationsPerFrame << "/frame  " << shownBytesPerFrame / 1024.0 << " KiB/frame  worst "
+        << shownWorstAllocations << '\n';
+    oss << setprecision(0);
+    for (const auto& [scene, counts] : AllocationTracker::instance().sceneTotals()) {
+        oss << "  " << scene << " " << counts.allocations << " allocs, " << counts.bytes / 1024 << " KiB\n";
+    }
+
+    const auto& tracker = ResourceTracker::instance();
+    const auto totals = tracker.totals();
+    const size_t vram = totals.current[static_cast<size_t>(ResourceCategory::Texture)];
+    const size_t vramPeak = totals.peak[static_cast<size_t>(ResourceCategory::Texture)];
+    oss << setprecision(2) << "VRAM " << mebibytes(vram) << " MiB (peak " << mebibytes(vramPeak) << ")  RAM "
+        << mebibytes(totals.currentTotal - vram) << " MiB\n";
+    for (const auto& [scene, usage] : tracker.scenes()) {
+        if (usage.currentTotal == 0) continue;
+        oss << "  " << scene << " " << mebibytes(usage.currentTotal) << " MiB (peak "
+            << mebibytes(usage.peakTotal) << ")\n";
+    }
+
+    text.setString(oss.str());
+    const auto bounds = text.getLocalBounds();
+    panel.setSize(sf::Vector2f{bounds.size.x + 14.f, bounds.size.y + 16.f});
+}
+
+void PerfOverlay::draw(sf::RenderTarget& target) const {
+    target.draw(panel);
+    target.draw(text);
+}
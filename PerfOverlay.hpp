@@ -0,0 +1,44 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+#include "AllocationTracker.hpp"
+
+// Small text panel in the top-left corner (toggled with F3 in the stage).
+// The text is rebuilt a few times per second, not every frame.
+class PerfOverlay {
+public:
+    explicit PerfOverlay(const sf::Font& font);
+
+    void update(float delta);
+    // Key event to presented frame, over the last few inputs
+    void setInputLatency(float averageMs, float worstMs);
+    // What the main thread allocated for one frame
+    void setFrameAllocations(const AllocationCounts& frame);
+    void draw(sf::RenderTarget& target) const;
+
+private:
+    void rebuild();
+
+    sf::RectangleShape panel;
+    sf::Text text;
+    float refreshTimer = 0.f;
+    float frameTimeSum = 0.f;
+    float worstFrameTime = 0.f;
+    int frames = 0;
+    float averageFrameTime = 0.f;
+    float shownWorstFrameTime = 0.f;
+    float inputLatencyMs = -1.f;
+    float worstInputLatencyMs = 0.f;
+    // Summed over frames until the next rebuild
+    uint64_t allocationFrames = 0;
+    AllocationCounts frameAllocationSum;
+    uint64_t worstFrameAllocations = 0;
+    double shownAllocationsPerFrame = 0.0;
+    double shownBytesPerFrame = 0.0;
+    uint64_t shownWorstAllocations = 0;
+};
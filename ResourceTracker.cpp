@@ -0,0 +1,122 @@
+#include "ResourceTracker.hpp"
+
+#include <iomanip>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+void addTo(ResourceUsage& usage, size_t index, size_t bytes) {
+    usage.current[index] += bytes;
+    usage.peak[index] = max(usage.peak[index], usage.current[index]);
+    usage.currentTotal += bytes;
+    usage.peakTotal = max(usage.peakTotal, usage.currentTotal);
+}
+
+void removeFrom(ResourceUsage& usage, size_t index, size_t bytes) {
+    usage.current[index] -= min(bytes, usage.current[index]);
+    usage.currentTotal -= min(bytes, usage.currentTotal);
+}
+
+double mebibytes(size_t bytes) {
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+}
+
+const char* resourceCategoryName(ResourceCategory category) {
+    switch (category) {
+    case ResourceCategory::Texture: return "textures";
+    case ResourceCategory::SoundBuffer: return "sound buffers";
+    case ResourceCategory::MusicStream: return "music streams";
+    case ResourceCategory::Collision: return "collision data";
+    case ResourceCategory::Particles: return "particles";
+    case ResourceCategory::Tiles: return "tiles";
+    default: return "other";
+    }
+}
+
+ResourceTracker& ResourceTracker::instance() {
+    static ResourceTracker tracker;
+    return tracker;
+}
+
+void ResourceTracker::add(const string& scene, ResourceCategory category, size_t bytes) {
+    const size_t index = static_cast<size_t>(category);
+    lock_guard<mutex> guard(lock);
+    auto& sceneUsage = usage[scene];
+    addTo(sceneUsage, index, bytes);
+    addTo(total, index, bytes);
+    if (budget > 0 && total.currentTotal > budget && !budgetWarned[scene]) {
+        budgetWarned[scene] = true;
+        cerr << "Warning: asset memory budget exceeded while loading " << scene << ": " << fixed
+             << setprecision(2) << mebibytes(total.currentTotal) << " MiB of " << mebibytes(budget) << " MiB\n";
+    }
+}
+
+void ResourceTracker::remove(const string& scene, ResourceCategory category, size_t bytes) {
+    const size_t index = static_cast<size_t>(category);
+    lock_guard<mutex> guard(lock);
+    removeFrom(usage[scene], index, bytes);
+    removeFrom(total, index, bytes);
+}
+
+void ResourceTracker::setBudget(size_t bytes) {
+    lock_guard<mutex> guard(lock);
+    budget = bytes;
+    budgetWarned.clear();
+}
+
+map<string, ResourceUsage> ResourceTracker::scenes() const {
+    lock_guard<mutex> guard(lock);
+    return usage;
+}
+
+ResourceUsage ResourceTracker::totals() const {
+    lock_guard<mutex> guard(lock);
+    return total;
+}
+
+void ResourceTracker::report(ostream& out) const {
+    lock_guard<mutex> guard(lock);
+    out << fixed << setprecision(2);
+    out << "Asset memory (current / peak MiB):\n";
+    for (const auto& [scene, sceneUsage] : usage) {
+        out << "  " << scene << ": " << mebibytes(sceneUsage.currentTotal) << " / "
+            << mebibytes(sceneUsage.peakTotal) << '\n';
+        for (size_t i = 0; i < kResourceCategoryCount; ++i) {
+            if (sceneUsage.peak[i] == 0) continue;
+            out << "    " << resourceCategoryName(static_cast<ResourceCategory>(i)) << ": "
+                << mebibytes(sceneUsage.current[i]) << " / " << mebibytes(sceneUsage.peak[i]) << '\n';
+        }
+    }
+    out << "  total: " << mebibytes(total.currentTotal) << " / " << mebibytes(total.peakTotal) << '\n';
+}
+
+ResourceScope::ResourceScope(string scene)
+    : scene(move(scene)) {}
+
+ResourceScope::~ResourceScope() {
+    auto& tracker = ResourceTracker::instance();
+    for (size_t i = 0; i < kResourceCategoryCount; ++i) {
+        if (bytes[i] > 0) {
+            tracker.remove(scene, static_cast<ResourceCategory>(i), bytes[i]);
+        }
+    }
+}
+
+void ResourceScope::track(const sf::Texture& texture) {
+    const auto size = texture.getSize();
+    track(ResourceCategory::Texture, static_cast<size_t>(size.x) * size.y * 4);
+}
+
+void ResourceScope::track(const sf::SoundBuffer& buffer) {
+    track(ResourceCategory::SoundBuffer, static_cast<size_t>(buffer.getSampleCount()) * sizeof(int16_t));
+}
+
+void ResourceScope::track(ResourceCategory category, size_t amount) {
+    if (amount == 0) {
+        return;
+    }
+    bytes[static_cast<size_t>(category)] += amount;
+    ResourceTracker::instance().add(scene, category, amount);
+}
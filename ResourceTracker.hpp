@@ -0,0 +1,74 @@
+#pragma once
+
+#include <SFML/Audio.hpp>
+#include <SFML/Graphics.hpp>
+#include <array>
+#include <cstddef>
+#include <iosfwd>
+#include <map>
+#include <mutex>
+#include <string>
+
+using namespace std;
+
+enum class ResourceCategory {
+    Texture,      // VRAM, RGBA8
+    SoundBuffer,  // RAM, decoded 16-bit samples
+    MusicStream,  // RAM, the music engine's read-ahead buffers
+    Collision,    // RAM, hitbox tables and alpha masks
+    Particles,    // RAM, preallocated particle arrays and vertices
+    Tiles,        // RAM, the tile streamer's chunk meshes
+    Count
+};
+
+constexpr size_t kResourceCategoryCount = static_cast<size_t>(ResourceCategory::Count);
+
+const char* resourceCategoryName(ResourceCategory category);
+
+struct ResourceUsage {
+    array<size_t, kResourceCategoryCount> current{};
+    array<size_t, kResourceCategoryCount> peak{};
+    size_t currentTotal = 0;
+    size_t peakTotal = 0;
+};
+
+// Process-wide byte counts of loaded assets, by scene and category. Loads
+// register through a ResourceScope, which gives the bytes back when the
+// scene that owns the assets ends.
+class ResourceTracker {
+public:
+    static ResourceTracker& instance();
+
+    void add(const string& scene, ResourceCategory category, size_t bytes);
+    void remove(const string& scene, ResourceCategory category, size_t bytes);
+
+    // 0 disables the budget; otherwise going over it is reported once per scene
+    void setBudget(size_t bytes);
+
+    map<string, ResourceUsage> scenes() const;
+    ResourceUsage totals() const;
+    void report(ostream& out) const;
+
+private:
+    mutable mutex lock;
+    map<string, ResourceUsage> usage;
+    ResourceUsage total;
+    size_t budget = 0;
+    map<string, bool> budgetWarned;
+};
+
+class ResourceScope {
+public:
+    explicit ResourceScope(string scene);
+    ~ResourceScope();
+    ResourceScope(const ResourceScope&) = delete;
+    ResourceScope& operator=(const ResourceScope&) = delete;
+
+    void track(const sf::Texture& texture);
+    void track(const sf::SoundBuffer& buffer);
+    void track(ResourceCategory category, size_t bytes);
+
+private:
+    string scene;
+    array<size_t, kResourceCategoryCount> bytes{};
+};
@@ -0,0 +1,297 @@
+#include "RlEnvironment.hpp"
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "BulletSystem.hpp"
+#include "CharacterSprites.hpp"
+#include "InputBuffer.hpp"
+#include "SpectatorStream.hpp"
+#include "StageSimulation.hpp"
+
+using namespace std;
+
+static_assert(CHAVACANO_ACTION_RELOAD == static_cast<int>(InputAction::Reload),
+              "C actions must line up with InputAction");
+
+namespace {
+constexpr float kPositionScale = 1.f / (kArenaWidth * kSpectatorPositionScale);
+constexpr float kHeightScale = 1.f / (kGroundY * kSpectatorPositionScale);
+constexpr int kHeldActions = CHAVACANO_ACTION_RUN + 1;
+
+struct Environment {
+    optional<StageSimulation> simulation;
+    SpectatorState view;
+    int32_t playerHealth = 100;
+    int32_t enemyHealth = 100;
+    int32_t playerWins = 0;
+    int32_t enemyWins = 0;
+};
+
+// Runs one job on every worker and the calling thread, then waits for all of
+// them. Workers sleep between calls, so an idle handle costs nothing.
+class WorkerPool {
+public:
+    template <typename Job>
+    WorkerPool(int workers, Job&& job) : job(std::forward<Job>(job)) {
+        for (int slice = 1; slice < workers; ++slice) {
+            threads.emplace_back([this, slice] { work(slice); });
+        }
+    }
+    ~WorkerPool() {
+        {
+            lock_guard<mutex> lock(mutex_);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+
+    int slices() const { return static_cast<int>(threads.size()) + 1; }
+
+    void run() {
+        {
+            lock_guard<mutex> lock(mutex_);
+            ++generation;
+            busy = static_cast<int>(threads.size());
+        }
+        wake.notify_all();
+        job(0);
+        unique_lock<mutex> lock(mutex_);
+        finished.wait(lock, [this] { return busy == 0; });
+    }
+
+private:
+    void work(int slice) {
+        uint64_t seen = 0;
+        while (true) {
+            {
+                unique_lock<mutex> lock(mutex_);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) {
+                    return;
+                }
+                seen = generation;
+            }
+            job(slice);
+            {
+                lock_guard<mutex> lock(mutex_);
+                --busy;
+            }
+            finished.notify_one();
+        }
+    }
+
+    function<void(int)> job;
+    vector<thread> threads;
+    mutex mutex_;
+    condition_variable wake;
+    condition_variable finished;
+    uint64_t generation = 0;
+    int busy = 0;
+    bool stopping = false;
+};
+}
+
+struct ChavacanoEnvs {
+    size_t count = 0;
+    // Hit tables loaded once; every simulation shares them
+    CharacterSpriteManager gangster1;
+    CharacterSpriteManager gangster3;
+    BulletShape bulletShape;
+    unique_ptr<Environment[]> environments;
+    unique_ptr<WorkerPool> pool;
+
+    // Arguments of the call in progress, read by the workers
+    bool resetting = false;
+    const uint8_t* actions = nullptr;
+    float* observations = nullptr;
+    float* rewards = nullptr;
+    uint8_t* dones = nullptr;
+
+    void startMatch(size_t index);
+    void observe(size_t index);
+    void stepOne(size_t index);
+    void runSlice(int slice);
+};
+
+void ChavacanoEnvs::startMatch(size_t index) {
+    Environment& env = environments[index];
+    if (env.simulation) {
+        // The same fighters again, in the same memory
+        env.simulation->restartMatch();
+    } else {
+        // Alternate characters like the benchmark does
+        env.simulation.emplace(false);
+        env.simulation->loadShared(index % 2 == 0, gangster1, gangster3, bulletShape);
+    }
+    const InputEvent start{InputAction::Start, true, {}};
+    env.simulation->step(&start, 1);
+    env.simulation->writeSpectatorState(env.view);
+    env.playerHealth = env.view[SpectatorField::PlayerHealth];
+    env.enemyHealth = env.view[SpectatorField::EnemyHealth];
+    env.playerWins = env.view[SpectatorField::PlayerWins];
+    env.enemyWins = env.view[SpectatorField::EnemyWins];
+}
+
+void ChavacanoEnvs::observe(size_t index) {
+    const SpectatorState& view = environments[index].view;
+    auto put = [&](ChavacanoObservation feature, float value) {
+        observations[static_cast<size_t>(feature) * count + index] = value;
+    };
+    auto fighter = [&](SpectatorField first, ChavacanoObservation out) {
+        auto field = [&](int offset) {
+            return static_cast<float>(view[static_cast<SpectatorField>(static_cast<int>(first) + offset)]);
+        };
+        auto slot = [&](int offset) { return static_cast<ChavacanoObservation>(static_cast<int>(out) + offset); };
+        // Field order per fighter: X, Y, State, Frame, FacingLeft, Health,
+        // Ammo, Reloads, Wins. FacingLeft set means the art's own,
+        // right-facing pose.
+        put(slot(0), field(0) * kPositionScale);
+        put(slot(1), field(1) * kHeightScale);
+        put(slot(2), field(5) / 100.f);
+        put(slot(3), field(6) / kMaxAmmo);
+        put(slot(4), field(7) / 2.f);
+        put(slot(5), field(2) / static_cast<float>(SpriteState::Dead));
+        put(slot(6), field(4) != 0.f ? 1.f : -1.f);
+        put(slot(7), field(8) / 2.f);
+    };
+    fighter(SpectatorField::PlayerX, CHAVACANO_OBS_PLAYER_X);
+    fighter(SpectatorField::EnemyX, CHAVACANO_OBS_ENEMY_X);
+    put(CHAVACANO_OBS_TIME_LEFT, static_cast<float>(view[SpectatorField::TimeLeft]) / kStageDurationSeconds);
+
+    const int32_t playerX = view[SpectatorField::PlayerX];
+    const SpectatorBullet* nearest = nullptr;
+    for (size_t i = 0; i < view.bulletCount; ++i) {
+        const SpectatorBullet& bullet = view.bullets[i];
+        if (!bullet.fromPlayer && (!nearest || abs(bullet.x - playerX) < abs(nearest->x - playerX))) {
+            nearest = &bullet;
+        }
+    }
+    put(CHAVACANO_OBS_BULLET_INCOMING, nearest ? 1.f : 0.f);
+    put(CHAVACANO_OBS_BULLET_DX, nearest ? static_cast<float>(nearest->x - playerX) * kPositionScale : 0.f);
+    put(CHAVACANO_OBS_BULLET_DY,
+        nearest ? static_cast<float>(nearest->y - view[SpectatorField::PlayerY]) * kHeightScale : 0.f);
+}
+
+void ChavacanoEnvs::stepOne(size_t index) {
+    Environment& env = environments[index];
+    // Held buttons are restated every tick, so a round end that stops the
+    // player cannot leave them out of sync with the agent
+    array<InputEvent, CHAVACANO_ACTION_COUNT> events;
+    size_t eventCount = 0;
+    for (int action = 0; action < CHAVACANO_ACTION_COUNT; ++action) {
+        const bool pressed = actions[static_cast<size_t>(action) * count + index] != 0;
+        if (action < kHeldActions || pressed) {
+            events[eventCount++] = InputEvent{static_cast<InputAction>(action), pressed, {}};
+        }
+    }
+    env.simulation->step(events.data(), eventCount);
+    env.simulation->writeSpectatorState(env.view);
+
+    const int32_t playerHealth = env.view[SpectatorField::PlayerHealth];
+    const int32_t enemyHealth = env.view[SpectatorField::EnemyHealth];
+    const int32_t playerWins = env.view[SpectatorField::PlayerWins];
+    const int32_t enemyWins = env.view[SpectatorField::EnemyWins];
+    // Health refills between rounds; only drops count as damage
+    const int32_t dealt = max(0, env.enemyHealth - enemyHealth);
+    const int32_t taken = max(0, env.playerHealth - playerHealth);
+    rewards[index] = static_cast<float>(dealt - taken) / 100.f +
+                     static_cast<float>((playerWins - env.playerWins) - (enemyWins - env.enemyWins));
+    env.playerHealth = playerHealth;
+    env.enemyHealth = enemyHealth;
+    env.playerWins = playerWins;
+    env.enemyWins = enemyWins;
+
+    const bool done = env.simulation->matchOver();
+    dones[index] = done ? 1 : 0;
+    if (done) {
+        startMatch(index);
+    }
+}
+
+void ChavacanoEnvs::runSlice(int slice) {
+    const size_t slices = static_cast<size_t>(pool->slices());
+    const size_t begin = count * static_cast<size_t>(slice) / slices;
+    const size_t end = count * static_cast<size_t>(slice + 1) / slices;
+    for (size_t i = begin; i < end; ++i) {
+        if (resetting) {
+            startMatch(i);
+        } else {
+            stepOne(i);
+        }
+        if (observations) {
+            observe(i);
+        }
+    }
+}
+
+extern "C" {
+
+ChavacanoEnvs* chavacano_envs_create(int count, int threads) {
+    if (count <= 0) {
+        cerr << "Warning: chavacano_envs_create needs at least one environment\n";
+        return nullptr;
+    }
+    auto envs = make_unique<ChavacanoEnvs>();
+    envs->count = static_cast<size_t>(count);
+    if (!envs->gangster1.loadAll(true, false) || !envs->gangster3.loadAll(false, false) ||
+        !loadBulletShape(envs->bulletShape)) {
+        cerr << "Warning: could not load the stage sheets; run from the game directory\n";
+        return nullptr;
+    }
+    envs->environments = make_unique<Environment[]>(envs->count);
+    if (threads <= 0) {
+        threads = static_cast<int>(max(1u, thread::hardware_concurrency()));
+    }
+    ChavacanoEnvs* raw = envs.get();
+    envs->pool = make_unique<WorkerPool>(min(threads, count), [raw](int slice) { raw->runSlice(slice); });
+    // Start every match now, so stepping before the first reset is fine
+    envs->resetting = true;
+    envs->pool->run();
+    return envs.release();
+}
+
+void chavacano_envs_destroy(ChavacanoEnvs* envs) {
+    delete envs;
+}
+
+int chavacano_envs_count(const ChavacanoEnvs* envs) {
+    return static_cast<int>(envs->count);
+}
+
+int chavacano_envs_action_count(void) {
+    return CHAVACANO_ACTION_COUNT;
+}
+
+int chavacano_envs_observation_count(void) {
+    return CHAVACANO_OBS_COUNT;
+}
+
+void chavacano_envs_reset(ChavacanoEnvs* envs, float* observations) {
+    envs->resetting = true;
+    envs->observations = observations;
+    envs->pool->run();
+}
+
+void chavacano_envs_step(ChavacanoEnvs* envs, const uint8_t* actions, float* observations, float* rewards,
+                         uint8_t* dones) {
+    envs->resetting = false;
+    envs->actions = actions;
+    envs->observations = observations;
+    envs->rewards = rewards;
+    envs->dones = dones;
+    envs->pool->run();
+}
+}
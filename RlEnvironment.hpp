@@ -0,0 +1,84 @@
+#pragma once
+
+// C interface for training agents against the stage rules, built as a shared
+// library. One handle holds `count` independent matches, each an agent-driven
+// player against the built-in enemy AI, and every call steps all of them on
+// a pool of worker threads.
+//
+// Buffers are structure-of-arrays: value `k` of environment `i` lives at
+// [k * count + i], so a batch is one contiguous block per feature. Memory is
+// allocated only by create; a step never allocates, and a finished match
+// restarts in place (StageSimulation::restartMatch) inside the same call.
+//
+// Run from the game directory: the sprite sheets are read once at create.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// One byte per environment each, nonzero meaning pressed. Left, right and run
+// act while held; the others fire on every step they are set.
+enum ChavacanoAction {
+    CHAVACANO_ACTION_LEFT,
+    CHAVACANO_ACTION_RIGHT,
+    CHAVACANO_ACTION_RUN,
+    CHAVACANO_ACTION_JUMP,
+    CHAVACANO_ACTION_SHOOT,
+    CHAVACANO_ACTION_MELEE,
+    CHAVACANO_ACTION_RELOAD,
+    CHAVACANO_ACTION_COUNT
+};
+
+// Observations, all scaled to roughly [-1, 1]
+enum ChavacanoObservation {
+    CHAVACANO_OBS_PLAYER_X,
+    CHAVACANO_OBS_PLAYER_Y,
+    CHAVACANO_OBS_PLAYER_HEALTH,
+    CHAVACANO_OBS_PLAYER_AMMO,
+    CHAVACANO_OBS_PLAYER_RELOADS,
+    CHAVACANO_OBS_PLAYER_STATE,
+    CHAVACANO_OBS_PLAYER_FACING,   // +1 facing +x, -1 facing -x
+    CHAVACANO_OBS_PLAYER_WINS,
+    CHAVACANO_OBS_ENEMY_X,
+    CHAVACANO_OBS_ENEMY_Y,
+    CHAVACANO_OBS_ENEMY_HEALTH,
+    CHAVACANO_OBS_ENEMY_AMMO,
+    CHAVACANO_OBS_ENEMY_RELOADS,
+    CHAVACANO_OBS_ENEMY_STATE,
+    CHAVACANO_OBS_ENEMY_FACING,
+    CHAVACANO_OBS_ENEMY_WINS,
+    CHAVACANO_OBS_TIME_LEFT,
+    CHAVACANO_OBS_BULLET_INCOMING, // 1 when an enemy bullet is in flight
+    CHAVACANO_OBS_BULLET_DX,       // nearest enemy bullet relative to the player
+    CHAVACANO_OBS_BULLET_DY,
+    CHAVACANO_OBS_COUNT
+};
+
+typedef struct ChavacanoEnvs ChavacanoEnvs;
+
+// `threads` 0 means one per core. Returns NULL if the sheets cannot be read.
+ChavacanoEnvs* chavacano_envs_create(int count, int threads);
+void chavacano_envs_destroy(ChavacanoEnvs* envs);
+
+int chavacano_envs_count(const ChavacanoEnvs* envs);
+int chavacano_envs_action_count(void);
+int chavacano_envs_observation_count(void);
+
+// Starts a new match everywhere. `observations` holds
+// CHAVACANO_OBS_COUNT * count floats.
+void chavacano_envs_reset(ChavacanoEnvs* envs, float* observations);
+
+// Advances every environment one 120 Hz tick. `actions` holds
+// CHAVACANO_ACTION_COUNT * count bytes; `rewards` and `dones` hold count
+// each. The reward is damage dealt minus damage taken over 100, plus one per
+// round won and minus one per round lost. A done environment has already
+// restarted, and its observation is the first of the new match.
+void chavacano_envs_step(ChavacanoEnvs* envs, const uint8_t* actions, float* observations, float* rewards,
+                         uint8_t* dones);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,99 @@
+// Env-steps per second of the training library, driven through its C
+// interface the way a Python trainer would drive it.
+//
+// Run from the game directory, linked against libchavacano_env.so. Each line
+// is one batch size: `count` environments stepped together on `threads`
+// workers (0, the default, is one per core) with random actions.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "RlEnvironment.hpp"
+
+using namespace std;
+
+namespace {
+// Distinct action batches cycled through, so drawing actions is not timed
+constexpr int kActionBatches = 16;
+
+struct Throughput {
+    uint64_t steps = 0;
+    uint64_t dones = 0;
+    double seconds = 0.0;
+};
+
+Throughput measure(ChavacanoEnvs* envs, double seconds) {
+    const size_t count = static_cast<size_t>(chavacano_envs_count(envs));
+    const size_t actionBytes = count * static_cast<size_t>(chavacano_envs_action_count());
+    vector<uint8_t> actions(actionBytes * kActionBatches);
+    uint32_t random = 12345;
+    for (auto& action : actions) {
+        random = random * 1664525u + 1013904223u;
+        // Every button pressed on about one step in six
+        action = (random >> 24) < 40 ? 1 : 0;
+    }
+    vector<float> observations(count * static_cast<size_t>(chavacano_envs_observation_count()));
+    vector<float> rewards(count);
+    vector<uint8_t> dones(count);
+    chavacano_envs_reset(envs, observations.data());
+
+    Throughput result;
+    const auto start = chrono::steady_clock::now();
+    const auto stop = start + chrono::duration<double>(seconds);
+    auto now = start;
+    // Checks the clock every few steps; a step of a big batch is long anyway
+    while (now < stop) {
+        for (int i = 0; i < kActionBatches; ++i) {
+            chavacano_envs_step(envs, actions.data() + actionBytes * static_cast<size_t>(i), observations.data(),
+                                rewards.data(), dones.data());
+            for (uint8_t done : dones) {
+                result.dones += done;
+            }
+        }
+        result.steps += kActionBatches * count;
+        now = chrono::steady_clock::now();
+    }
+    result.seconds = chrono::duration<double>(now - start).count();
+    return result;
+}
+}
+
+int main(int argc, char** argv) {
+    vector<int> counts;
+    int threads = 0;
+    double seconds = 3.0;
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        if (arg == "--envs" && i + 1 < argc) {
+            counts.push_back(atoi(argv[++i]));
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (arg == "--seconds" && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else {
+            cerr << "Usage: " << argv[0] << " [--envs <count>]... [--threads <count>] [--seconds <time>]\n";
+            return 2;
+        }
+    }
+    if (counts.empty()) {
+        counts = {1, 64, 1024, 4096};
+    }
+
+    for (int count : counts) {
+        ChavacanoEnvs* envs = chavacano_envs_create(count, threads);
+        if (!envs) {
+            cerr << "Unable to create " << count << " environments; run from the game directory\n";
+            return 1;
+        }
+        const Throughput result = measure(envs, seconds);
+        chavacano_envs_destroy(envs);
+        const double perSecond = static_cast<double>(result.steps) / result.seconds;
+        cout << count << " envs: " << static_cast<uint64_t>(perSecond) << " env-steps/s, "
+             << result.dones << " matches finished\n";
+    }
+    return 0;
+}
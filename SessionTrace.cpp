@@ -0,0 +1,197 @@
+#include "SessionTrace.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+// Chrome's viewer groups everything under one process id
+constexpr int kProcessId = 1;
+
+void writeEscaped(ostream& out, const char* text) {
+    for (const char* at = text; *at != '\0'; ++at) {
+        const unsigned char c = static_cast<unsigned char>(*at);
+        if (c == '"' || c == '\\') {
+            out << '\\' << *at;
+        } else if (c < 0x20) {
+            out << ' ';
+        } else {
+            out << *at;
+        }
+    }
+}
+
+// Copies `detail`, keeping its end: the file name says more than the directory
+void copyDetail(char* destination, const char* detail) {
+    if (detail == nullptr) {
+        destination[0] = '\0';
+        return;
+    }
+    const size_t length = strlen(detail);
+    const size_t skip = length > SessionTrace::kDetailLength ? length - SessionTrace::kDetailLength : 0;
+    memcpy(destination, detail + skip, length - skip + 1);
+}
+}
+
+SessionTrace& SessionTrace::instance() {
+    static SessionTrace trace;
+    return trace;
+}
+
+bool SessionTrace::start(const string& path) {
+    // Fail now rather than after a whole session
+    if (!ofstream(path)) {
+        cerr << "Warning: could not open trace file " << path << '\n';
+        return false;
+    }
+    outputPath = path;
+    origin = chrono::steady_clock::now();
+    recording.store(true, memory_order_release);
+    return true;
+}
+
+int64_t SessionTrace::nowUs() const {
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - origin).count();
+}
+
+SessionTrace::ThreadBuffer& SessionTrace::bufferForThisThread() {
+    // Owned by `threads`, so a thread's spans outlive the thread
+    thread_local ThreadBuffer* current = nullptr;
+    if (current == nullptr) {
+        auto buffer = make_unique<ThreadBuffer>();
+        lock_guard<mutex> guard(lock);
+        buffer->id = static_cast<int>(threads.size()) + 1;
+        current = buffer.get();
+        threads.push_back(move(buffer));
+    }
+    return *current;
+}
+
+void SessionTrace::nameThread(const char* name) {
+    if (!active()) {
+        return;
+    }
+    ThreadBuffer& buffer = bufferForThisThread();
+    lock_guard<mutex> guard(lock);
+    buffer.name = name;
+}
+
+void SessionTrace::record(const char* name, const char* category, const char* detail, int64_t startUs,
+                          int64_t endUs, TraceKeep keep) {
+    if (!active()) {
+        return;
+    }
+    ThreadBuffer& buffer = bufferForThisThread();
+    atomic<size_t>& published = keep == TraceKeep::Recent ? buffer.recentCount : buffer.count;
+    const size_t index = published.load(memory_order_relaxed);
+    Span* span = nullptr;
+    if (keep == TraceKeep::Recent) {
+        if (!buffer.recent) {
+            buffer.recent.reset(new Span[kRecentSpans]);
+        }
+        // Overwrites the oldest once the ring is full
+        span = &buffer.recent[index % kRecentSpans];
+    } else {
+        const size_t block = index / kBlockSpans;
+        if (block >= kMaxBlocks) {
+            buffer.dropped.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+        if (!buffer.blocks[block]) {
+            // Left uninitialized: every span is written before it is published
+            buffer.blocks[block].reset(new Span[kBlockSpans]);
+        }
+        span = &buffer.blocks[block][index % kBlockSpans];
+    }
+    span->name = name;
+    span->category = category;
+    span->startUs = startUs;
+    span->durationUs = endUs - startUs;
+    copyDetail(span->detail, detail);
+    // Publishes the span (and a new block or ring) to finish()
+    published.store(index + 1, memory_order_release);
+}
+
+void SessionTrace::finish() {
+    if (!recording.exchange(false, memory_order_acq_rel)) {
+        return;
+    }
+    ofstream out(outputPath);
+    if (!out) {
+        cerr << "Warning: could not write trace file " << outputPath << '\n';
+        return;
+    }
+    lock_guard<mutex> guard(lock);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    out << "{\"ph\": \"M\", \"pid\": " << kProcessId
+        << ", \"name\": \"process_name\", \"args\": {\"name\": \"El Chavacano\"}}";
+    size_t spans = 0;
+    size_t dropped = 0;
+    size_t overwritten = 0;
+    auto writeSpan = [&](const ThreadBuffer& thread, const Span& span) {
+        out << ",\n{\"ph\": \"X\", \"pid\": " << kProcessId << ", \"tid\": " << thread.id << ", \"name\": \"";
+        writeEscaped(out, span.name);
+        out << "\", \"cat\": \"";
+        writeEscaped(out, span.category);
+        out << "\", \"ts\": " << span.startUs << ", \"dur\": " << span.durationUs;
+        if (span.detail[0] != '\0') {
+            out << ", \"args\": {\"detail\": \"";
+            writeEscaped(out, span.detail);
+            out << "\"}";
+        }
+        out << '}';
+    };
+    for (const auto& thread : threads) {
+        out << ",\n{\"ph\": \"M\", \"pid\": " << kProcessId << ", \"tid\": " << thread->id
+            << ", \"name\": \"thread_name\", \"args\": {\"name\": \"";
+        writeEscaped(out, thread->name != nullptr ? thread->name : "thread");
+        out << "\"}}";
+        // Threads that are still running may add more; only published spans are read
+        const size_t count = thread->count.load(memory_order_acquire);
+        for (size_t i = 0; i < count; ++i) {
+            writeSpan(*thread, thread->blocks[i / kBlockSpans][i % kBlockSpans]);
+        }
+        spans += count;
+        dropped += thread->dropped.load(memory_order_relaxed);
+        // Once the ring has wrapped, its oldest slot is where a span that
+        // began before recording stopped may still be writing, so it is
+        // left out with the ones already overwritten
+        const size_t recentCount = thread->recentCount.load(memory_order_acquire);
+        const size_t firstRecent = recentCount > kRecentSpans ? recentCount - kRecentSpans + 1 : 0;
+        for (size_t i = firstRecent; i < recentCount; ++i) {
+            writeSpan(*thread, thread->recent[i % kRecentSpans]);
+        }
+        spans += recentCount - firstRecent;
+        overwritten += firstRecent;
+    }
+    out << "\n]}\n";
+    cout << "Wrote " << spans << " trace spans from " << threads.size() << " threads to " << outputPath << '\n';
+    if (overwritten > 0) {
+        cout << "Kept the newest per-frame and per-tick spans; " << overwritten << " older ones were overwritten\n";
+    }
+    if (dropped > 0) {
+        cerr << "Warning: " << dropped << " trace spans did not fit and were dropped\n";
+    }
+}
+
+TraceSpan::TraceSpan(const char* name, const char* category, const char* detail) : name(name), category(category) {
+    SessionTrace& trace = SessionTrace::instance();
+    if (trace.active()) {
+        copyDetail(this->detail, detail);
+        startUs = trace.nowUs();
+    }
+}
+
+TraceSpan::TraceSpan(const char* name, const char* category, TraceKeep keep)
+    : TraceSpan(name, category, static_cast<const char*>(nullptr)) {
+    this->keep = keep;
+}
+
+TraceSpan::~TraceSpan() {
+    if (startUs >= 0) {
+        SessionTrace& trace = SessionTrace::instance();
+        trace.record(name, category, detail, startUs, trace.nowUs(), keep);
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// How long a span is kept. Session spans (scenes, loads, stalls) are kept for
+// the whole session. Recent spans are for things that happen every frame or
+// tick: each thread keeps the newest kRecentSpans of them in a ring, so they
+// can never use up the room the session spans need.
+enum class TraceKeep {
+    Session,
+    Recent
+};
+
+// Session-wide timeline in Chrome's trace_event format, for chrome://tracing
+// or ui.perfetto.dev. Each thread appends to its own buffer, so a span costs
+// two clock reads and a copy, with no lock; before start() it only checks a
+// flag. The file is written by finish().
+class SessionTrace {
+public:
+    static constexpr size_t kDetailLength = 47;
+    // Session spans per thread, allocated a block at a time; later ones are dropped
+    static constexpr size_t kBlockSpans = 1024;
+    static constexpr size_t kMaxBlocks = 64;
+    // Recent spans per thread: about four minutes of frames at 60 Hz
+    static constexpr size_t kRecentSpans = 16384;
+
+    static SessionTrace& instance();
+
+    bool start(const string& path);
+    // Writes the file and stops recording. Spans still open are left out.
+    void finish();
+    bool active() const { return recording.load(memory_order_acquire); }
+
+    // Labels the calling thread on the timeline; `name` must be a literal
+    void nameThread(const char* name);
+    // `name` and `category` must be literals; `detail` is copied
+    void record(const char* name, const char* category, const char* detail, int64_t startUs, int64_t endUs,
+                TraceKeep keep = TraceKeep::Session);
+    int64_t nowUs() const;
+
+private:
+    struct Span {
+        const char* name;
+        const char* category;
+        int64_t startUs;
+        int64_t durationUs;
+        char detail[kDetailLength + 1];
+    };
+    // Only its own thread appends; finish() reads the first `count` spans
+    // and the newest of the `recentCount` recent ones
+    struct ThreadBuffer {
+        int id = 0;
+        const char* name = nullptr;
+        array<unique_ptr<Span[]>, kMaxBlocks> blocks;
+        atomic<size_t> count{0};
+        atomic<size_t> dropped{0};
+        unique_ptr<Span[]> recent;  // kRecentSpans, allocated with the first one
+        atomic<size_t> recentCount{0};
+    };
+
+    ThreadBuffer& bufferForThisThread();
+
+    atomic<bool> recording{false};
+    chrono::steady_clock::time_point origin;
+    string outputPath;
+    mutex lock;  // guards `threads` and thread names, never taken per span
+    vector<unique_ptr<ThreadBuffer>> threads;
+};
+
+// Records the time from construction to destruction as one span. `detail`
+// (an asset path, say) shows in the span's args, cut to kDetailLength.
+class TraceSpan {
+public:
+    TraceSpan(const char* name, const char* category, const char* detail = nullptr);
+    TraceSpan(const char* name, const char* category, const string& detail)
+        : TraceSpan(name, category, detail.c_str()) {}
+    // For spans recorded every frame or tick (see TraceKeep)
+    TraceSpan(const char* name, const char* category, TraceKeep keep);
+    ~TraceSpan();
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name;
+    const char* category;
+    TraceKeep keep = TraceKeep::Session;
+    int64_t startUs = -1;
+    char detail[SessionTrace::kDetailLength + 1];
+};
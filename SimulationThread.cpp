@@ -0,0 +1,61 @@
+#include "SimulationThread.hpp"
+
+#include <chrono>
+
+#include "SessionTrace.hpp"
+
+using namespace std;
+
+SimulationThread::SimulationThread(StageSimulation& simulation, InputBuffer& input,
+                                   TripleBuffer<StageSnapshot>& snapshots, SpectatorServer* spectators)
+    : simulation(simulation), input(input), snapshots(snapshots), spectators(spectators) {
+    worker = thread([this] { run(); });
+}
+
+SimulationThread::~SimulationThread() {
+    stop();
+}
+
+void SimulationThread::stop() {
+    stopping.store(true, memory_order_release);
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+AllocationCounts SimulationThread::allocations() const {
+    return {allocationCount.load(memory_order_relaxed), allocationBytes.load(memory_order_relaxed)};
+}
+
+void SimulationThread::run() {
+    SessionTrace::instance().nameThread("simulation");
+    // Gameplay allocations count toward the stage, like the main thread's
+    AllocationScene allocationScene("Stage");
+    const auto step = chrono::duration_cast<InputClock::duration>(chrono::duration<float>(kSimulationStepSeconds));
+    auto nextTick = InputClock::now();
+    while (!stopping.load(memory_order_acquire)) {
+        {
+            TraceSpan span("tick", "simulation", TraceKeep::Recent);
+            simulation.step(input);
+            simulation.writeSnapshot(snapshots.writeBuffer(), snapshots.writeBufferSkipped());
+            snapshots.publish();
+            if (spectators) {
+                simulation.writeSpectatorState(spectatorState);
+                spectators->publish(spectatorState);
+            }
+        }
+        const AllocationCounts allocated = AllocationTracker::thisThread();
+        allocationCount.store(allocated.allocations, memory_order_relaxed);
+        allocationBytes.store(allocated.bytes, memory_order_relaxed);
+        if (simulation.matchOver()) {
+            return;
+        }
+        nextTick += step;
+        const auto now = InputClock::now();
+        if (nextTick < now - step * 8) {
+            // Fell far behind (debugger, suspend); resync instead of fast-forwarding
+            nextTick = now;
+        }
+        this_thread::sleep_until(nextTick);
+    }
+}
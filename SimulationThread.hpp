@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+using namespace std;
+
+#include "AllocationTracker.hpp"
+#include "InputBuffer.hpp"
+#include "SpectatorStream.hpp"
+#include "StageSimulation.hpp"
+#include "TripleBuffer.hpp"
+
+// Steps a simulation at kSimulationStep on its own thread and publishes a
+// snapshot after every tick, and a spectator state too when there is a
+// server. Stops when the match is over or on stop().
+class SimulationThread {
+public:
+    SimulationThread(StageSimulation& simulation, InputBuffer& input, TripleBuffer<StageSnapshot>& snapshots,
+                     SpectatorServer* spectators = nullptr);
+    ~SimulationThread();
+
+    void stop();
+    // Everything the simulation thread has allocated, as of its last tick
+    AllocationCounts allocations() const;
+
+private:
+    void run();
+
+    StageSimulation& simulation;
+    InputBuffer& input;
+    TripleBuffer<StageSnapshot>& snapshots;
+    SpectatorServer* spectators;
+    SpectatorState spectatorState;
+    atomic<bool> stopping{false};
+    // The worker's AllocationTracker::thisThread(), published after each tick
+    atomic<uint64_t> allocationCount{0};
+    atomic<uint64_t> allocationBytes{0};
+    thread worker;
+};
@@ -0,0 +1,279 @@
+#include "SpectatorMode.hpp"
+
+#include <SFML/Network.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "AllocationTracker.hpp"
+#include "BulletSystem.hpp"
+#include "CharacterSprites.hpp"
+#include "HudText.hpp"
+#include "InputBuffer.hpp"
+#include "ResourceTracker.hpp"
+#include "SpectatorStream.hpp"
+#include "SpriteBatch.hpp"
+#include "StageSimulation.hpp"
+
+using namespace std;
+
+namespace {
+constexpr size_t kReceiveChunk = 4096;
+
+// Reads whatever the socket has without blocking; false once the server is gone
+bool receiveInto(sf::TcpSocket& socket, SpectatorDecoder& decoder) {
+    uint8_t buffer[kReceiveChunk];
+    while (true) {
+        size_t received = 0;
+        const auto status = socket.receive(buffer, sizeof(buffer), received);
+        if (received > 0) {
+            decoder.feed(buffer, received);
+        }
+        if (status == sf::Socket::Status::Done || status == sf::Socket::Status::Partial) {
+            continue;
+        }
+        return status == sf::Socket::Status::NotReady;
+    }
+}
+
+void applyAll(SpectatorDecoder& decoder) {
+    while (decoder.next()) {
+    }
+}
+
+// Puts a locally loaded fighter in the pose the stream describes
+void poseFighter(CharacterSpriteManager& sprites, const SpectatorState& state, SpectatorField first) {
+    auto field = [&](int offset) {
+        return state[static_cast<SpectatorField>(static_cast<int>(first) + offset)];
+    };
+    // Same field order for both fighters: X, Y, State, Frame, FacingLeft
+    const int spriteState = clamp(field(2), 0, static_cast<int>(SpriteState::Dead));
+    sprites.currentState = static_cast<SpriteState>(spriteState);
+    sprites.setFacingDirection(field(4) != 0);
+    sprites.getCurrentAnimation().applyFrame(max(0, field(3)));
+    sprites.setPosition(sf::Vector2f{static_cast<float>(field(0)) / kSpectatorPositionScale,
+                                     static_cast<float>(field(1)) / kSpectatorPositionScale});
+}
+}
+
+int runSpectator(sf::RenderWindow& window, GameContext& context, const string& host, unsigned short port) {
+    const auto address = sf::IpAddress::resolve(host);
+    sf::TcpSocket socket;
+    if (!address || socket.connect(*address, port, sf::seconds(3.f)) != sf::Socket::Status::Done) {
+        cerr << "Unable to connect to a spectator stream at " << host << ':' << port << '\n';
+        return 1;
+    }
+    socket.setBlocking(false);
+
+    ResourceScope resources("Spectator");
+    AllocationScene allocations("Spectator");
+    CharacterSpriteManager gangster1;
+    CharacterSpriteManager gangster3;
+    if (!gangster1.loadAll(true) || !gangster3.loadAll(false)) {
+        return 1;
+    }
+    for (auto* sprites : {&gangster1, &gangster3}) {
+        for (const AnimatedSprite* animation : sprites->animations()) {
+            resources.track(animation->texture);
+            if (const sf::Texture* palette = animation->paletteTexture()) {
+                resources.track(*palette);
+            }
+        }
+        sprites->setScale(sf::Vector2f{1.8f, 1.8f});
+    }
+    sf::Texture bulletTexture;
+    sf::Vector2f bulletOrigin;
+    if (loadBulletTexture(bulletTexture, bulletOrigin)) {
+        resources.track(bulletTexture);
+    }
+    sf::Sprite bulletSprite(bulletTexture);
+    bulletSprite.setOrigin(bulletOrigin);
+    bulletSprite.setScale(sf::Vector2f{kBulletScale, kBulletScale});
+
+    const sf::Vector2f barSize{220.f, 24.f};
+    const sf::Vector2f leftBarPos{10.f, 30.f};
+    const sf::Vector2f rightBarPos{static_cast<float>(kArenaWidth) - barSize.x - 50.f, 30.f};
+    SpriteBatch batch;
+    sf::Text ammoText(context.font, "", 22);
+    sf::Text timerText(context.font, "", 30);
+    sf::Text banner(context.font, "SPECTATING - waiting for the stream", 20);
+    banner.setFillColor(sf::Color(200, 200, 200));
+    banner.setPosition(sf::Vector2f{10.f, 500.f});
+
+    SpectatorDecoder decoder;
+    while (window.isOpen()) {
+        while (auto eventOpt = window.pollEvent()) {
+            const auto& event = *eventOpt;
+            if (event.is<sf::Event::Closed>()) {
+                window.close();
+                return 0;
+            }
+            if (const auto keyEvent = event.getIf<sf::Event::KeyPressed>()) {
+                if (keyEvent->code == sf::Keyboard::Key::Escape) {
+                    return 0;
+                }
+            }
+        }
+
+        const bool connected = receiveInto(socket, decoder);
+        applyAll(decoder);
+        if (decoder.broken()) {
+            cerr << "Spectator stream is corrupt\n";
+            return 1;
+        }
+        if (!connected) {
+            cerr << "Spectator stream ended\n";
+            return 0;
+        }
+
+        if (context.hasBackground && context.backgroundSprite) {
+            window.clear();
+            window.draw(*context.backgroundSprite);
+        } else {
+            window.clear(sf::Color(10, 10, 25));
+        }
+        if (decoder.hasState()) {
+            const SpectatorState& state = decoder.state();
+            const bool playerIsGangster1 = (state[SpectatorField::Flags] & kSpectatorPlayerIsGangster1) != 0;
+            CharacterSpriteManager& player = playerIsGangster1 ? gangster1 : gangster3;
+            CharacterSpriteManager& enemy = playerIsGangster1 ? gangster3 : gangster1;
+            poseFighter(player, state, SpectatorField::PlayerX);
+            poseFighter(enemy, state, SpectatorField::EnemyX);
+
+            for (const auto& [position, health, ammo, reloads] :
+                 {tuple{leftBarPos, state[SpectatorField::PlayerHealth], state[SpectatorField::PlayerAmmo],
+                        state[SpectatorField::PlayerReloads]},
+                  tuple{rightBarPos, state[SpectatorField::EnemyHealth], state[SpectatorField::EnemyAmmo],
+                        state[SpectatorField::EnemyReloads]}}) {
+                // Bars are batched with the fight below; the text beside them never overlaps
+                const float fill = barSize.x * static_cast<float>(clamp(health, 0, 100)) / 100.f;
+                batch.addRect(1, sf::FloatRect(position, barSize), sf::Color(40, 40, 40));
+                batch.addRect(1, sf::FloatRect(position, sf::Vector2f{fill, barSize.y}), sf::Color(200, 40, 40));
+                ammoText.setString(formatAmmo(ammo, reloads).c_str());
+                ammoText.setPosition(position + sf::Vector2f{0.f, barSize.y + 8.f});
+                window.draw(ammoText);
+            }
+            timerText.setString(formatTimer(state[SpectatorField::TimeLeft]).c_str());
+            timerText.setPosition(sf::Vector2f{static_cast<float>(kArenaWidth) / 2.f - 30.f, leftBarPos.y});
+            window.draw(timerText);
+
+            for (size_t i = 0; i < state.bulletCount; ++i) {
+                const SpectatorBullet& bullet = state.bullets[i];
+                bulletSprite.setPosition(sf::Vector2f{static_cast<float>(bullet.x) / kSpectatorPositionScale,
+                                                      static_cast<float>(bullet.y) / kSpectatorPositionScale});
+                batch.add(2, bulletSprite);
+            }
+            int layer = 3;
+            for (auto* sprites : {&player, &enemy}) {
+                if (const sf::Sprite* sprite = sprites->getCurrentSprite()) {
+                    batch.add(layer++, sprite->getTexture(), sprite->getTextureRect(),
+                              sprites->facingTransform() * sprite->getTransform(), sf::Color::White,
+                              sprites->getCurrentAnimation().paletteTexture());
+                }
+            }
+            batch.flush(window);
+            banner.setString("SPECTATING  " + to_string(state[SpectatorField::PlayerWins]) + " - " +
+                             to_string(state[SpectatorField::EnemyWins]));
+        }
+        window.draw(banner);
+        window.display();
+    }
+    return 0;
+}
+
+int runSpectatorLoopback(int spectatorCount, float seconds) {
+    // Port 0: let the OS pick, so runs never collide with a real server
+    SpectatorServer server(sf::Socket::AnyPort);
+    if (!server.listening()) {
+        return 1;
+    }
+
+    struct Client {
+        unique_ptr<sf::TcpSocket> socket;
+        SpectatorDecoder decoder;
+    };
+    vector<Client> clients(static_cast<size_t>(spectatorCount));
+    for (auto& client : clients) {
+        client.socket = make_unique<sf::TcpSocket>();
+        if (client.socket->connect(sf::IpAddress::LocalHost, server.port(), sf::seconds(3.f)) !=
+            sf::Socket::Status::Done) {
+            cerr << "Loopback spectator could not connect\n";
+            return 1;
+        }
+        client.socket->setBlocking(false);
+    }
+    // Everyone is accepted before the first tick, so nobody needs a keyframe
+    // but the first message
+    const auto acceptDeadline = chrono::steady_clock::now() + chrono::seconds(3);
+    while (server.stats().spectators < clients.size() && chrono::steady_clock::now() < acceptDeadline) {
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+
+    auto pollClients = [&] {
+        for (auto& client : clients) {
+            if (client.socket) {
+                if (!receiveInto(*client.socket, client.decoder)) {
+                    client.socket.reset();
+                }
+                applyAll(client.decoder);
+            }
+        }
+    };
+
+    SpectatorState published;
+    const auto step = chrono::duration_cast<chrono::steady_clock::duration>(
+        chrono::duration<float>(kSimulationStepSeconds));
+    const int totalTicks = static_cast<int>(seconds * kSimulationRate);
+    int ticksRun = 0;
+    int matches = 0;
+    auto nextTick = chrono::steady_clock::now();
+    while (ticksRun < totalTicks) {
+        ResourceScope resources("Spectator loopback");
+        StageSimulation simulation(true);
+        if (!simulation.load(matches % 2 == 0, resources)) {
+            cerr << "Unable to load the stage; run from the game directory\n";
+            return 1;
+        }
+        InputBuffer input;
+        while (ticksRun < totalTicks && !simulation.matchOver()) {
+            simulation.step(input);
+            simulation.writeSpectatorState(published);
+            server.publish(published);
+            ++ticksRun;
+            pollClients();
+            nextTick += step;
+            this_thread::sleep_until(nextTick);
+        }
+        ++matches;
+        nextTick = chrono::steady_clock::now();
+    }
+
+    // Give the last batch time to arrive
+    size_t inSync = 0;
+    const auto settleDeadline = chrono::steady_clock::now() + chrono::seconds(2);
+    do {
+        this_thread::sleep_for(chrono::milliseconds(10));
+        pollClients();
+        inSync = static_cast<size_t>(count_if(clients.begin(), clients.end(), [&](const Client& client) {
+            return client.decoder.hasState() && client.decoder.state() == published;
+        }));
+    } while (inSync < clients.size() && chrono::steady_clock::now() < settleDeadline);
+
+    const SpectatorStats stats = server.stats();
+    const double gameSeconds = static_cast<double>(ticksRun) / kSimulationRate;
+    cout << fixed << setprecision(2);
+    cout << "Spectators: " << clients.size() << " connected, " << inSync << " in sync with the last tick\n";
+    cout << "Ticks: " << ticksRun << " over " << matches << " matches, " << stats.ticks << " encoded\n";
+    if (stats.ticks > 0) {
+        cout << "Encode: mean " << static_cast<double>(stats.encodeNanos) / static_cast<double>(stats.ticks) / 1000.0
+             << " us, max " << static_cast<double>(stats.maxEncodeNanos) / 1000.0 << " us per tick\n";
+    }
+    cout << "Stream: " << static_cast<double>(stats.bytes) / gameSeconds << " bytes/s per spectator, "
+         << static_cast<double>(stats.bytes * clients.size()) / gameSeconds / 1024.0 << " KiB/s served\n";
+    return inSync == clients.size() ? 0 : 1;
+}
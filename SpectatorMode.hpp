@@ -0,0 +1,17 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <string>
+
+using namespace std;
+
+#include "GameContext.hpp"
+
+// Connects to a game started with --serve-spectators and draws the match from
+// the stream until it ends or ESC is pressed.
+int runSpectator(sf::RenderWindow& window, GameContext& context, const string& host, unsigned short port);
+
+// Serves scripted matches on a loopback port to `spectators` in-process
+// clients for `seconds`, then checks every client decoded the last tick
+// exactly and prints encode time and bandwidth. Needs a GL context.
+int runSpectatorLoopback(int spectators, float seconds);
@@ -0,0 +1,319 @@
+#include "SpectatorStream.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "SessionTrace.hpp"
+
+using namespace std;
+
+namespace {
+constexpr uint64_t kKeyframeBit = 1;
+constexpr uint64_t kBulletsBit = 2;
+constexpr int kFieldShift = 2;
+constexpr size_t kFieldCount = static_cast<size_t>(SpectatorField::Count);
+// Larger than any real message (a keyframe with every bullet is ~500 bytes)
+constexpr uint64_t kMaxMessageBytes = 4096;
+// A spectator this far behind is dropped rather than buffered forever
+constexpr size_t kMaxUnsentBytes = 64 * 1024;
+// How often the server wakes to encode, send and accept
+constexpr auto kServerInterval = chrono::milliseconds(4);
+
+const SpectatorState kEmptyState{};
+
+void putVarint(vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+// Reads one varint from [cursor, end); false if it runs off the end or is too long
+bool getVarint(const uint8_t*& cursor, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (cursor == end) {
+            return false;
+        }
+        const uint8_t byte = *cursor++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Small magnitudes of either sign become small unsigned numbers
+uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// Appends one framed message; `previous` is null for a keyframe
+void encodeMessage(const SpectatorState& state, const SpectatorState* previous, vector<uint8_t>& out) {
+    const SpectatorState& base = previous ? *previous : kEmptyState;
+    uint64_t header = previous ? 0 : kKeyframeBit;
+    for (size_t i = 0; i < kFieldCount; ++i) {
+        if (!previous || state.fields[i] != base.fields[i]) {
+            header |= uint64_t{1} << (i + kFieldShift);
+        }
+    }
+    if (state.bulletCount > 0 || base.bulletCount > 0) {
+        header |= kBulletsBit;
+    }
+
+    const size_t start = out.size();
+    putVarint(out, header);
+    putVarint(out, zigzag(static_cast<int64_t>(state.tick - base.tick)));
+    for (size_t i = 0; i < kFieldCount; ++i) {
+        if (header & (uint64_t{1} << (i + kFieldShift))) {
+            putVarint(out, zigzag(static_cast<int64_t>(state.fields[i]) - base.fields[i]));
+        }
+    }
+    if (header & kBulletsBit) {
+        // Bullets keep their order while in flight, so index i is usually the
+        // same bullet one tick further along
+        putVarint(out, state.bulletCount);
+        for (size_t i = 0; i < state.bulletCount; ++i) {
+            const SpectatorBullet& bullet = state.bullets[i];
+            const SpectatorBullet before = i < base.bulletCount ? base.bullets[i] : SpectatorBullet{};
+            putVarint(out, (zigzag(static_cast<int64_t>(bullet.x) - before.x) << 1) | (bullet.fromPlayer ? 1 : 0));
+            putVarint(out, zigzag(static_cast<int64_t>(bullet.y) - before.y));
+        }
+    }
+
+    // Length prefix goes in front; messages are small, so the shift is cheap
+    uint8_t prefix[10];
+    size_t prefixSize = 0;
+    for (uint64_t length = out.size() - start;; length >>= 7) {
+        prefix[prefixSize++] = static_cast<uint8_t>(length >= 0x80 ? (length & 0x7F) | 0x80 : length);
+        if (length < 0x80) break;
+    }
+    out.insert(out.begin() + static_cast<ptrdiff_t>(start), prefix, prefix + prefixSize);
+}
+}
+
+bool SpectatorState::operator==(const SpectatorState& other) const {
+    if (tick != other.tick || fields != other.fields || bulletCount != other.bulletCount) {
+        return false;
+    }
+    return equal(bullets.begin(), bullets.begin() + static_cast<ptrdiff_t>(bulletCount), other.bullets.begin(),
+                 [](const SpectatorBullet& a, const SpectatorBullet& b) {
+                     return a.x == b.x && a.y == b.y && a.fromPlayer == b.fromPlayer;
+                 });
+}
+
+void SpectatorEncoder::encode(const SpectatorState& state, vector<uint8_t>& out) {
+    encodeMessage(state, hasPrevious ? &previous : nullptr, out);
+    previous = state;
+    hasPrevious = true;
+}
+
+void SpectatorEncoder::encodeKeyframe(const SpectatorState& state, vector<uint8_t>& out) {
+    encodeMessage(state, nullptr, out);
+}
+
+void SpectatorDecoder::feed(const uint8_t* data, size_t size) {
+    // Drop what has been consumed before growing the buffer
+    pending.erase(pending.begin(), pending.begin() + static_cast<ptrdiff_t>(readOffset));
+    readOffset = 0;
+    pending.insert(pending.end(), data, data + size);
+}
+
+bool SpectatorDecoder::next() {
+    if (corrupt) {
+        return false;
+    }
+    const uint8_t* cursor = pending.data() + readOffset;
+    const uint8_t* end = pending.data() + pending.size();
+    uint64_t length = 0;
+    if (!getVarint(cursor, end, length)) {
+        return false;
+    }
+    if (length > kMaxMessageBytes) {
+        corrupt = true;
+        return false;
+    }
+    if (static_cast<uint64_t>(end - cursor) < length) {
+        return false;
+    }
+    const uint8_t* messageEnd = cursor + length;
+    readOffset = static_cast<size_t>(messageEnd - pending.data());
+
+    uint64_t header = 0;
+    if (!getVarint(cursor, messageEnd, header)) {
+        corrupt = true;
+        return false;
+    }
+    const bool keyframe = (header & kKeyframeBit) != 0;
+    if (!keyframe && !hasCurrent) {
+        // Joined mid-stream without a keyframe; wait for one
+        return true;
+    }
+    const SpectatorState& base = keyframe ? kEmptyState : current;
+    SpectatorState decoded = base;
+    bool ok = true;
+    uint64_t value = 0;
+    ok = ok && getVarint(cursor, messageEnd, value);
+    decoded.tick = base.tick + static_cast<uint64_t>(unzigzag(value));
+    for (size_t i = 0; ok && i < kFieldCount; ++i) {
+        if (header & (uint64_t{1} << (i + kFieldShift))) {
+            ok = getVarint(cursor, messageEnd, value);
+            decoded.fields[i] = static_cast<int32_t>(base.fields[i] + unzigzag(value));
+        }
+    }
+    decoded.bulletCount = 0;
+    if (ok && (header & kBulletsBit)) {
+        ok = getVarint(cursor, messageEnd, value) && value <= kMaxSpectatorBullets;
+        decoded.bulletCount = ok ? static_cast<size_t>(value) : 0;
+        for (size_t i = 0; ok && i < decoded.bulletCount; ++i) {
+            const SpectatorBullet before = i < base.bulletCount ? base.bullets[i] : SpectatorBullet{};
+            uint64_t first = 0;
+            ok = getVarint(cursor, messageEnd, first) && getVarint(cursor, messageEnd, value);
+            SpectatorBullet& bullet = decoded.bullets[i];
+            bullet.fromPlayer = (first & 1) != 0;
+            bullet.x = static_cast<int32_t>(before.x + unzigzag(first >> 1));
+            bullet.y = static_cast<int32_t>(before.y + unzigzag(value));
+        }
+    }
+    if (!ok || cursor != messageEnd) {
+        corrupt = true;
+        return false;
+    }
+    current = decoded;
+    hasCurrent = true;
+    return true;
+}
+
+SpectatorServer::SpectatorServer(unsigned short port) {
+    listener.setBlocking(false);
+    // Local only: spectators are on this machine
+    if (listener.listen(port, sf::IpAddress::LocalHost) != sf::Socket::Status::Done) {
+        cerr << "Warning: could not serve spectators on port " << port << '\n';
+        return;
+    }
+    isListening = true;
+    batch.reserve(16 * 1024);
+    worker = thread([this] { run(); });
+}
+
+SpectatorServer::~SpectatorServer() {
+    stopping.store(true, memory_order_release);
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+unsigned short SpectatorServer::port() const {
+    return listener.getLocalPort();
+}
+
+void SpectatorServer::publish(const SpectatorState& state) {
+    // The encoder diffs against whatever it sent last, so a skipped tick
+    // only makes the next delta a little larger
+    states.push(state);
+}
+
+SpectatorStats SpectatorServer::stats() const {
+    SpectatorStats result;
+    result.ticks = ticksSent.load(memory_order_relaxed);
+    result.bytes = bytesSent.load(memory_order_relaxed);
+    result.encodeNanos = encodeNanos.load(memory_order_relaxed);
+    result.maxEncodeNanos = maxEncodeNanos.load(memory_order_relaxed);
+    result.spectators = spectatorCount.load(memory_order_relaxed);
+    return result;
+}
+
+void SpectatorServer::sendTo(Spectator& spectator, const vector<uint8_t>& bytes) {
+    if (!spectator.unsent.empty() || bytes.empty()) {
+        // Keep the stream in order behind what is already waiting
+        spectator.unsent.insert(spectator.unsent.end(), bytes.begin(), bytes.end());
+        if (spectator.unsent.empty()) {
+            return;
+        }
+        size_t sent = 0;
+        const auto status = spectator.socket->send(spectator.unsent.data(), spectator.unsent.size(), sent);
+        if (status == sf::Socket::Status::Disconnected || status == sf::Socket::Status::Error) {
+            spectator.socket.reset();
+            return;
+        }
+        spectator.unsent.erase(spectator.unsent.begin(), spectator.unsent.begin() + static_cast<ptrdiff_t>(sent));
+    } else {
+        size_t sent = 0;
+        const auto status = spectator.socket->send(bytes.data(), bytes.size(), sent);
+        if (status == sf::Socket::Status::Disconnected || status == sf::Socket::Status::Error) {
+            spectator.socket.reset();
+            return;
+        }
+        spectator.unsent.assign(bytes.begin() + static_cast<ptrdiff_t>(sent), bytes.end());
+    }
+    if (spectator.unsent.size() > kMaxUnsentBytes) {
+        cerr << "Warning: dropping a spectator that fell behind\n";
+        spectator.socket.reset();
+    }
+}
+
+void SpectatorServer::acceptSpectators() {
+    vector<uint8_t> keyframe;
+    auto socket = make_unique<sf::TcpSocket>();
+    while (listener.accept(*socket) == sf::Socket::Status::Done) {
+        socket->setBlocking(false);
+        Spectator spectator{move(socket), {}};
+        // Everything queued so far has been sent, so the encoder's last state
+        // is what the next delta builds on
+        if (encoder.hasState()) {
+            keyframe.clear();
+            SpectatorEncoder::encodeKeyframe(encoder.last(), keyframe);
+            sendTo(spectator, keyframe);
+        }
+        if (spectator.socket) {
+            spectators.push_back(move(spectator));
+        }
+        socket = make_unique<sf::TcpSocket>();
+    }
+}
+
+void SpectatorServer::run() {
+    SessionTrace::instance().nameThread("spectator server");
+    auto nextWake = chrono::steady_clock::now();
+    while (!stopping.load(memory_order_acquire)) {
+        batch.clear();
+        uint64_t ticks = 0;
+        states.drain([&](const SpectatorState& state) {
+            const auto start = chrono::steady_clock::now();
+            encoder.encode(state, batch);
+            const auto nanos = static_cast<uint64_t>(
+                chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+            encodeNanos.fetch_add(nanos, memory_order_relaxed);
+            if (nanos > maxEncodeNanos.load(memory_order_relaxed)) {
+                maxEncodeNanos.store(nanos, memory_order_relaxed);
+            }
+            ++ticks;
+        });
+        ticksSent.fetch_add(ticks, memory_order_relaxed);
+        bytesSent.fetch_add(batch.size(), memory_order_relaxed);
+
+        // One write per spectator for everything that queued since the last wake
+        for (auto& spectator : spectators) {
+            sendTo(spectator, batch);
+        }
+        spectators.erase(remove_if(spectators.begin(), spectators.end(),
+                                   [](const Spectator& spectator) { return !spectator.socket; }),
+                         spectators.end());
+        acceptSpectators();
+        spectatorCount.store(spectators.size(), memory_order_relaxed);
+
+        nextWake += kServerInterval;
+        const auto now = chrono::steady_clock::now();
+        if (nextWake < now) {
+            nextWake = now;
+        }
+        this_thread::sleep_until(nextWake);
+    }
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <SFML/Network.hpp>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+#include "SpscQueue.hpp"
+
+constexpr unsigned short kSpectatorPort = 47800;
+constexpr size_t kMaxSpectatorBullets = 32;
+// Positions travel in quarter pixels
+constexpr int kSpectatorPositionScale = 4;
+
+// Every scalar a spectator needs, delta-coded by index
+enum class SpectatorField {
+    PlayerX,
+    PlayerY,
+    PlayerState,
+    PlayerFrame,
+    PlayerFacingLeft,
+    PlayerHealth,
+    PlayerAmmo,
+    PlayerReloads,
+    PlayerWins,
+    EnemyX,
+    EnemyY,
+    EnemyState,
+    EnemyFrame,
+    EnemyFacingLeft,
+    EnemyHealth,
+    EnemyAmmo,
+    EnemyReloads,
+    EnemyWins,
+    TimeLeft,
+    Flags,
+    Count
+};
+
+// Bits of SpectatorField::Flags
+constexpr int32_t kSpectatorWaitingForStart = 1;
+constexpr int32_t kSpectatorMatchOver = 2;
+constexpr int32_t kSpectatorPlayerIsGangster1 = 4;
+
+struct SpectatorBullet {
+    int32_t x = 0;
+    int32_t y = 0;
+    bool fromPlayer = true;
+};
+
+// One tick of the stage as spectators see it. Fixed size, so it can go
+// through an SpscQueue without allocating.
+struct SpectatorState {
+    uint64_t tick = 0;
+    array<int32_t, static_cast<size_t>(SpectatorField::Count)> fields{};
+    size_t bulletCount = 0;
+    array<SpectatorBullet, kMaxSpectatorBullets> bullets{};
+
+    int32_t& operator[](SpectatorField field) { return fields[static_cast<size_t>(field)]; }
+    int32_t operator[](SpectatorField field) const { return fields[static_cast<size_t>(field)]; }
+    bool operator==(const SpectatorState& other) const;
+};
+
+// Turns a run of states into a byte stream. Each message is a varint length
+// and then a header varint: bit 0 keyframe, bit 1 bullets follow, then one
+// bit per changed field. The tick comes next, then the changed fields and
+// bullets as zigzag varint deltas against the previous state. A quiet tick is
+// three bytes.
+class SpectatorEncoder {
+public:
+    void encode(const SpectatorState& state, vector<uint8_t>& out);
+    // A self-contained message for `state`, for spectators joining mid-match
+    static void encodeKeyframe(const SpectatorState& state, vector<uint8_t>& out);
+
+    const SpectatorState& last() const { return previous; }
+    bool hasState() const { return hasPrevious; }
+
+private:
+    SpectatorState previous;
+    bool hasPrevious = false;
+};
+
+class SpectatorDecoder {
+public:
+    // Appends received bytes; call next() until it returns false
+    void feed(const uint8_t* data, size_t size);
+    // Applies the next complete message; false when more bytes are needed
+    // or the stream is broken
+    bool next();
+
+    const SpectatorState& state() const { return current; }
+    bool hasState() const { return hasCurrent; }
+    bool broken() const { return corrupt; }
+
+private:
+    vector<uint8_t> pending;
+    size_t readOffset = 0;
+    SpectatorState current;
+    bool hasCurrent = false;
+    bool corrupt = false;
+};
+
+struct SpectatorStats {
+    uint64_t ticks = 0;
+    uint64_t bytes = 0;         // stream bytes per spectator, keyframes for joiners excluded
+    uint64_t encodeNanos = 0;   // total time spent in SpectatorEncoder::encode
+    uint64_t maxEncodeNanos = 0;
+    size_t spectators = 0;
+};
+
+// Serves the stream on a local TCP port from its own thread. The simulation
+// publishes a state per tick without blocking; the server encodes whatever
+// queued up, sends it to every spectator in one write each and greets new
+// spectators with a keyframe. Spectators that fall too far behind are dropped.
+class SpectatorServer {
+public:
+    explicit SpectatorServer(unsigned short port = kSpectatorPort);
+    ~SpectatorServer();
+    SpectatorServer(const SpectatorServer&) = delete;
+    SpectatorServer& operator=(const SpectatorServer&) = delete;
+
+    bool listening() const { return isListening; }
+    unsigned short port() const;
+    // Called from the simulation thread; a full queue just skips a tick
+    void publish(const SpectatorState& state);
+    SpectatorStats stats() const;
+
+private:
+    struct Spectator {
+        unique_ptr<sf::TcpSocket> socket;
+        vector<uint8_t> unsent;
+    };
+
+    void run();
+    void acceptSpectators();
+    void sendTo(Spectator& spectator, const vector<uint8_t>& bytes);
+
+    sf::TcpListener listener;
+    bool isListening = false;
+    SpscQueue<SpectatorState, 256> states;
+    SpectatorEncoder encoder;
+    vector<Spectator> spectators;
+    vector<uint8_t> batch;
+
+    atomic<uint64_t> ticksSent{0};
+    atomic<uint64_t> bytesSent{0};
+    atomic<uint64_t> encodeNanos{0};
+    atomic<uint64_t> maxEncodeNanos{0};
+    atomic<size_t> spectatorCount{0};
+    atomic<bool> stopping{false};
+    thread worker;
+};
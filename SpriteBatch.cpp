@@ -0,0 +1,110 @@
+#include "SpriteBatch.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+
+
+using namespace std;
+
+void SpriteBatch::add(int layer, const sf::Texture& texture, const sf::IntRect& textureRect,
+                      const sf::Transform& transform, sf::Color color, const sf::Texture* palette,
+                      const SpriteEffects& effects) {
+    // An outline sits just outside the shape, which trimmed frames fill edge
+    // to edge; grow the quad by a pixel all round to make room for it
+    const float grow = effects.outline.a > 0 ? 1.f : 0.f;
+    const sf::Vector2f localLeft{-grow, -grow};
+    const sf::Vector2f localRight = sf::Vector2f(textureRect.size) + sf::Vector2f{grow, grow};
+    const sf::Vector2f texLeft = sf::Vector2f(textureRect.position) + localLeft;
+    const sf::Vector2f texRight = sf::Vector2f(textureRect.position) + localRight;
+    Quad quad;
+    quad.layer = layer;
+    quad.texture = &texture;
+    quad.palette = palette;
+    quad.effects = effects;
+    quad.sequence = static_cast<uint32_t>(quads.size());
+    quad.corners[0] = {transform.transformPoint(localLeft), color, texLeft};
+    quad.corners[1] = {transform.transformPoint({localRight.x, localLeft.y}), color, {texRight.x, texLeft.y}};
+    quad.corners[2] = {transform.transformPoint({localLeft.x, localRight.y}), color, {texLeft.x, texRight.y}};
+    quad.corners[3] = {transform.transformPoint(localRight), color, texRight};
+    quads.push_back(quad);
+}
+
+void SpriteBatch::add(int layer, const sf::Sprite& sprite, const sf::Texture* palette, const SpriteEffects& effects) {
+    add(layer, sprite.getTexture(), sprite.getTextureRect(), sprite.getTransform(), sprite.getColor(), palette,
+        effects);
+}
+
+void SpriteBatch::addRect(int layer, const sf::FloatRect& rect, sf::Color color) {
+    const sf::Vector2f end = rect.position + rect.size;
+    Quad quad;
+    quad.layer = layer;
+    quad.sequence = static_cast<uint32_t>(quads.size());
+    quad.corners[0] = {rect.position, color, {}};
+    quad.corners[1] = {{end.x, rect.position.y}, color, {}};
+    quad.corners[2] = {{rect.position.x, end.y}, color, {}};
+    quad.corners[3] = {end, color, {}};
+    quads.push_back(quad);
+}
+
+sf::Shader* SpriteBatch::spriteShader(bool indexed) {
+    const size_t variant = indexed ? 1 : 0;
+    if (!shaderLoaded[variant]) {
+        shaderLoaded[variant] = true;
+        shaders[variant] = make_unique<sf::Shader>();
+        if (!loadSpriteShader(*shaders[variant], indexed)) {
+            cerr << "Warning: the sprite shader did not compile; "
+                 << (indexed ? "indexed sheets will not draw\n" : "sprite effects are off\n");
+            shaders[variant].reset();
+        }
+    }
+    return shaders[variant].get();
+}
+
+int SpriteBatch::flush(sf::RenderTarget& target) {
+    if (quads.empty()) {
+        return 0;
+    }
+    // less<> gives pointers a total order, which plain < does not promise
+    sort(quads.begin(), quads.end(), [](const Quad& a, const Quad& b) {
+        if (a.layer != b.layer) return a.layer < b.layer;
+        if (a.texture != b.texture) return less<const sf::Texture*>()(a.texture, b.texture);
+        if (a.palette != b.palette) return less<const sf::Texture*>()(a.palette, b.palette);
+        return a.sequence < b.sequence;
+    });
+
+    vertices.clear();
+    for (const Quad& quad : quads) {
+        const auto& c = quad.corners;
+        vertices.insert(vertices.end(), {c[0], c[1], c[2], c[2], c[1], c[3]});
+    }
+
+    int drawCalls = 0;
+    size_t runStart = 0;
+    for (size_t i = 1; i <= quads.size(); ++i) {
+        const bool runEnds = i == quads.size() || quads[i].layer != quads[runStart].layer ||
+                             quads[i].texture != quads[runStart].texture ||
+                             quads[i].palette != quads[runStart].palette ||
+                             quads[i].effects != quads[runStart].effects;
+        if (!runEnds) continue;
+        const Quad& first = quads[runStart];
+        sf::RenderStates states;
+        states.texture = first.texture;
+        if (first.texture && (first.palette || first.effects.any())) {
+            sf::Shader* shader = spriteShader(first.palette != nullptr);
+            if (shader) {
+                bindSpriteShader(*shader, *first.texture, first.palette, first.effects);
+                states.shader = shader;
+            } else if (first.palette) {
+                // Indices drawn as colors would be noise
+                runStart = i;
+                continue;
+            }
+        }
+        target.draw(&vertices[runStart * 6], (i - runStart) * 6, sf::PrimitiveType::Triangles, states);
+        ++drawCalls;
+        runStart = i;
+    }
+    quads.clear();
+    return drawCalls;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+#include "SpriteShader.hpp"
+
+// Collects textured and plain quads over a frame and draws them sorted by
+// layer, then texture. Every run of quads sharing a layer and texture goes out
+// as one triangle-list draw, so the number of draw calls depends on how many
+// textures are on screen, not how many sprites. Within a run quads keep the
+// order they were added in; anything that must overlap in a set order
+// belongs on separate layers.
+//
+// A quad with a palette treats its texture as palette indices. It, and any
+// quad with effects, is drawn through the sprite shader (see SpriteShader.hpp);
+// a change of effects also ends a run, so quads sharing a look should be
+// added together.
+class SpriteBatch {
+public:
+    // Queues `textureRect` of `texture`, placed by `transform`
+    void add(int layer, const sf::Texture& texture, const sf::IntRect& textureRect, const sf::Transform& transform,
+             sf::Color color = sf::Color::White, const sf::Texture* palette = nullptr,
+             const SpriteEffects& effects = {});
+    void add(int layer, const sf::Sprite& sprite, const sf::Texture* palette = nullptr,
+             const SpriteEffects& effects = {});
+    // Untextured quad, for bars and panels
+    void addRect(int layer, const sf::FloatRect& rect, sf::Color color);
+
+    // Draws and clears everything queued; returns the number of draw calls
+    int flush(sf::RenderTarget& target);
+
+    size_t size() const { return quads.size(); }
+
+private:
+    struct Quad {
+        int layer = 0;
+        const sf::Texture* texture = nullptr;
+        const sf::Texture* palette = nullptr;
+        SpriteEffects effects;
+        uint32_t sequence = 0;
+        // Top-left, top-right, bottom-left, bottom-right
+        array<sf::Vertex, 4> corners;
+    };
+
+    // Quads and vertices keep their capacity between frames
+    vector<Quad> quads;
+    vector<sf::Vertex> vertices;
+    // The sprite shader's variants, compiled on first use; null if it failed
+    sf::Shader* spriteShader(bool indexed);
+    array<unique_ptr<sf::Shader>, 2> shaders;  // RGBA, indexed
+    array<bool, 2> shaderLoaded{};
+};
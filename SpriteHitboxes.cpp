@@ -0,0 +1,99 @@
+#include "SpriteHitboxes.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+// A strike has to stick out at least this far past the body to count as reach
+constexpr int kMinReachPixels = 4;
+
+uint64_t bitRange(int from, int to) {
+    // Bits [from, to) of a 64-bit word, 0 <= from < to <= 64
+    const uint64_t upper = to >= 64 ? ~0ull : ((1ull << to) - 1ull);
+    const uint64_t lower = (1ull << from) - 1ull;
+    return upper & ~lower;
+}
+}
+
+bool FrameMask::anyInRect(const sf::IntRect& rect) const {
+    const int x0 = max(0, rect.position.x);
+    const int y0 = max(0, rect.position.y);
+    const int x1 = min(width, rect.position.x + rect.size.x);
+    const int y1 = min(height, rect.position.y + rect.size.y);
+    if (x0 >= x1 || y0 >= y1) {
+        return false;
+    }
+    const int firstWord = x0 / 64;
+    const int lastWord = (x1 - 1) / 64;
+    for (int y = y0; y < y1; ++y) {
+        const uint64_t* row = bits.data() + static_cast<size_t>(y) * wordsPerRow;
+        for (int w = firstWord; w <= lastWord; ++w) {
+            const int from = w == firstWord ? x0 % 64 : 0;
+            const int to = w == lastWord ? (x1 - 1) % 64 + 1 : 64;
+            if (row[w] & bitRange(from, to)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+FrameMask buildFrameMask(const sf::Image& image, const sf::IntRect& area) {
+    FrameMask mask;
+    mask.width = area.size.x;
+    mask.height = area.size.y;
+    mask.wordsPerRow = (area.size.x + 63) / 64;
+    mask.bits.assign(static_cast<size_t>(mask.wordsPerRow) * mask.height, 0ull);
+
+    const auto size = image.getSize();
+    const uint8_t* pixels = image.getPixelsPtr();
+    for (int y = 0; y < area.size.y; ++y) {
+        const int py = area.position.y + y;
+        if (py < 0 || py >= static_cast<int>(size.y)) continue;
+        const uint8_t* row = pixels + (static_cast<size_t>(py) * size.x + area.position.x) * 4;
+        uint64_t* out = mask.bits.data() + static_cast<size_t>(y) * mask.wordsPerRow;
+        for (int x = 0; x < area.size.x; ++x) {
+            if (row[x * 4 + 3] > kOpaqueAlpha) {
+                out[x / 64] |= 1ull << (x % 64);
+            }
+        }
+    }
+    return mask;
+}
+
+vector<FrameHitbox> buildHitboxTable(const sf::Image& sheet, int frameWidth, int frameHeight, int frameCount,
+                                     bool strikes) {
+    vector<FrameHitbox> table(static_cast<size_t>(max(0, frameCount)));
+    for (int i = 0; i < frameCount; ++i) {
+        const sf::IntRect area(sf::Vector2i{i * frameWidth, 0}, sf::Vector2i{frameWidth, frameHeight});
+        table[i].hurtbox = computeOpaqueBounds(sheet, area);
+    }
+    if (!strikes) {
+        return table;
+    }
+
+    // The resting body is the narrowest pose of the strip; anything past its
+    // front edge in another frame is the arm, knife or gun doing the hitting.
+    int bodyRight = frameWidth;
+    for (const auto& frame : table) {
+        if (frame.hurtbox.size.x > 0) {
+            bodyRight = min(bodyRight, frame.hurtbox.position.x + frame.hurtbox.size.x);
+        }
+    }
+    if (bodyRight >= frameWidth) {
+        return table;
+    }
+
+    for (int i = 0; i < frameCount; ++i) {
+        const sf::IntRect reachArea(sf::Vector2i{i * frameWidth + bodyRight, 0},
+                                    sf::Vector2i{frameWidth - bodyRight, frameHeight});
+        sf::IntRect reach = computeOpaqueBounds(sheet, reachArea);
+        if (reach.size.x >= kMinReachPixels) {
+            reach.position.x += bodyRight;
+            table[i].hitbox = reach;
+            table[i].hasHitbox = true;
+        }
+    }
+    return table;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+#include "SpriteSheetAnalyzer.hpp"
+
+// Tight collision boxes for one animation frame, in frame-local pixels.
+// Sheets face right, so the hitbox is whatever reaches past the body on that side.
+struct FrameHitbox {
+    sf::IntRect hurtbox;
+    sf::IntRect hitbox;
+    bool hasHitbox = false;
+};
+
+// One bit per opaque pixel, each row padded to whole 64-bit words
+struct FrameMask {
+    int width = 0;
+    int height = 0;
+    int wordsPerRow = 0;
+    vector<uint64_t> bits;
+
+    bool empty() const { return bits.empty(); }
+    // True if any opaque pixel falls inside the given frame-local rect
+    bool anyInRect(const sf::IntRect& rect) const;
+};
+
+FrameMask buildFrameMask(const sf::Image& image, const sf::IntRect& area);
+
+// Builds one entry per frame of a horizontal strip. Only strike animations
+// (melee, shooting) get hitboxes; everything else just gets its hurtbox.
+vector<FrameHitbox> buildHitboxTable(const sf::Image& sheet, int frameWidth, int frameHeight, int frameCount,
+                                     bool strikes);
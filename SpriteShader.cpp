@@ -0,0 +1,80 @@
+#include "SpriteShader.hpp"
+
+#include <string>
+
+#include "IndexedSheet.hpp"
+
+using namespace std;
+
+namespace {
+// SFML divides texture coordinates by the bound texture's size, so
+// multiplying back gives the pixel being drawn. For an index texture that is
+// a pixel of the unpacked image, four to a texel.
+constexpr const char* kSpriteShader = R"(
+uniform sampler2D source;
+uniform sampler2D palette;
+uniform vec2 sourceSize;
+uniform float flash;
+uniform vec4 tint;
+uniform vec4 outline;
+
+vec4 pixelAt(vec2 pixel) {
+#ifdef INDEXED
+    vec2 imageSize = sourceSize * vec2(4.0, 1.0);
+#else
+    vec2 imageSize = sourceSize;
+#endif
+    // Outlines reach one pixel past the frame; the sheet's edge is empty there
+    if (any(lessThan(pixel, vec2(0.0))) || any(greaterThanEqual(pixel, imageSize))) {
+        return vec4(0.0);
+    }
+#ifdef INDEXED
+    float texel = floor(pixel.x / 4.0);
+    float lane = pixel.x - texel * 4.0;
+    vec4 lanes = texture2D(source, (vec2(texel, pixel.y) + 0.5) / sourceSize);
+    float index = lane < 0.5 ? lanes.r : (lane < 1.5 ? lanes.g : (lane < 2.5 ? lanes.b : lanes.a));
+    return texture2D(palette, vec2((index * 255.0 + 0.5) / 256.0, 0.5));
+#else
+    return texture2D(source, (pixel + 0.5) / sourceSize);
+#endif
+}
+
+void main() {
+    vec2 pixel = floor(gl_TexCoord[0].xy * sourceSize);
+    vec4 color = pixelAt(pixel);
+    if (color.a == 0.0 && outline.a > 0.0) {
+        float around = pixelAt(pixel + vec2(1.0, 0.0)).a + pixelAt(pixel - vec2(1.0, 0.0)).a +
+                       pixelAt(pixel + vec2(0.0, 1.0)).a + pixelAt(pixel - vec2(0.0, 1.0)).a;
+        if (around > 0.0) {
+            color = outline;
+        }
+    }
+    color.rgb = mix(color.rgb, tint.rgb, tint.a);
+    color.rgb = mix(color.rgb, vec3(1.0), flash);
+    gl_FragColor = gl_Color * color;
+}
+)";
+}
+
+bool loadSpriteShader(sf::Shader& shader, bool indexed) {
+    if (!sf::Shader::isAvailable()) {
+        return false;
+    }
+    const string source = string(indexed ? "#define INDEXED\n" : "") + kSpriteShader;
+    if (!shader.loadFromMemory(source, sf::Shader::Type::Fragment)) {
+        return false;
+    }
+    shader.setUniform("source", sf::Shader::CurrentTexture);
+    return true;
+}
+
+void bindSpriteShader(sf::Shader& shader, const sf::Texture& texture, const sf::Texture* palette,
+                      const SpriteEffects& effects) {
+    if (palette) {
+        shader.setUniform("palette", *palette);
+    }
+    shader.setUniform("sourceSize", sf::Glsl::Vec2(sf::Vector2f(texture.getSize())));
+    shader.setUniform("flash", effects.flash);
+    shader.setUniform("tint", sf::Glsl::Vec4(effects.tint));
+    shader.setUniform("outline", sf::Glsl::Vec4(effects.outline));
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+
+using namespace std;
+
+// Per-draw looks applied by the sprite shader instead of swapped sheets or
+// recolored textures. The defaults change nothing.
+struct SpriteEffects {
+    float flash = 0.f;                           // 0 to 1, toward white
+    sf::Color tint = sf::Color::Transparent;     // mixed in by its alpha
+    sf::Color outline = sf::Color::Transparent;  // one pixel around the shape; alpha 0 for none
+
+    bool any() const { return flash > 0.f || tint.a > 0 || outline.a > 0; }
+    bool operator==(const SpriteEffects& other) const {
+        return flash == other.flash && tint == other.tint && outline == other.outline;
+    }
+    bool operator!=(const SpriteEffects& other) const { return !(*this == other); }
+};
+
+// One fragment shader for every sprite that needs more than a plain texture
+// lookup. The indexed variant reads a palette index texture (see
+// IndexedSheet.hpp); the other reads RGBA. Both sample whole texels, so an
+// RGBA sheet drawn through it loses smoothing.
+bool loadSpriteShader(sf::Shader& shader, bool indexed);
+// Sets the uniforms for one draw. `texture` is the texture the draw binds;
+// `palette` is required by the indexed variant and ignored by the other.
+void bindSpriteShader(sf::Shader& shader, const sf::Texture& texture, const sf::Texture* palette,
+                      const SpriteEffects& effects);
@@ -0,0 +1,240 @@
+#include "SpriteSheetAnalyzer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CHAVACANO_SSE2 1
+#endif
+
+using namespace std;
+
+namespace {
+// Transparent gutter between packed frames so smoothing never samples a
+// neighbour; two wide because a sprite outline reads one pixel past the frame
+constexpr int kPackPadding = 2;
+
+const uint8_t* rowPointer(const sf::Image& image, int x, int y) {
+    return image.getPixelsPtr() + (static_cast<size_t>(y) * image.getSize().x + x) * 4;
+}
+
+// Bit i set when pixel i of `count` (<= 4) RGBA pixels is opaque
+unsigned opaqueBits4(const uint8_t* pixels, int count) {
+#if CHAVACANO_SSE2
+    if (count == 4) {
+        const __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels));
+        const __m128i alpha = _mm_srli_epi32(px, 24);
+        const __m128i opaque = _mm_cmpgt_epi32(alpha, _mm_set1_epi32(kOpaqueAlpha));
+        return static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(opaque)));
+    }
+#endif
+    unsigned bits = 0;
+    for (int i = 0; i < count; ++i) {
+        if (pixels[i * 4 + 3] > kOpaqueAlpha) {
+            bits |= 1u << i;
+        }
+    }
+    return bits;
+}
+
+int lowestBit(unsigned bits) {
+    int i = 0;
+    while (!(bits & 1u)) {
+        bits >>= 1;
+        ++i;
+    }
+    return i;
+}
+
+int highestBit(unsigned bits) {
+    int i = -1;
+    while (bits) {
+        bits >>= 1;
+        ++i;
+    }
+    return i;
+}
+
+// First and last opaque pixel of a row span, -1 when the span is empty
+void rowExtent(const uint8_t* row, int width, int& first, int& last) {
+    first = -1;
+    last = -1;
+    for (int x = 0; x < width; x += 4) {
+        const unsigned bits = opaqueBits4(row + x * 4, min(4, width - x));
+        if (bits) {
+            first = x + lowestBit(bits);
+            break;
+        }
+    }
+    if (first < 0) {
+        return;
+    }
+    const int tail = width % 4 == 0 ? 4 : width % 4;
+    for (int x = width - tail; x >= first - 3; x -= 4) {
+        const int start = max(0, x);
+        const unsigned bits = opaqueBits4(row + start * 4, min(4, width - start));
+        if (bits) {
+            last = start + highestBit(bits);
+            return;
+        }
+    }
+}
+
+// Columns of the sheet that contain at least one opaque pixel
+vector<uint8_t> columnOccupancy(const sf::Image& sheet) {
+    const auto size = sheet.getSize();
+    const int width = static_cast<int>(size.x);
+    vector<uint8_t> occupied(static_cast<size_t>(width), 0);
+    for (int y = 0; y < static_cast<int>(size.y); ++y) {
+        const uint8_t* row = rowPointer(sheet, 0, y);
+        for (int x = 0; x < width; x += 4) {
+            const unsigned bits = opaqueBits4(row + x * 4, min(4, width - x));
+            for (unsigned b = bits; b; b &= b - 1) {
+                occupied[x + lowestBit(b)] = 1;
+            }
+        }
+    }
+    return occupied;
+}
+
+// A split into `frames` cells fits when every cell has a pose and no pose
+// straddles a cell boundary
+bool frameSplitFits(const vector<uint8_t>& occupied, int frames) {
+    const int width = static_cast<int>(occupied.size());
+    const int cellWidth = width / frames;
+    for (int i = 0; i < frames; ++i) {
+        const int begin = i * cellWidth;
+        if (i > 0 && occupied[begin] && occupied[begin - 1]) {
+            return false;
+        }
+        if (!any_of(occupied.begin() + begin, occupied.begin() + begin + cellWidth,
+                    [](uint8_t c) { return c != 0; })) {
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+sf::IntRect computeOpaqueBounds(const sf::Image& image, const sf::IntRect& area) {
+    const auto size = image.getSize();
+    int minX = area.size.x, minY = area.size.y, maxX = -1, maxY = -1;
+    for (int y = 0; y < area.size.y; ++y) {
+        const int py = area.position.y + y;
+        if (py < 0 || py >= static_cast<int>(size.y)) continue;
+        int first = 0, last = 0;
+        rowExtent(rowPointer(image, area.position.x, py), area.size.x, first, last);
+        if (first < 0) continue;
+        minX = min(minX, first);
+        maxX = max(maxX, last);
+        minY = min(minY, y);
+        maxY = y;
+    }
+    if (maxX < 0) {
+        return sf::IntRect{};
+    }
+    return sf::IntRect(sf::Vector2i{minX, minY}, sf::Vector2i{maxX - minX + 1, maxY - minY + 1});
+}
+
+int detectFrameCount(const sf::Image& sheet) {
+    const auto size = sheet.getSize();
+    if (size.x == 0 || size.y == 0) {
+        return 1;
+    }
+    const int width = static_cast<int>(size.x);
+    const int squareGuess = max(1, width / static_cast<int>(size.y));
+    const auto occupied = columnOccupancy(sheet);
+
+    if (width % squareGuess == 0 && frameSplitFits(occupied, squareGuess)) {
+        return squareGuess;
+    }
+    // Widest consistent split wins; frames narrower than 8px are not poses
+    for (int frames = width / 8; frames > 1; --frames) {
+        if (width % frames == 0 && frameSplitFits(occupied, frames)) {
+            return frames;
+        }
+    }
+    return squareGuess;
+}
+
+SheetLayout analyzeSheet(const sf::Image& sheet, int frameCount) {
+    SheetLayout layout;
+    const auto size = sheet.getSize();
+    if (size.x == 0 || size.y == 0) {
+        return layout;
+    }
+    if (frameCount <= 0) {
+        frameCount = detectFrameCount(sheet);
+    }
+    layout.cellWidth = static_cast<int>(size.x) / frameCount;
+    layout.cellHeight = static_cast<int>(size.y);
+
+    int packedWidth = 0;
+    int packedHeight = 1;
+    layout.frames.resize(static_cast<size_t>(frameCount));
+    for (int i = 0; i < frameCount; ++i) {
+        auto& frame = layout.frames[i];
+        frame.cell = sf::IntRect(sf::Vector2i{i * layout.cellWidth, 0},
+                                 sf::Vector2i{layout.cellWidth, layout.cellHeight});
+        sf::IntRect bounds = computeOpaqueBounds(sheet, frame.cell);
+        if (bounds.size.x == 0) {
+            // Keep a single transparent pixel so the frame still has a valid rect
+            bounds = sf::IntRect(sf::Vector2i{0, 0}, sf::Vector2i{1, 1});
+        }
+        frame.offset = bounds.position;
+        frame.trimmed = sf::IntRect(sf::Vector2i{packedWidth, 0}, bounds.size);
+        packedWidth += bounds.size.x + (i + 1 < frameCount ? kPackPadding : 0);
+        packedHeight = max(packedHeight, bounds.size.y);
+    }
+
+    vector<uint8_t> pixels(static_cast<size_t>(packedWidth) * packedHeight * 4, 0);
+    for (const auto& frame : layout.frames) {
+        const size_t rowBytes = static_cast<size_t>(frame.trimmed.size.x) * 4;
+        for (int y = 0; y < frame.trimmed.size.y; ++y) {
+            const uint8_t* src = rowPointer(sheet, frame.cell.position.x + frame.offset.x, frame.offset.y + y);
+            uint8_t* dst = pixels.data() + (static_cast<size_t>(y) * packedWidth + frame.trimmed.position.x) * 4;
+            memcpy(dst, src, rowBytes);
+        }
+    }
+    layout.packed = sf::Image(sf::Vector2u{static_cast<unsigned>(packedWidth), static_cast<unsigned>(packedHeight)},
+                              pixels.data());
+    return layout;
+}
+
+void applyColorKey(sf::Image& image, sf::Color key) {
+    const auto size = image.getSize();
+    const size_t count = static_cast<size_t>(size.x) * size.y;
+    if (count == 0) {
+        return;
+    }
+    vector<uint8_t> pixels(image.getPixelsPtr(), image.getPixelsPtr() + count * 4);
+    // Build both words from bytes so the compare works on either endianness
+    uint32_t keyWord = 0;
+    uint32_t alphaMask = 0;
+    const uint8_t keyBytes[4] = {key.r, key.g, key.b, key.a};
+    const uint8_t alphaBytes[4] = {0, 0, 0, 0xFF};
+    memcpy(&keyWord, keyBytes, 4);
+    memcpy(&alphaMask, alphaBytes, 4);
+
+    size_t i = 0;
+#if CHAVACANO_SSE2
+    const __m128i keyVec = _mm_set1_epi32(static_cast<int>(keyWord));
+    const __m128i alphaVec = _mm_set1_epi32(static_cast<int>(alphaMask));
+    for (; i + 4 <= count; i += 4) {
+        __m128i* p = reinterpret_cast<__m128i*>(pixels.data() + i * 4);
+        const __m128i px = _mm_loadu_si128(p);
+        const __m128i match = _mm_cmpeq_epi32(px, keyVec);
+        _mm_storeu_si128(p, _mm_andnot_si128(_mm_and_si128(match, alphaVec), px));
+    }
+#endif
+    for (; i < count; ++i) {
+        uint32_t word = 0;
+        memcpy(&word, pixels.data() + i * 4, 4);
+        if (word == keyWord) {
+            word &= ~alphaMask;
+            memcpy(pixels.data() + i * 4, &word, 4);
+        }
+    }
+    image = sf::Image(size, pixels.data());
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// Pixels with alpha at or below this are treated as empty margin
+constexpr uint8_t kOpaqueAlpha = 32;
+
+// One animation frame after trimming. `cell` is the untrimmed frame in the
+// original sheet, `trimmed` is where the opaque part lives in the packed
+// texture and `offset` is its top-left inside the cell, so drawing with
+// origin -offset puts every pixel exactly where the untrimmed frame had it.
+struct SheetFrame {
+    sf::IntRect cell;
+    sf::IntRect trimmed;
+    sf::Vector2i offset;
+};
+
+struct SheetLayout {
+    int cellWidth = 0;
+    int cellHeight = 0;
+    vector<SheetFrame> frames;
+    sf::Image packed;
+};
+
+// Tight opaque bounds of `area`, relative to its top-left; empty rect if fully transparent
+sf::IntRect computeOpaqueBounds(const sf::Image& image, const sf::IntRect& area);
+
+// Number of equal-width frames in a horizontal strip, found from the empty
+// columns between poses. Falls back to square frames when nothing fits.
+int detectFrameCount(const sf::Image& sheet);
+
+// Splits a strip into frames (detected when frameCount is 0), trims every
+// frame to its opaque bounds and packs the results into one smaller image.
+SheetLayout analyzeSheet(const sf::Image& sheet, int frameCount = 0);
+
+// Bulk version of sf::Image::createMaskFromColor
+void applyColorKey(sf::Image& image, sf::Color key);
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+using namespace std;
+
+// Fixed-size lock-free queue for exactly one producer thread and one consumer
+// thread. Nothing allocates after construction; push fails when full.
+template <typename T, size_t Capacity>
+class SpscQueue {
+public:
+    bool push(const T& value) {
+        const size_t head = writeIndex.load(memory_order_relaxed);
+        if (head - readIndex.load(memory_order_acquire) >= Capacity) {
+            return false;
+        }
+        items[head % Capacity] = value;
+        writeIndex.store(head + 1, memory_order_release);
+        return true;
+    }
+
+    // Pops items in order for as long as `keep` accepts the next one
+    template <typename Keep, typename Apply>
+    size_t drainWhile(Keep&& keep, Apply&& apply) {
+        size_t count = 0;
+        size_t tail = readIndex.load(memory_order_relaxed);
+        const size_t head = writeIndex.load(memory_order_acquire);
+        while (tail != head) {
+            const T& item = items[tail % Capacity];
+            if (!keep(item)) {
+                break;
+            }
+            apply(item);
+            ++tail;
+            ++count;
+        }
+        readIndex.store(tail, memory_order_release);
+        return count;
+    }
+
+    template <typename Apply>
+    size_t drain(Apply&& apply) {
+        return drainWhile([](const T&) { return true; }, apply);
+    }
+
+private:
+    array<T, Capacity> items{};
+    alignas(64) atomic<size_t> writeIndex{0};
+    alignas(64) atomic<size_t> readIndex{0};
+};
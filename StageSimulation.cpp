@@ -0,0 +1,1050 @@
+#include "StageSimulation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+#include "FighterHitTest.hpp"
+#include "SessionTrace.hpp"
+
+using namespace std;
+
+namespace {
+constexpr Fixed kPlayerSpeed = Fixed::fromInt(220);
+constexpr Fixed kEnemySpeed = Fixed::fromInt(160);
+constexpr Fixed kJumpStrength = Fixed::fromInt(-420);
+constexpr Fixed kGravity = Fixed::fromInt(1200);
+constexpr float kEnemyFireCooldown = 0.8f;
+constexpr float kEnemyAttackCooldown = 0.7f;
+constexpr float kEnemyReloadTime = 2.0f;
+constexpr float kAttackCooldownTime = 0.6f;
+constexpr float kShootCooldownTime = 0.5f;
+constexpr float kHitStunDuration = 0.5f;
+constexpr float kRoundEndDisplayTime = 3.0f;
+constexpr int kMaxRounds = 3;
+constexpr Fixed kBulletSpeed = Fixed::fromInt(700);
+constexpr Fixed kArenaRight = Fixed::fromInt(kArenaWidth);
+constexpr Fixed kGround = Fixed::fromInt(kGroundY);
+constexpr Fixed kFullHealth = Fixed::fromInt(100);
+
+// Durations above are tuned in seconds; the simulation counts ticks
+constexpr uint32_t ticksFor(float seconds) {
+    return static_cast<uint32_t>(seconds * static_cast<float>(kSimulationRate) + 0.5f);
+}
+
+optional<InputClock::time_point> earliest(const optional<InputClock::time_point>& a,
+                                          const optional<InputClock::time_point>& b) {
+    return a && (!b || *a < *b) ? a : b;
+}
+
+FixedRect strikeReach(const CharacterSpriteManager& sprites, const FixedVec2& feet) {
+    return cellToWorld(sprites, feet, sprites.attack.cellStrikeReach());
+}
+
+// A fighter's cell in world units; its position is the cell's top left and
+// its feet are the middle of the cell's bottom edge
+FixedVec2 fighterSize(const CharacterSpriteManager& sprites) {
+    return {Fixed::fromInt(sprites.walk.frameWidth) * kFighterScale,
+            Fixed::fromInt(sprites.walk.frameHeight) * kFighterScale};
+}
+
+// 64-bit FNV-1a, fed whole integers a byte at a time
+struct StateHasher {
+    uint64_t value = 14695981039346656037ull;
+
+    void add(int64_t v) {
+        for (int i = 0; i < 8; ++i) {
+            value ^= static_cast<uint64_t>(v >> (i * 8)) & 0xFFu;
+            value *= 1099511628211ull;
+        }
+    }
+    void add(Fixed v) { add(static_cast<int64_t>(v.raw())); }
+    void add(const FixedVec2& v) {
+        add(v.x);
+        add(v.y);
+    }
+};
+
+FighterView viewOf(CharacterSpriteManager& sprites) {
+    FighterView view;
+    if (const sf::Sprite* sprite = sprites.getCurrentSprite()) {
+        view.texture = &sprite->getTexture();
+        view.palette = sprites.getCurrentAnimation().paletteTexture();
+        view.textureRect = sprite->getTextureRect();
+        view.transform = sprites.facingTransform() * sprite->getTransform();
+    }
+    return view;
+}
+
+// What the HUD's last action shows for an event, if anything
+const char* historyEntry(const GameEvent& event) {
+    const bool player = event.fighter == 0;
+    switch (event.type) {
+    case GameEventType::Fired:
+        return player ? "Player fired" : "Enemy fired";
+    case GameEventType::Melee:
+        return player ? "Player melee attack" : "Enemy melee attack";
+    case GameEventType::Reloaded:
+        return player ? "Reloaded ammo" : "Enemy reloaded";
+    case GameEventType::RoundEnded:
+        return player ? "Player victory" : "Player down";
+    case GameEventType::Hit:
+    case GameEventType::Died:
+        break;
+    }
+    return nullptr;
+}
+}
+
+void MatchStats::record(const GameEvent& event) {
+    const int fighter = event.fighter;
+    switch (event.type) {
+    case GameEventType::Fired:
+        ++shots[fighter];
+        break;
+    case GameEventType::Hit:
+        ++bulletHits[fighter];
+        damage[fighter] += event.damage;
+        break;
+    case GameEventType::Melee:
+        if (event.landed) {
+            ++meleeHits[fighter];
+            damage[fighter] += event.damage;
+        }
+        break;
+    case GameEventType::RoundEnded:
+        // Rounds that start after kMaxRounds never happen, but stay in bounds anyway
+        if (rounds < static_cast<int>(roundTicks.size())) {
+            roundTicks[rounds++] = event.roundTicks;
+        }
+        break;
+    case GameEventType::Reloaded:
+    case GameEventType::Died:
+        break;
+    }
+}
+
+StageSimulation::StageSimulation(const char*& lastAction, bool scriptedPlayer) : StageSimulation(scriptedPlayer) {
+    this->lastAction = &lastAction;
+}
+
+StageSimulation::StageSimulation(bool scriptedPlayer) : scriptedPlayer(scriptedPlayer) {
+    // Nobody is there to press ENTER for a scripted player
+    waitingForStart = !scriptedPlayer;
+    resetRoundMemory();
+    enemyAi.resize(1);
+}
+
+void StageSimulation::resetRoundMemory() {
+    // Swapping with fresh containers hands back their storage (a no-op in the
+    // arena); only then is it safe to rewind
+    pmr::vector<Bullet>(&roundArena).swap(bullets);
+    pmr::vector<int>(&roundArena).swap(playerAmmo);
+    roundArena.reset();
+    bullets.reserve(64);
+    playerAmmo.reserve(kMaxAmmo);
+}
+
+bool StageSimulation::load(bool gangster1, ResourceScope& resources) {
+    TraceSpan span("load fighters", "load");
+    playerIsGangster1 = gangster1;
+    if (!playerSprites.loadAll(playerIsGangster1) || !enemySprites.loadAll(!playerIsGangster1)) {
+        return false;
+    }
+    for (const auto* sprites : {&playerSprites, &enemySprites}) {
+        for (const AnimatedSprite* animation : sprites->animations()) {
+            resources.track(animation->texture);
+            if (const sf::Texture* palette = animation->paletteTexture()) {
+                resources.track(*palette);
+            }
+            resources.track(ResourceCategory::Collision, animation->collisionBytes());
+        }
+    }
+    const sf::Vector2f baseScale{kFighterScale.toFloat(), kFighterScale.toFloat()};
+    playerSprites.setScale(baseScale);
+    enemySprites.setScale(baseScale);
+    playerSprites.setPosition(playerPosition.toFloat());
+    enemySprites.setPosition(enemyPosition.toFloat());
+
+    if (loadBulletTexture(bullet, bulletAnchor)) {
+        resources.track(bullet);
+        bulletShape = makeBulletShape(bullet, bulletAnchor);
+    }
+    reloadPlayer(true);  // Initial reload (doesn't count against the 3)
+    return true;
+}
+
+void StageSimulation::loadShared(bool gangster1, const CharacterSpriteManager& gangster1Sheets,
+                                 const CharacterSpriteManager& gangster3Sheets, const BulletShape& shape) {
+    playerIsGangster1 = gangster1;
+    playerSprites.shareTables(playerIsGangster1 ? gangster1Sheets : gangster3Sheets);
+    enemySprites.shareTables(playerIsGangster1 ? gangster3Sheets : gangster1Sheets);
+    bulletShape = shape;
+    reloadPlayer(true);
+}
+
+void StageSimulation::restartMatch() {
+    // Everything a freshly loaded simulation starts with, field by field
+    waitingForStart = !scriptedPlayer;
+    movingLeft = false;
+    movingRight = false;
+    isRunning = false;
+    playerJumping = false;
+    enemyJumping = false;
+    playerVerticalVelocity = Fixed();
+    enemyVerticalVelocity = Fixed();
+    enemyIsReloading = false;
+    enemyIsRunning = false;
+    enemyDirection = -1;
+    for (uint32_t* timer : {&stageTime, &enemyDecisionTimer, &enemyFireTimer, &enemyAttackTimer, &enemyReloadTimer,
+                            &playerAttackTimer, &playerShootTimer, &playerHitStunTimer, &enemyHitStunTimer,
+                            &roundEndTimer, &scriptedDecisionTimer}) {
+        *timer = 0;
+    }
+    scriptedDecisions = 0;
+    winNoted = false;
+    defeatNoted = false;
+    currentRound = 1;
+    playerWins = 0;
+    enemyWins = 0;
+    roundEnded = false;
+    gameEnded = false;
+    playerHitStunned = false;
+    enemyHitStunned = false;
+    playerDeathAnnounced = false;
+    enemyDeathAnnounced = false;
+    playerDeadAnimating = false;
+    enemyDeadAnimating = false;
+    tick = 0;
+    oldestInput.reset();
+    previousTickInput.reset();
+    unseenInput.reset();
+    stats = MatchStats();
+
+    playerSprites.restart();
+    enemySprites.restart();
+    placeFighters();
+    playerHealth = kFullHealth;
+    enemyHealth = kFullHealth;
+    resetRoundMemory();
+    playerReloads = 2;
+    reloadPlayer(true);
+    enemyReloads = 2;
+    enemyAmmo = kMaxAmmo;
+}
+
+void StageSimulation::setLevel(const LevelLayout& layout) {
+    level = layout;
+    arenaRight = layout.width();
+    placeFighters();
+}
+
+void StageSimulation::placeFighters() {
+    if (level) {
+        // Spawns mark where the feet go
+        for (auto [sprites, position, spawn] : {tuple{&playerSprites, &playerPosition, level->playerSpawn},
+                                                tuple{&enemySprites, &enemyPosition, level->enemySpawn}}) {
+            const FixedVec2 size = fighterSize(*sprites);
+            *position = FixedVec2{spawn.x - Fixed::fromRaw(size.x.raw() / 2), spawn.y - size.y};
+        }
+    } else {
+        playerPosition = FixedVec2{Fixed::fromInt(120), kGround};
+        enemyPosition = FixedVec2{kArenaRight - Fixed::fromInt(250), kGround};
+    }
+    playerSprites.setPosition(playerPosition.toFloat());
+    enemySprites.setPosition(enemyPosition.toFloat());
+}
+
+Fixed StageSimulation::floorFor(const CharacterSpriteManager& sprites, const FixedVec2& position) const {
+    if (!level) {
+        return kGround;
+    }
+    // The first surface under the feet, or one a little above them, so a
+    // landing that sank in by a tick's fall still counts
+    const FixedVec2 size = fighterSize(sprites);
+    const Fixed feetX = position.x + Fixed::fromRaw(size.x.raw() / 2);
+    const Fixed feetY = position.y + size.y;
+    return level->surfaceBelow(feetX, feetY - Fixed::fromInt(kTileSize / 2)) - size.y;
+}
+
+void StageSimulation::note(const char* action) {
+    if (lastAction) {
+        *lastAction = action;
+    }
+}
+
+void StageSimulation::emit(GameEventType type, int fighter, const FixedVec2& position, int direction, Fixed damage,
+                           bool landed) {
+    GameEvent event;
+    event.type = type;
+    event.fighter = static_cast<uint8_t>(fighter);
+    event.landed = landed;
+    // Gangster 1 carries the tommy gun
+    event.tommyGun = (fighter == 0) == playerIsGangster1;
+    event.roundTicks = stageTime;
+    event.damage = damage;
+    event.position = position.toFloat();
+    event.direction = static_cast<float>(direction);
+    stats.record(event);
+    if (const char* action = historyEntry(event)) {
+        note(action);
+    }
+    // A full queue only means the draw thread is behind: a missed sound or
+    // fewer sparks, never a missed count
+    events.push(event);
+}
+
+Fixed StageSimulation::hurt(Fixed& health, int amount) {
+    const Fixed before = health;
+    health = fixedMax(Fixed(), health - Fixed::fromInt(amount));
+    return before - health;
+}
+
+void StageSimulation::reloadPlayer(bool isInitialLoad) {
+    if (isInitialLoad || playerReloads > 0) {
+        // The magazine keeps the round's capacity, so reloading never allocates
+        playerAmmo.clear();
+        for (int i = 0; i < kMaxAmmo; ++i) {
+            playerAmmo.push_back(i);
+        }
+        if (isInitialLoad) {
+            // Not a reload the player made: shown on the HUD, but no event, so
+            // it plays no sound and telemetry doesn't count it
+            note("Reloaded ammo");
+        } else {
+            playerReloads--;
+            emit(GameEventType::Reloaded, 0, playerPosition);
+        }
+    }
+}
+
+void StageSimulation::startMatch() {
+    waitingForStart = false;
+    stageTime = 0;
+    enemyDecisionTimer = 0;
+    enemyFireTimer = 0;
+}
+
+void StageSimulation::applyInput(const InputEvent& input) {
+    if (waitingForStart) {
+        if (input.action == InputAction::Start && input.pressed) {
+            startMatch();
+        }
+        return;
+    }
+    switch (input.action) {
+    case InputAction::Left:
+        movingLeft = input.pressed;
+        break;
+    case InputAction::Right:
+        movingRight = input.pressed;
+        break;
+    case InputAction::Run:
+        isRunning = input.pressed;
+        break;
+    case InputAction::Jump:
+        if (input.pressed) playerJump();
+        break;
+    case InputAction::Shoot:
+        if (input.pressed) playerShoot();
+        break;
+    case InputAction::Melee:
+        if (input.pressed) playerMelee();
+        break;
+    case InputAction::Reload:
+        if (input.pressed) reloadPlayer();
+        break;
+    case InputAction::Start:
+        break;
+    }
+}
+
+void StageSimulation::playerJump() {
+    if (!playerJumping && !playerHitStunned) {
+        playerJumping = true;
+        playerVerticalVelocity = kJumpStrength;
+        playerSprites.changeState(SpriteState::Jump);
+        note("Player jumped");
+    }
+}
+
+FixedVec2 StageSimulation::gunTip(const CharacterSpriteManager& sprites, const FixedVec2& feet,
+                                  int direction) const {
+    FixedVec2 tip = feet;
+    const AnimatedSprite& pose = sprites.getCurrentAnimation();
+    if (pose.loaded()) {
+        const FixedRect bounds =
+            cellToWorld(sprites, feet, sf::IntRect(sf::Vector2i{0, 0}, sf::Vector2i{pose.frameWidth, pose.frameHeight}));
+        // Use a lower point on the sprite so the bullet leaves around the gun
+        tip.y = bounds.top + bounds.height * Fixed::fromDouble(0.6);
+        tip.x = direction > 0 ? bounds.right() - Fixed::fromInt(10) : bounds.left + Fixed::fromInt(10);
+    } else {
+        // Fallback: slightly above feet, in front of the shooter
+        tip.y -= Fixed::fromInt(28);
+        tip.x += Fixed::fromInt(40 * direction);
+    }
+    return tip;
+}
+
+void StageSimulation::spawnBullet(bool fromPlayer, const FixedVec2& position, int direction) {
+    if (bulletShape.size.x == Fixed() || bulletShape.size.y == Fixed()) {
+        return;
+    }
+    Bullet b;
+    b.fromPlayer = fromPlayer;
+    b.active = true;
+    b.velocity = kBulletSpeed * direction;
+    b.position = position;
+    bullets.push_back(b);
+}
+
+void StageSimulation::playerShoot() {
+    if (!playerAmmo.empty() && playerShootTimer >= ticksFor(kShootCooldownTime) && playerSprites.canChangeState() &&
+        !playerHitStunned && playerHealth > Fixed() && enemyHealth > Fixed()) {
+        playerAmmo.pop_back();
+        // NOTE: isFacingLeft() == true means the sprite is in its default
+        // (right-facing) orientation, so that direction fires to +x
+        const int dir = playerSprites.isFacingLeft() ? 1 : -1;
+        const FixedVec2 muzzle = gunTip(playerSprites, playerPosition, dir);
+        spawnBullet(true, muzzle, dir);
+        emit(GameEventType::Fired, 0, muzzle, dir);
+        playerSprites.changeState(SpriteState::Shot, ticksFor(kShootCooldownTime));
+        playerShootTimer = 0;
+    }
+}
+
+void StageSimulation::playerMelee() {
+    if (playerAttackTimer >= ticksFor(kAttackCooldownTime) && playerSprites.canChangeState() && !playerHitStunned &&
+        playerHealth > Fixed() && enemyHealth > Fixed()) {
+        playerSprites.changeState(SpriteState::Attack, ticksFor(kAttackCooldownTime));
+        // Melee lands if the swing's reach touches the enemy's body
+        const FixedRect reach = strikeReach(playerSprites, playerPosition);
+        const int dir = playerSprites.isFacingLeft() ? 1 : -1;
+        if (bodyOverlaps(enemySprites, enemyPosition, reach)) {
+            const Fixed damage = hurt(enemyHealth, 8);
+            enemyHitStunned = true;
+            enemyHitStunTimer = 0;
+            enemySprites.changeState(SpriteState::Hurt, ticksFor(kHitStunDuration));
+            emit(GameEventType::Melee, 0, reach.center(), dir, damage, true);
+        } else {
+            emit(GameEventType::Melee, 0, reach.center(), dir);
+        }
+        playerAttackTimer = 0;
+    }
+}
+
+// Scripted player for benchmark runs: close in, shoot from mid range, swing
+// up close, reload when dry and hop now and then
+void StageSimulation::runScriptedPlayer() {
+    if (waitingForStart || roundEnded || playerHealth <= Fixed() || enemyHealth <= Fixed() ||
+        scriptedDecisionTimer <= ticksFor(0.25f)) {
+        return;
+    }
+    scriptedDecisionTimer = 0;
+    ++scriptedDecisions;
+    const Fixed gap = enemyPosition.x - playerPosition.x;
+    movingLeft = false;
+    movingRight = false;
+    isRunning = false;
+    if (playerAmmo.empty()) {
+        reloadPlayer();
+    }
+    if (scriptedDecisions % 9 == 0) {
+        // Back off for a beat so the enemy AI has to chase
+        movingLeft = true;
+    } else if (gap > Fixed::fromInt(320)) {
+        movingRight = true;
+        isRunning = gap > Fixed::fromInt(480);
+    } else {
+        playerSprites.setFacingDirection(true);
+        if (gap < Fixed::fromInt(110)) {
+            playerMelee();
+        } else {
+            playerShoot();
+        }
+    }
+    if (scriptedDecisions % 7 == 0) {
+        playerJump();
+    }
+}
+
+void StageSimulation::step(InputBuffer& input) {
+    beginTick();
+    // Apply this tick's input in the order it arrived; the oldest event is
+    // what the latency measurement follows to the screen
+    input.drain(InputClock::now(), [&](const InputEvent& queued) {
+        applyInput(queued);
+        if (!oldestInput || queued.time < *oldestInput) {
+            oldestInput = queued.time;
+        }
+    });
+    finishTick();
+}
+
+void StageSimulation::step(const InputEvent* events, size_t count) {
+    beginTick();
+    for (size_t i = 0; i < count; ++i) {
+        applyInput(events[i]);
+    }
+    finishTick();
+}
+
+void StageSimulation::applySheetReload(const SheetReload& reload) {
+    for (auto* sprites : {&playerSprites, &enemySprites}) {
+        if (AnimatedSprite* animation = sprites->findBySource(reload.path)) {
+            animation->adoptSheet(*reload.texture, reload.tables, reload.cellWidth, reload.cellHeight);
+        }
+    }
+    // The flip pivot follows the walk cell's width, which may have changed
+    playerSprites.setPosition(playerPosition.toFloat());
+    enemySprites.setPosition(enemyPosition.toFloat());
+}
+
+vector<const AnimatedSprite*> StageSimulation::animations() const {
+    vector<const AnimatedSprite*> all;
+    for (const auto* sprites : {&playerSprites, &enemySprites}) {
+        const auto list = sprites->animations();
+        all.insert(all.end(), list.begin(), list.end());
+    }
+    return all;
+}
+
+void StageSimulation::beginTick() {
+    ++tick;
+    // Sheets swap at a tick boundary, never halfway through a hit test
+    sheetReloads.drain([&](const SheetReload& reload) { applySheetReload(reload); });
+    for (uint32_t* timer : {&stageTime, &enemyDecisionTimer, &enemyFireTimer, &enemyAttackTimer, &enemyReloadTimer,
+                            &playerAttackTimer, &playerShootTimer, &playerHitStunTimer, &enemyHitStunTimer,
+                            &roundEndTimer, &scriptedDecisionTimer}) {
+        ++*timer;
+    }
+
+    if (scriptedPlayer) {
+        runScriptedPlayer();
+    }
+    playerSprites.update();
+    enemySprites.update();
+}
+
+void StageSimulation::finishTick() {
+    if (waitingForStart || gameEnded) {
+        return;
+    }
+
+    // Update hit stun
+    if (playerHitStunned && playerHitStunTimer >= ticksFor(kHitStunDuration)) {
+        playerHitStunned = false;
+    }
+    if (enemyHitStunned && enemyHitStunTimer >= ticksFor(kHitStunDuration)) {
+        enemyHitStunned = false;
+    }
+
+    updatePlayer();
+    updateBulletsAndHits();
+    updateEnemy();
+    updateDeaths();
+    updateRounds();
+}
+
+void StageSimulation::updatePlayer() {
+    // Player movement (disabled during hit stun or when round ended)
+    const Fixed currentSpeed = isRunning ? kPlayerSpeed * Fixed::fromDouble(1.5) : kPlayerSpeed;
+    FixedVec2 playerMotion;
+    if (!playerHitStunned && !roundEnded && playerHealth > Fixed()) {
+        if (movingLeft) {
+            playerMotion.x -= currentSpeed * kSimulationStep;
+        }
+        if (movingRight) {
+            playerMotion.x += currentSpeed * kSimulationStep;
+        }
+    }
+    // Jump-over functionality: allow jumping over enemy if close and jumping
+    const Fixed distanceToEnemy = fixedAbs(enemyPosition.x - playerPosition.x);
+    const bool canJumpOver = distanceToEnemy < Fixed::fromInt(100) && playerJumping;
+
+    playerPosition += playerMotion;
+
+    if (playerHealth <= Fixed() || canJumpOver) {
+        // Dead players and jumps over the enemy may pass it
+        playerPosition.x = fixedClamp(playerPosition.x, Fixed::fromInt(40), arenaRight - Fixed::fromInt(60));
+    } else if (level) {
+        // A level is wider than a screen; the player may go anywhere short of the enemy
+        playerPosition.x = fixedClamp(playerPosition.x, Fixed::fromInt(40), enemyPosition.x - Fixed::fromInt(40));
+    } else {
+        // Normal boundary restriction
+        playerPosition.x = fixedClamp(playerPosition.x, Fixed::fromInt(40), Fixed::fromInt(kArenaWidth / 2 - 60));
+    }
+
+    // Sprites default to facing RIGHT (facingLeft=true), so flip when moving left.
+    // If not moving, keep the current facing direction.
+    if (movingLeft) {
+        playerSprites.setFacingDirection(false);
+    } else if (movingRight) {
+        playerSprites.setFacingDirection(true);
+    }
+
+    if (playerJumping) {
+        // Keep jump sprite while in air
+        if (playerSprites.currentState != SpriteState::Jump) {
+            playerSprites.changeState(SpriteState::Jump);
+        }
+        // Surfaces are one-way: only a falling fighter lands on one
+        const Fixed floor = floorFor(playerSprites, playerPosition);
+        playerVerticalVelocity += kGravity * kSimulationStep;
+        playerPosition.y += playerVerticalVelocity * kSimulationStep;
+        if (playerVerticalVelocity >= Fixed() && playerPosition.y >= floor) {
+            playerPosition.y = floor;
+            playerJumping = false;
+            playerVerticalVelocity = Fixed();
+            // Return to walk/run state after landing
+            if (isRunning && (movingLeft || movingRight)) {
+                playerSprites.changeState(SpriteState::Run);
+            } else {
+                playerSprites.changeState(SpriteState::Walk);
+            }
+        }
+    } else {
+        if (playerHealth <= Fixed()) {
+            // Dead character falls naturally
+            const Fixed floor = floorFor(playerSprites, playerPosition);
+            playerVerticalVelocity += kGravity * kSimulationStep;
+            playerPosition.y += playerVerticalVelocity * kSimulationStep;
+            if (playerPosition.y >= floor) {
+                playerPosition.y = floor;
+                playerVerticalVelocity = Fixed();
+            }
+        } else if (const Fixed floor = floorFor(playerSprites, playerPosition); floor > playerPosition.y) {
+            // Walked off a ledge: fall as if from a jump's peak
+            playerJumping = true;
+        } else {
+            // Alive and not jumping: on the ground
+            playerPosition.y = floor;
+            playerVerticalVelocity = Fixed();
+        }
+        // Update sprite state when not in a one-time animation
+        if (playerSprites.currentState != SpriteState::Jump &&
+            playerSprites.currentState != SpriteState::Shot &&
+            playerSprites.currentState != SpriteState::Attack &&
+            playerSprites.currentState != SpriteState::Hurt &&
+            playerSprites.currentState != SpriteState::Dead) {
+            if (playerHealth <= Fixed()) {
+                playerSprites.changeState(SpriteState::Dead);
+            } else if (isRunning && (movingLeft || movingRight) && !playerHitStunned) {
+                playerSprites.changeState(SpriteState::Run);
+            } else if ((movingLeft || movingRight) && !playerHitStunned) {
+                playerSprites.changeState(SpriteState::Walk);
+            } else if (!playerHitStunned) {
+                playerSprites.changeState(SpriteState::Idle);
+            }
+        }
+    }
+
+    // Alive and not jumping always means on the ground
+    if (!playerJumping && playerHealth > Fixed()) {
+        playerPosition.y = floorFor(playerSprites, playerPosition);
+        playerVerticalVelocity = Fixed();
+    }
+    playerSprites.setPosition(playerPosition.toFloat());
+}
+
+void StageSimulation::updateBulletsAndHits() {
+    updateBullets(bullets, kSimulationStep, arenaRight, [&](const Bullet& b) {
+        const FixedRect bulletBounds = bulletShape.boundsAt(b.position);
+        const int bulletDirection = b.velocity < Fixed() ? -1 : 1;
+
+        if (b.fromPlayer && enemyHealth > Fixed() && bodyOverlaps(enemySprites, enemyPosition, bulletBounds)) {
+            const Fixed damage = hurt(enemyHealth, 6);
+            enemyHitStunned = true;
+            enemyHitStunTimer = 0;
+            enemySprites.changeState(SpriteState::Hurt, ticksFor(kHitStunDuration));
+            emit(GameEventType::Hit, 0, bulletBounds.center(), bulletDirection, damage);
+            return true;
+        }
+        if (!b.fromPlayer && playerHealth > Fixed() && bodyOverlaps(playerSprites, playerPosition, bulletBounds)) {
+            const Fixed damage = hurt(playerHealth, 5);
+            playerHitStunned = true;
+            playerHitStunTimer = 0;
+            playerSprites.changeState(SpriteState::Hurt, ticksFor(kHitStunDuration));
+            emit(GameEventType::Hit, 1, bulletBounds.center(), bulletDirection, damage);
+            return true;
+        }
+        return false;
+    });
+}
+
+void StageSimulation::updateEnemy() {
+    // Enemy reload logic (with reload limit)
+    if (enemyAmmo <= 0 && !enemyIsReloading && enemyReloads > 0) {
+        enemyIsReloading = true;
+        enemyReloadTimer = 0;
+        note("Enemy reloading");
+    }
+    if (enemyIsReloading && enemyReloadTimer >= ticksFor(kEnemyReloadTime)) {
+        if (enemyReloads > 0) {
+            enemyAmmo = kMaxAmmo;
+            enemyReloads--;
+            emit(GameEventType::Reloaded, 1, enemyPosition);
+        }
+        enemyIsReloading = false;
+    }
+
+    // The trees see the fighters as they stand before this tick's movement
+    enemyAi.x[0] = enemyPosition.x;
+    enemyAi.y[0] = enemyPosition.y;
+    enemyAi.targetX[0] = playerPosition.x;
+    enemyAi.targetY[0] = playerPosition.y;
+    const bool canChangeState = enemySprites.canChangeState();
+    enemyAi.flags[0] = static_cast<uint8_t>(
+        (enemyJumping ? kAiAirborne : 0) | (enemyIsReloading ? kAiReloading : 0) |
+        (enemyAttackTimer >= ticksFor(kEnemyAttackCooldown) && canChangeState ? kAiMeleeReady : 0) |
+        (!enemyIsReloading && enemyAmmo > 0 && enemyFireTimer >= ticksFor(kEnemyFireCooldown) && canChangeState
+             ? kAiGunReady
+             : 0));
+    enemyAi.direction[0] = static_cast<int8_t>(enemyDirection);
+    enemyAi.running[0] = enemyIsRunning;
+    enemyAi.jump[0] = 0;
+    enemyAi.intent[0] = AiIntent::None;
+    gangster::attack(enemyAi);
+
+    if (enemyDecisionTimer > ticksFor(0.3f)) {
+        enemyDecisionTimer = 0;
+        gangster::decide(enemyAi);
+        enemyDirection = enemyAi.direction[0];
+        enemyIsRunning = enemyAi.running[0] != 0;
+        if (enemyAi.jump[0]) {
+            enemyJumping = true;
+            enemyVerticalVelocity = kJumpStrength * Fixed::fromDouble(0.85);
+            enemySprites.changeState(SpriteState::Jump);
+        }
+    }
+
+    // Enemy movement (disabled during hit stun, when round ended, or when dead)
+    const Fixed currentEnemySpeed = enemyIsRunning ? kEnemySpeed * Fixed::fromDouble(1.4) : kEnemySpeed;
+    if (!enemyHitStunned && !roundEnded && enemyHealth > Fixed() && playerHealth > Fixed()) {
+        enemyPosition.x += currentEnemySpeed * kSimulationStep * enemyDirection;
+    }
+    // While both are alive the enemy stays on the right of the player
+    const Fixed minEnemyX =
+        enemyHealth > Fixed() && playerHealth > Fixed() ? playerPosition.x + Fixed::fromInt(40) : Fixed::fromInt(40);
+    const Fixed maxEnemyX = arenaRight - Fixed::fromInt(120);
+    enemyPosition.x = fixedClamp(enemyPosition.x, minEnemyX, maxEnemyX);
+
+    if (enemyJumping) {
+        if (enemySprites.currentState != SpriteState::Jump) {
+            enemySprites.changeState(SpriteState::Jump);
+        }
+        const Fixed floor = floorFor(enemySprites, enemyPosition);
+        enemyVerticalVelocity += kGravity * kSimulationStep;
+        enemyPosition.y += enemyVerticalVelocity * kSimulationStep;
+        if (enemyVerticalVelocity >= Fixed() && enemyPosition.y >= floor) {
+            enemyPosition.y = floor;
+            enemyJumping = false;
+            enemyVerticalVelocity = Fixed();
+            if (enemyIsRunning && enemyDirection != 0) {
+                enemySprites.changeState(SpriteState::Run);
+            } else {
+                enemySprites.changeState(SpriteState::Walk);
+            }
+        }
+    } else {
+        const Fixed floor = floorFor(enemySprites, enemyPosition);
+        if (enemyHealth > Fixed() && floor > enemyPosition.y) {
+            // Walked off a ledge
+            enemyJumping = true;
+        } else if (enemyHealth > Fixed()) {
+            enemyPosition.y = floor;
+            enemyVerticalVelocity = Fixed();
+        } else {
+            // If dead, allow falling with gravity
+            enemyVerticalVelocity += kGravity * kSimulationStep;
+            enemyPosition.y += enemyVerticalVelocity * kSimulationStep;
+            if (enemyPosition.y >= floor) {
+                enemyPosition.y = floor;
+                enemyVerticalVelocity = Fixed();
+            }
+        }
+        if (enemySprites.currentState != SpriteState::Jump &&
+            enemySprites.currentState != SpriteState::Shot &&
+            enemySprites.currentState != SpriteState::Attack &&
+            enemySprites.currentState != SpriteState::Hurt &&
+            enemySprites.currentState != SpriteState::Dead) {
+            if (enemyHealth <= Fixed()) {
+                enemySprites.changeState(SpriteState::Dead);
+            } else if (enemyIsRunning && enemyDirection != 0 && !enemyHitStunned) {
+                enemySprites.changeState(SpriteState::Run);
+            } else if (enemyDirection != 0 && !enemyHitStunned) {
+                enemySprites.changeState(SpriteState::Walk);
+            } else if (!enemyHitStunned) {
+                enemySprites.changeState(SpriteState::Idle);
+            }
+        }
+    }
+
+    // Face the player: facingLeft=true is the default right-facing art
+    const bool enemyShouldFaceLeft = enemyPosition.x <= playerPosition.x;
+    enemySprites.setFacingDirection(enemyShouldFaceLeft);
+    if (!enemyJumping && enemyHealth > Fixed()) {
+        enemyPosition.y = floorFor(enemySprites, enemyPosition);
+        enemyVerticalVelocity = Fixed();
+    }
+    enemySprites.setPosition(enemyPosition.toFloat());
+
+    // The attack tree chose before moving; nobody attacks once someone is down
+    if (enemyJumping || enemyIsReloading || enemyHitStunned || playerHealth <= Fixed() || enemyHealth <= Fixed()) {
+        return;
+    }
+    if (enemyAi.intent[0] == AiIntent::Melee) {
+        enemySprites.changeState(SpriteState::Attack, ticksFor(kEnemyAttackCooldown));
+        const FixedRect reach = strikeReach(enemySprites, enemyPosition);
+        const int dir = playerPosition.x >= enemyPosition.x ? 1 : -1;
+        if (bodyOverlaps(playerSprites, playerPosition, reach)) {
+            const Fixed damage = hurt(playerHealth, 7);
+            playerHitStunned = true;
+            playerHitStunTimer = 0;
+            playerSprites.changeState(SpriteState::Hurt, ticksFor(kHitStunDuration));
+            emit(GameEventType::Melee, 1, reach.center(), dir, damage, true);
+        } else {
+            emit(GameEventType::Melee, 1, reach.center(), dir);
+        }
+        enemyAttackTimer = 0;
+    } else if (enemyAi.intent[0] == AiIntent::Shoot) {
+        --enemyAmmo;
+        const int dir = playerPosition.x >= enemyPosition.x ? 1 : -1;
+        const FixedVec2 muzzle = gunTip(enemySprites, enemyPosition, dir);
+        spawnBullet(false, muzzle, dir);
+        emit(GameEventType::Fired, 1, muzzle, dir);
+        enemySprites.changeState(SpriteState::Shot, ticksFor(kEnemyFireCooldown));
+        enemyFireTimer = 0;
+    }
+}
+
+void StageSimulation::updateDeaths() {
+    // Stop all movement for both fighters the moment either goes down
+    auto freezeFighters = [&]() {
+        movingLeft = false;
+        movingRight = false;
+        isRunning = false;
+        playerJumping = false;
+        enemyDirection = 0;
+        enemyIsRunning = false;
+        enemyJumping = false;
+    };
+    if (playerHealth <= Fixed() && playerSprites.currentState != SpriteState::Dead) {
+        const FixedVec2 body =
+            cellToWorld(playerSprites, playerPosition, playerSprites.getCurrentAnimation().cellHurtbox()).center();
+        playerSprites.changeState(SpriteState::Dead);
+        playerDeadAnimating = true;
+        playerSprites.dead.currentFrame = 0;
+        playerSprites.dead.frameTicks = 0;
+        freezeFighters();
+        playerVerticalVelocity = Fixed();
+        if (!playerDeathAnnounced) {
+            emit(GameEventType::Died, 0, body);
+            playerDeathAnnounced = true;
+        }
+    }
+    if (enemyHealth <= Fixed() && enemySprites.currentState != SpriteState::Dead) {
+        const FixedVec2 body =
+            cellToWorld(enemySprites, enemyPosition, enemySprites.getCurrentAnimation().cellHurtbox()).center();
+        enemySprites.changeState(SpriteState::Dead);
+        enemyDeadAnimating = true;
+        enemySprites.dead.currentFrame = 0;
+        enemySprites.dead.frameTicks = 0;
+        freezeFighters();
+        enemyVerticalVelocity = Fixed();
+        if (!enemyDeathAnnounced) {
+            emit(GameEventType::Died, 1, body);
+            enemyDeathAnnounced = true;
+        }
+    }
+
+    // Play the death strip once, then hold its last frame
+    for (auto [sprites, animating] : {pair{&playerSprites, &playerDeadAnimating},
+                                      pair{&enemySprites, &enemyDeadAnimating}}) {
+        AnimatedSprite& dead = sprites->dead;
+        if (!*animating || !dead.loaded()) continue;
+        if (++dead.frameTicks >= kFrameTicks) {
+            dead.frameTicks = 0;
+            if (dead.currentFrame < dead.frameCount - 1) {
+                dead.applyFrame(dead.currentFrame + 1);
+            } else {
+                *animating = false;
+            }
+        }
+    }
+}
+
+void StageSimulation::updateRounds() {
+    const int timeLeft = max(0, kStageDurationSeconds - static_cast<int>(stageTime / kSimulationRate));
+    const bool playerWon = enemyHealth <= Fixed();
+    const bool playerLost = playerHealth <= Fixed() || (timeLeft == 0 && !playerWon);
+
+    // End the round the moment someone goes down; the win is only checked
+    // after the death animation has had its time on screen
+    if (playerWon && !winNoted) {
+        playerWins++;
+        emit(GameEventType::RoundEnded, 0, FixedVec2());
+        winNoted = true;
+        roundEnded = true;
+        roundEndTimer = 0;
+        playerHitStunned = false;
+        enemyHitStunned = false;
+    } else if (playerLost && !defeatNoted) {
+        enemyWins++;
+        emit(GameEventType::RoundEnded, 1, FixedVec2());
+        defeatNoted = true;
+        roundEnded = true;
+        roundEndTimer = 0;
+        playerHitStunned = false;
+        enemyHitStunned = false;
+    }
+    if (!roundEnded) {
+        return;
+    }
+    movingLeft = false;
+    movingRight = false;
+    isRunning = false;
+
+    if (roundEndTimer < ticksFor(kRoundEndDisplayTime)) {
+        return;
+    }
+    roundEnded = false;
+    currentRound++;
+    if (playerWins >= 2 || enemyWins >= 2 || currentRound > kMaxRounds) {
+        gameEnded = true;
+        return;
+    }
+
+    // Reset for next round
+    playerHealth = kFullHealth;
+    enemyHealth = kFullHealth;
+    winNoted = false;
+    defeatNoted = false;
+    playerHitStunned = false;
+    enemyHitStunned = false;
+    playerJumping = false;
+    enemyJumping = false;
+    placeFighters();
+    playerSprites.changeState(SpriteState::Walk);
+    enemySprites.changeState(SpriteState::Walk);
+    // Bullets still flying from the last round go with its memory
+    resetRoundMemory();
+    playerReloads = 2;
+    reloadPlayer(true);  // Initial reload for new round (doesn't count)
+    enemyReloads = 2;
+    enemyAmmo = kMaxAmmo;
+    stageTime = 0;
+    playerDeathAnnounced = false;
+    enemyDeathAnnounced = false;
+}
+
+void StageSimulation::writeSnapshot(StageSnapshot& snapshot, bool olderSkipped) {
+    snapshot.tick = tick;
+    snapshot.waitingForStart = waitingForStart;
+    snapshot.matchOver = gameEnded;
+    snapshot.player = viewOf(playerSprites);
+    snapshot.enemy = viewOf(enemySprites);
+    // clear() keeps the slot's capacity, so steady state doesn't allocate
+    snapshot.bullets.clear();
+    for (const auto& b : bullets) {
+        if (b.active) {
+            snapshot.bullets.push_back(b.position.toFloat());
+        }
+    }
+    snapshot.playerHealth = playerHealth.toFloat();
+    snapshot.enemyHealth = enemyHealth.toFloat();
+    snapshot.playerAmmo = static_cast<int>(playerAmmo.size());
+    snapshot.playerReloads = playerReloads;
+    snapshot.enemyAmmo = enemyAmmo;
+    snapshot.enemyReloads = enemyReloads;
+    snapshot.timeLeft = waitingForStart ? kStageDurationSeconds
+                                        : max(0, kStageDurationSeconds - static_cast<int>(stageTime / kSimulationRate));
+    snapshot.playerWins = playerWins;
+    snapshot.enemyWins = enemyWins;
+    snapshot.lastAction = lastAction ? *lastAction : nullptr;
+    // The reader has seen either the previous snapshot or none since the last
+    // one known to be read; each frame reports whichever inputs it first shows
+    if (!olderSkipped) {
+        unseenInput.reset();
+    }
+    snapshot.oldestInput = oldestInput;
+    snapshot.earlierInput = earliest(unseenInput, previousTickInput);
+    unseenInput = snapshot.earlierInput;
+    previousTickInput = oldestInput;
+    oldestInput.reset();
+}
+
+optional<InputClock::time_point> StageSnapshot::firstShownInput(uint64_t previousTick) const {
+    return previousTick + 1 == tick ? oldestInput : earliest(earlierInput, oldestInput);
+}
+
+void StageSimulation::writeSpectatorState(SpectatorState& state) const {
+    auto quantize = [](Fixed value) { return (value * kSpectatorPositionScale).floorToInt(); };
+    state.tick = tick;
+    state[SpectatorField::PlayerX] = quantize(playerPosition.x);
+    state[SpectatorField::PlayerY] = quantize(playerPosition.y);
+    state[SpectatorField::PlayerState] = static_cast<int32_t>(playerSprites.currentState);
+    state[SpectatorField::PlayerFrame] = playerSprites.getCurrentAnimation().currentFrame;
+    state[SpectatorField::PlayerFacingLeft] = playerSprites.isFacingLeft() ? 1 : 0;
+    state[SpectatorField::PlayerHealth] = playerHealth.ceilToInt();
+    state[SpectatorField::PlayerAmmo] = static_cast<int32_t>(playerAmmo.size());
+    state[SpectatorField::PlayerReloads] = playerReloads;
+    state[SpectatorField::PlayerWins] = playerWins;
+    state[SpectatorField::EnemyX] = quantize(enemyPosition.x);
+    state[SpectatorField::EnemyY] = quantize(enemyPosition.y);
+    state[SpectatorField::EnemyState] = static_cast<int32_t>(enemySprites.currentState);
+    state[SpectatorField::EnemyFrame] = enemySprites.getCurrentAnimation().currentFrame;
+    state[SpectatorField::EnemyFacingLeft] = enemySprites.isFacingLeft() ? 1 : 0;
+    state[SpectatorField::EnemyHealth] = enemyHealth.ceilToInt();
+    state[SpectatorField::EnemyAmmo] = enemyAmmo;
+    state[SpectatorField::EnemyReloads] = enemyReloads;
+    state[SpectatorField::EnemyWins] = enemyWins;
+    state[SpectatorField::TimeLeft] =
+        waitingForStart ? kStageDurationSeconds
+                        : max(0, kStageDurationSeconds - static_cast<int>(stageTime / kSimulationRate));
+    state[SpectatorField::Flags] = (waitingForStart ? kSpectatorWaitingForStart : 0) |
+                                   (gameEnded ? kSpectatorMatchOver : 0) |
+                                   (playerIsGangster1 ? kSpectatorPlayerIsGangster1 : 0);
+    state.bulletCount = 0;
+    for (const auto& b : bullets) {
+        if (!b.active || state.bulletCount == kMaxSpectatorBullets) continue;
+        state.bullets[state.bulletCount++] = {quantize(b.position.x), quantize(b.position.y), b.fromPlayer};
+    }
+}
+
+uint64_t StageSimulation::stateHash() const {
+    StateHasher hash;
+    hash.add(static_cast<int64_t>(tick));
+    hash.add(playerPosition);
+    hash.add(enemyPosition);
+    hash.add(playerVerticalVelocity);
+    hash.add(enemyVerticalVelocity);
+    hash.add(playerHealth);
+    hash.add(enemyHealth);
+    for (int value : {static_cast<int>(playerAmmo.size()), playerReloads, enemyAmmo, enemyReloads, enemyDirection,
+                      scriptedDecisions, currentRound, playerWins, enemyWins}) {
+        hash.add(static_cast<int64_t>(value));
+    }
+    for (bool flag : {waitingForStart, movingLeft, movingRight, isRunning, playerJumping, enemyJumping,
+                      enemyIsReloading, enemyIsRunning, winNoted, defeatNoted, roundEnded, gameEnded,
+                      playerHitStunned, enemyHitStunned, playerDeadAnimating, enemyDeadAnimating}) {
+        hash.add(static_cast<int64_t>(flag));
+    }
+    for (uint32_t timer : {stageTime, enemyDecisionTimer, enemyFireTimer, enemyAttackTimer, enemyReloadTimer,
+                           playerAttackTimer, playerShootTimer, playerHitStunTimer, enemyHitStunTimer, roundEndTimer,
+                           scriptedDecisionTimer}) {
+        hash.add(static_cast<int64_t>(timer));
+    }
+    for (const auto* sprites : {&playerSprites, &enemySprites}) {
+        hash.add(static_cast<int64_t>(sprites->currentState));
+        hash.add(static_cast<int64_t>(sprites->isFacingLeft()));
+        hash.add(static_cast<int64_t>(sprites->getCurrentAnimation().currentFrame));
+    }
+    hash.add(static_cast<int64_t>(bullets.size()));
+    for (const auto& b : bullets) {
+        hash.add(b.position);
+        hash.add(b.velocity);
+        hash.add(static_cast<int64_t>(b.fromPlayer));
+    }
+    return hash.value;
+}
@@ -0,0 +1,257 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <array>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "Arena.hpp"
+#include "BulletSystem.hpp"
+#include "CharacterSprites.hpp"
+#include "EnemyAi.hpp"
+#include "FixedPoint.hpp"
+#include "GameEvents.hpp"
+#include "InputBuffer.hpp"
+#include "ResourceTracker.hpp"
+#include "SpectatorStream.hpp"
+#include "SpscQueue.hpp"
+#include "Tilemap.hpp"
+
+constexpr int kArenaWidth = 960;
+constexpr int kGroundY = 300;
+constexpr int kStageDurationSeconds = 60;
+// Room for a round's bullets and ammo; a busy round only adds a block
+constexpr size_t kRoundArenaBytes = 16 * 1024;
+constexpr int kMaxAmmo = 5;
+// Fixed simulation rate, independent of how fast frames are presented
+constexpr int kSimulationRate = 120;
+constexpr Fixed kSimulationStep = Fixed::ratio(1, kSimulationRate);
+// The same step in seconds, for pacing the threads that run it
+constexpr float kSimulationStepSeconds = 1.f / kSimulationRate;
+
+// What the renderer needs to draw one fighter, copied out of its sprite
+struct FighterView {
+    const sf::Texture* texture = nullptr;
+    const sf::Texture* palette = nullptr;  // set when `texture` holds palette indices
+    sf::IntRect textureRect;
+    sf::Transform transform;
+};
+
+// A sheet the main thread reloaded from disk; the simulation swaps it in
+// between ticks. The main thread keeps `texture` alive for the stage.
+struct SheetReload {
+    string path;
+    const sf::Texture* texture = nullptr;
+    shared_ptr<const SheetTables> tables;
+    int cellWidth = 0;
+    int cellHeight = 0;
+};
+
+// Running totals for the match results log, kept from the simulation's own
+// events so a full event queue never loses a count. Index 0 is the player,
+// 1 the enemy. Not part of stateHash(): nothing in the fight reads them.
+struct MatchStats {
+    array<int, 2> shots{};
+    array<int, 2> bulletHits{};
+    array<int, 2> meleeHits{};
+    array<Fixed, 2> damage{};     // health actually taken off the other side
+    int rounds = 0;
+    array<uint32_t, 3> roundTicks{};  // length of each finished round
+
+    void record(const GameEvent& event);
+};
+
+// Immutable picture of the stage after one simulation tick
+struct StageSnapshot {
+    uint64_t tick = 0;
+    bool waitingForStart = true;
+    bool matchOver = false;
+    FighterView player;
+    FighterView enemy;
+    vector<sf::Vector2f> bullets;  // positions; every bullet shares scale and origin
+    float playerHealth = 100.f;
+    float enemyHealth = 100.f;
+    int playerAmmo = 0;
+    int playerReloads = 0;
+    int enemyAmmo = 0;
+    int enemyReloads = 0;
+    int timeLeft = kStageDurationSeconds;
+    int playerWins = 0;
+    int enemyWins = 0;
+    const char* lastAction = nullptr;  // a literal
+    // Oldest input applied on this tick, for latency tracking
+    optional<InputClock::time_point> oldestInput;
+    // Oldest input from earlier ticks whose snapshots the reader may not have
+    // seen: the triple buffer drops any it doesn't pick up in time
+    optional<InputClock::time_point> earlierInput;
+
+    // The oldest input this snapshot is the first to show, given the tick of
+    // the snapshot read before it
+    optional<InputClock::time_point> firstShownInput(uint64_t previousTick) const;
+};
+
+// All gameplay state of a stage: fighters, bullets, AI, rounds. It never
+// touches the window or plays audio; what happens goes out as GameEvents and
+// the picture goes out as snapshots, so it can run on its own thread.
+//
+// Positions, velocities, health and hit tests are fixed point and timers
+// count ticks, so the same inputs give the same state on every machine;
+// stateHash() is how that gets checked.
+class StageSimulation {
+public:
+    // Notes each action in `lastAction`, for the HUD
+    StageSimulation(const char*& lastAction, bool scriptedPlayer);
+    // Notes no actions
+    explicit StageSimulation(bool scriptedPlayer);
+
+    // Loads sheets and the bullet on the calling thread, which needs a GL context
+    bool load(bool playerIsGangster1, ResourceScope& resources);
+    // Headless setup: shares hit tables loaded once with loadAll(..., false)
+    // and loadBulletShape(). Nothing can be drawn, everything else runs.
+    void loadShared(bool playerIsGangster1, const CharacterSpriteManager& gangster1,
+                    const CharacterSpriteManager& gangster3, const BulletShape& bulletShape);
+
+    // Starts a new match with the same fighters, sheets and level, reusing
+    // every buffer, so it never allocates. Events still queued stay queued.
+    void restartMatch();
+
+    // Fights on `layout` instead of the single-screen arena. Call after
+    // loading; fighters move to the level's spawns.
+    void setLevel(const LevelLayout& layout);
+
+    // Advances one kSimulationStep
+    void step(InputBuffer& input);
+    // The same with this tick's input handed over directly
+    void step(const InputEvent* events, size_t count);
+    // `olderSkipped` says whether the reader never saw the snapshot before
+    // the last one written (TripleBuffer::writeBufferSkipped())
+    void writeSnapshot(StageSnapshot& snapshot, bool olderSkipped);
+    void writeSpectatorState(SpectatorState& state) const;
+    // FNV-1a over every piece of gameplay state
+    uint64_t stateHash() const;
+
+    // Called from the main thread; false if too many reloads are queued
+    bool reloadSheet(const SheetReload& reload) { return sheetReloads.push(reload); }
+    // Every sheet path this stage draws from, for the asset watcher
+    vector<const AnimatedSprite*> animations() const;
+
+    bool matchOver() const { return gameEnded; }
+    // Stable once matchOver(); read it after the simulation thread has stopped
+    const MatchStats& matchStats() const { return stats; }
+    const sf::Texture& bulletTexture() const { return bullet; }
+    const sf::Vector2f& bulletOrigin() const { return bulletAnchor; }
+    // Drained once a frame by a GameEventDispatcher on the draw thread
+    GameEventQueue& gameEvents() { return events; }
+
+private:
+    void beginTick();
+    void applySheetReload(const SheetReload& reload);
+    void finishTick();
+    void applyInput(const InputEvent& input);
+    void startMatch();
+    void runScriptedPlayer();
+    void reloadPlayer(bool isInitialLoad = false);
+    void playerJump();
+    void playerShoot();
+    void playerMelee();
+    void updatePlayer();
+    void updateBulletsAndHits();
+    void updateEnemy();
+    void updateDeaths();
+    void updateRounds();
+    void spawnBullet(bool fromPlayer, const FixedVec2& position, int direction);
+    FixedVec2 gunTip(const CharacterSpriteManager& sprites, const FixedVec2& feet, int direction) const;
+    // Counts the event, notes it as the last action and queues it
+    void emit(GameEventType type, int fighter, const FixedVec2& position, int direction = 0, Fixed damage = Fixed(),
+              bool landed = false);
+    void note(const char* action);
+    void placeFighters();
+    // Where a fighter's position.y rests: the arena ground, or the level
+    // surface under its feet
+    Fixed floorFor(const CharacterSpriteManager& sprites, const FixedVec2& position) const;
+    // Returns the health actually taken
+    Fixed hurt(Fixed& health, int amount);
+    // Empties the round's containers and rewinds the arena they live in
+    void resetRoundMemory();
+
+    const char** lastAction = nullptr;
+    const bool scriptedPlayer;
+    bool playerIsGangster1 = true;
+    optional<LevelLayout> level;
+    Fixed arenaRight = Fixed::fromInt(kArenaWidth);
+
+    CharacterSpriteManager playerSprites;
+    CharacterSpriteManager enemySprites;
+    sf::Texture bullet;
+    sf::Vector2f bulletAnchor;
+    BulletShape bulletShape;
+    // Round-scoped: declared before the containers in it, so it outlives them
+    MonotonicArena roundArena{kRoundArenaBytes};
+    pmr::vector<Bullet> bullets{&roundArena};
+    GameEventQueue events;
+    SpscQueue<SheetReload, 16> sheetReloads;
+
+    FixedVec2 playerPosition{Fixed::fromInt(120), Fixed::fromInt(kGroundY)};
+    FixedVec2 enemyPosition{Fixed::fromInt(kArenaWidth - 250), Fixed::fromInt(kGroundY)};
+    Fixed playerHealth = Fixed::fromInt(100);
+    Fixed enemyHealth = Fixed::fromInt(100);
+    pmr::vector<int> playerAmmo{&roundArena};  // one entry per round in the magazine
+    int playerReloads = 2;
+    int enemyAmmo = kMaxAmmo;
+    int enemyReloads = 2;
+
+    bool waitingForStart = true;
+    bool movingLeft = false;
+    bool movingRight = false;
+    bool isRunning = false;
+    bool playerJumping = false;
+    bool enemyJumping = false;
+    Fixed playerVerticalVelocity;
+    Fixed enemyVerticalVelocity;
+    bool enemyIsReloading = false;
+    bool enemyIsRunning = false;
+    int enemyDirection = -1;
+    // The enemy as the only agent of a batch, sized once
+    AiAgents enemyAi;
+
+    // Ticks since each event (they were sf::Clocks when the stage ran on the
+    // wall clock, then float seconds)
+    uint32_t stageTime = 0;
+    uint32_t enemyDecisionTimer = 0;
+    uint32_t enemyFireTimer = 0;
+    uint32_t enemyAttackTimer = 0;
+    uint32_t enemyReloadTimer = 0;
+    uint32_t playerAttackTimer = 0;
+    uint32_t playerShootTimer = 0;
+    uint32_t playerHitStunTimer = 0;
+    uint32_t enemyHitStunTimer = 0;
+    uint32_t roundEndTimer = 0;
+    uint32_t scriptedDecisionTimer = 0;
+    int scriptedDecisions = 0;
+
+    bool winNoted = false;
+    bool defeatNoted = false;
+    int currentRound = 1;
+    int playerWins = 0;
+    int enemyWins = 0;
+    bool roundEnded = false;
+    bool gameEnded = false;
+    bool playerHitStunned = false;
+    bool enemyHitStunned = false;
+    bool playerDeathAnnounced = false;
+    bool enemyDeathAnnounced = false;
+    bool playerDeadAnimating = false;
+    bool enemyDeadAnimating = false;
+
+    uint64_t tick = 0;
+    // Oldest input of this tick, of the previous one, and of the ticks before
+    // that the reader is not known to have seen
+    optional<InputClock::time_point> oldestInput;
+    optional<InputClock::time_point> previousTickInput;
+    optional<InputClock::time_point> unseenInput;
+    MatchStats stats;
+};
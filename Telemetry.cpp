@@ -0,0 +1,218 @@
+#include "Telemetry.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+using namespace std;
+
+#include "SessionTrace.hpp"
+
+namespace {
+const char* const kFighterNames[] = {"player", "enemy"};
+
+struct CounterInfo {
+    const char* name;
+    const char* help;
+};
+
+constexpr CounterInfo kFighterCounters[kFighterCounterCount] = {
+    {"chavacano_shots_fired_total", "Shots fired"},
+    {"chavacano_bullet_hits_total", "Bullets that hit the other fighter"},
+    {"chavacano_melee_swings_total", "Melee swings, landed or not"},
+    {"chavacano_melee_hits_total", "Melee swings that landed"},
+    {"chavacano_reloads_total", "Magazines reloaded"},
+};
+
+uint64_t toMicros(float seconds) {
+    return static_cast<uint64_t>(max(0.f, seconds) * 1e6f + 0.5f);
+}
+
+// Exact to the microsecond however long the kiosk has been up, where a
+// double printed at the stream's default precision would lose digits
+void writeSeconds(ostream& out, uint64_t micros) {
+    out << micros / 1000000 << '.' << setw(6) << setfill('0') << micros % 1000000 << setfill(' ');
+}
+}
+
+struct Telemetry::Totals {
+    array<uint64_t, kFighterCounterCount * 2> fighters{};
+    uint64_t rounds = 0;
+    uint64_t roundMicros = 0;
+    array<uint64_t, kFrameBucketSeconds.size() + 1> frameBuckets{};
+    uint64_t frameMicros = 0;
+    uint64_t hitches = 0;
+};
+
+Telemetry& Telemetry::instance() {
+    static Telemetry telemetry;
+    return telemetry;
+}
+
+bool Telemetry::start(const string& path) {
+    // Fail now rather than at the first flush
+    if (!ofstream(path)) {
+        cerr << "Warning: could not open telemetry file " << path << '\n';
+        return false;
+    }
+    outputPath = path;
+    running.store(true, memory_order_relaxed);
+    flusher = thread([this] { run(); });
+    return true;
+}
+
+void Telemetry::stop() {
+    if (!running.exchange(false, memory_order_relaxed)) {
+        return;
+    }
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    flusher.join();
+    flush();
+}
+
+Telemetry::Block& Telemetry::blockForThisThread() {
+    // Owned by `blocks`, so a thread's counts outlive the thread
+    thread_local Block* current = nullptr;
+    if (current == nullptr) {
+        auto block = make_unique<Block>();
+        lock_guard<mutex> guard(lock);
+        current = block.get();
+        blocks.push_back(move(block));
+    }
+    return *current;
+}
+
+void Telemetry::count(FighterCounter counter, uint8_t fighter, uint64_t amount) {
+    if (!active()) {
+        return;
+    }
+    const size_t index = static_cast<size_t>(counter) * 2 + min<uint8_t>(fighter, 1);
+    blockForThisThread().fighters[index].fetch_add(amount, memory_order_relaxed);
+}
+
+void Telemetry::countRound(float seconds) {
+    if (!active()) {
+        return;
+    }
+    Block& block = blockForThisThread();
+    block.rounds.fetch_add(1, memory_order_relaxed);
+    block.roundMicros.fetch_add(toMicros(seconds), memory_order_relaxed);
+}
+
+void Telemetry::countFrame(float seconds) {
+    if (!active()) {
+        return;
+    }
+    Block& block = blockForThisThread();
+    const size_t bucket = static_cast<size_t>(
+        lower_bound(kFrameBucketSeconds.begin(), kFrameBucketSeconds.end(), seconds) - kFrameBucketSeconds.begin());
+    block.frameBuckets[bucket].fetch_add(1, memory_order_relaxed);
+    block.frameMicros.fetch_add(toMicros(seconds), memory_order_relaxed);
+    if (seconds > kHitchSeconds) {
+        block.hitches.fetch_add(1, memory_order_relaxed);
+    }
+}
+
+Telemetry::Totals Telemetry::sum() {
+    Totals totals;
+    lock_guard<mutex> guard(lock);
+    for (const auto& block : blocks) {
+        for (size_t i = 0; i < totals.fighters.size(); ++i) {
+            totals.fighters[i] += block->fighters[i].load(memory_order_relaxed);
+        }
+        totals.rounds += block->rounds.load(memory_order_relaxed);
+        totals.roundMicros += block->roundMicros.load(memory_order_relaxed);
+        for (size_t i = 0; i < totals.frameBuckets.size(); ++i) {
+            totals.frameBuckets[i] += block->frameBuckets[i].load(memory_order_relaxed);
+        }
+        totals.frameMicros += block->frameMicros.load(memory_order_relaxed);
+        totals.hitches += block->hitches.load(memory_order_relaxed);
+    }
+    return totals;
+}
+
+void Telemetry::write(ostream& out) {
+    const Totals totals = sum();
+    for (size_t counter = 0; counter < kFighterCounterCount; ++counter) {
+        const CounterInfo& info = kFighterCounters[counter];
+        out << "# HELP " << info.name << ' ' << info.help << '\n';
+        out << "# TYPE " << info.name << " counter\n";
+        for (size_t fighter = 0; fighter < 2; ++fighter) {
+            out << info.name << "{fighter=\"" << kFighterNames[fighter] << "\"} "
+                << totals.fighters[counter * 2 + fighter] << '\n';
+        }
+    }
+
+    out << "# HELP chavacano_round_seconds How long rounds lasted\n";
+    out << "# TYPE chavacano_round_seconds summary\n";
+    out << "chavacano_round_seconds_sum ";
+    writeSeconds(out, totals.roundMicros);
+    out << '\n';
+    out << "chavacano_round_seconds_count " << totals.rounds << '\n';
+
+    // Prometheus buckets are cumulative: each counts every frame up to its bound
+    out << "# HELP chavacano_frame_seconds Time from one stage frame to the next\n";
+    out << "# TYPE chavacano_frame_seconds histogram\n";
+    uint64_t frames = 0;
+    for (size_t bucket = 0; bucket < totals.frameBuckets.size(); ++bucket) {
+        frames += totals.frameBuckets[bucket];
+        out << "chavacano_frame_seconds_bucket{le=\"";
+        if (bucket < kFrameBucketSeconds.size()) {
+            out << kFrameBucketSeconds[bucket];
+        } else {
+            out << "+Inf";
+        }
+        out << "\"} " << frames << '\n';
+    }
+    out << "chavacano_frame_seconds_sum ";
+    writeSeconds(out, totals.frameMicros);
+    out << '\n';
+    out << "chavacano_frame_seconds_count " << frames << '\n';
+
+    out << "# HELP chavacano_hitches_total Stage frames longer than " << kHitchSeconds << " s\n";
+    out << "# TYPE chavacano_hitches_total counter\n";
+    out << "chavacano_hitches_total " << totals.hitches << '\n';
+}
+
+bool Telemetry::flush() {
+    // Written aside and renamed over the old file, so a scraper never reads
+    // half of one
+    const string temporary = outputPath + ".tmp";
+    {
+        ofstream out(temporary);
+        if (out) {
+            write(out);
+        }
+        if (!out) {
+            if (!flushWarned) {
+                cerr << "Warning: could not write telemetry file " << temporary << '\n';
+                flushWarned = true;
+            }
+            return false;
+        }
+    }
+    error_code error;
+    filesystem::rename(temporary, outputPath, error);
+    if (error && !flushWarned) {
+        cerr << "Warning: could not replace telemetry file " << outputPath << ": " << error.message() << '\n';
+        flushWarned = true;
+    }
+    return !error;
+}
+
+void Telemetry::run() {
+    SessionTrace::instance().nameThread("telemetry");
+    unique_lock<mutex> guard(lock);
+    while (!stopping) {
+        guard.unlock();
+        flush();
+        guard.lock();
+        wake.wait_for(guard, kTelemetryFlushInterval, [this] { return stopping; });
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Counted separately for the player (fighter 0) and the enemy (fighter 1)
+enum class FighterCounter : uint8_t {
+    ShotsFired,
+    BulletHits,
+    MeleeSwings,
+    MeleeHits,
+    Reloads,
+    Count
+};
+
+constexpr size_t kFighterCounterCount = static_cast<size_t>(FighterCounter::Count);
+// Upper bounds of the frame-time histogram buckets; a last bucket takes the rest
+constexpr array<float, 6> kFrameBucketSeconds{1.f / 120.f, 1.f / 60.f, 1.f / 30.f, 0.05f, 0.1f, 0.25f};
+// A frame that took longer than this is a hitch
+constexpr float kHitchSeconds = 0.05f;
+constexpr chrono::seconds kTelemetryFlushInterval(10);
+
+// Live gameplay counters behind --telemetry, for kiosks. Each thread counts
+// into its own block with relaxed atomics, so counting is an uncontended add
+// and before start() it only checks a flag. A background thread sums the
+// blocks and rewrites a Prometheus text-format file every
+// kTelemetryFlushInterval, for node_exporter's textfile collector or any
+// scraper that reads files.
+class Telemetry {
+public:
+    static Telemetry& instance();
+    ~Telemetry() { stop(); }
+
+    bool start(const string& path);
+    // Writes the file a last time and stops the flusher
+    void stop();
+    bool active() const { return running.load(memory_order_relaxed); }
+
+    void count(FighterCounter counter, uint8_t fighter, uint64_t amount = 1);
+    void countRound(float seconds);
+    void countFrame(float seconds);
+
+    // Every counter so far in Prometheus text format
+    void write(ostream& out);
+
+private:
+    // Only its own thread adds; the flusher reads
+    struct Block {
+        array<atomic<uint64_t>, kFighterCounterCount * 2> fighters{};
+        atomic<uint64_t> rounds{0};
+        atomic<uint64_t> roundMicros{0};
+        array<atomic<uint64_t>, kFrameBucketSeconds.size() + 1> frameBuckets{};
+        atomic<uint64_t> frameMicros{0};
+        atomic<uint64_t> hitches{0};
+    };
+    struct Totals;
+
+    Block& blockForThisThread();
+    Totals sum();
+    bool flush();
+    void run();
+
+    atomic<bool> running{false};
+    string outputPath;
+    mutex lock;  // guards `blocks` and `stopping`, never taken per count
+    vector<unique_ptr<Block>> blocks;
+    condition_variable wake;
+    bool stopping = false;
+    thread flusher;
+    bool flushWarned = false;  // flusher only
+};
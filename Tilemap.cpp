@@ -0,0 +1,371 @@
+#include "Tilemap.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include "SessionTrace.hpp"
+
+using namespace std;
+
+namespace {
+struct LevelFileHeader {
+    char magic[4] = {'E', 'C', 'L', 'V'};
+    uint16_t version = 1;
+    uint16_t chunkTiles = kChunkTiles;
+    uint32_t widthTiles = 0;
+    uint32_t heightTiles = 0;
+    uint16_t playerSpawn[2] = {};  // column, row
+    uint16_t enemySpawn[2] = {};
+};
+static_assert(sizeof(LevelFileHeader) == 24, "LevelFileHeader is an on-disk format");
+
+constexpr size_t kChunkBytes = kChunkTiles * kChunkTiles;
+// How long the loader sleeps when nothing is requested
+constexpr auto kLoaderIdle = chrono::milliseconds(2);
+
+// Tile colors; there is no tileset art yet
+const sf::Color kGroundFill(58, 44, 36);
+const sf::Color kGroundTop(104, 84, 56);
+const sf::Color kPlatformFill(92, 64, 40);
+const sf::Color kPlatformTop(150, 112, 70);
+constexpr float kGroundTopHeight = 6.f;
+constexpr float kPlatformHeight = 12.f;
+constexpr float kPlatformTopHeight = 3.f;
+
+bool isSolid(uint8_t tile) {
+    return tile == static_cast<uint8_t>(Tile::Ground) || tile == static_cast<uint8_t>(Tile::Platform);
+}
+
+bool readHeader(FILE* file, LevelFileHeader& header) {
+    const LevelFileHeader expected;
+    return fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, expected.magic, 4) == 0 &&
+           header.version == expected.version && header.chunkTiles == kChunkTiles && header.widthTiles > 0 &&
+           header.heightTiles > 0 && header.widthTiles <= kMaxLevelTiles && header.heightTiles <= kMaxLevelTiles;
+}
+
+int chunksFor(uint32_t tiles) {
+    return static_cast<int>((tiles + kChunkTiles - 1) / kChunkTiles);
+}
+
+FixedVec2 spawnPoint(const uint16_t (&tile)[2]) {
+    return {Fixed::fromInt(tile[0] * kTileSize + kTileSize / 2), Fixed::fromInt((tile[1] + 1) * kTileSize)};
+}
+
+void addQuad(vector<sf::Vertex>& mesh, const sf::FloatRect& rect, sf::Color color) {
+    const sf::Vector2f a = rect.position;
+    const sf::Vector2f b{rect.position.x + rect.size.x, rect.position.y};
+    const sf::Vector2f c = rect.position + rect.size;
+    const sf::Vector2f d{rect.position.x, rect.position.y + rect.size.y};
+    for (const sf::Vector2f& corner : {a, b, c, a, c, d}) {
+        mesh.push_back(sf::Vertex{corner, color, {}});
+    }
+}
+}
+
+Fixed LevelLayout::surfaceBelow(Fixed x, Fixed y) const {
+    const int column = clamp((x / Fixed::fromInt(kTileSize)).floorToInt(), 0, widthTiles - 1);
+    for (uint32_t i = columnStarts[static_cast<size_t>(column)]; i < columnStarts[static_cast<size_t>(column) + 1];
+         ++i) {
+        const Fixed top = Fixed::fromInt(surfaceRows[i] * kTileSize);
+        if (top >= y) {
+            return top;
+        }
+    }
+    return height();
+}
+
+bool bakeLevel(const string& textPath, const string& mapPath) {
+    ifstream in(textPath);
+    if (!in) {
+        cerr << "Warning: could not open level " << textPath << '\n';
+        return false;
+    }
+    vector<string> rows;
+    LevelFileHeader header;
+    bool playerPlaced = false;
+    bool enemyPlaced = false;
+    for (string line; getline(in, line);) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        for (size_t column = 0; column < line.size(); ++column) {
+            const uint16_t at[2] = {static_cast<uint16_t>(column), static_cast<uint16_t>(rows.size())};
+            if (line[column] == 'P') {
+                memcpy(header.playerSpawn, at, sizeof(at));
+                playerPlaced = true;
+            } else if (line[column] == 'E') {
+                memcpy(header.enemySpawn, at, sizeof(at));
+                enemyPlaced = true;
+            }
+        }
+        header.widthTiles = max(header.widthTiles, static_cast<uint32_t>(line.size()));
+        rows.push_back(move(line));
+    }
+    header.heightTiles = static_cast<uint32_t>(rows.size());
+    if (header.widthTiles == 0 || header.widthTiles > kMaxLevelTiles || header.heightTiles > kMaxLevelTiles) {
+        cerr << "Warning: level " << textPath << " must be 1 to " << kMaxLevelTiles << " tiles each way\n";
+        return false;
+    }
+
+    // Unmarked spawns drop in from the top, where the default arena has them
+    if (!playerPlaced) {
+        header.playerSpawn[0] = static_cast<uint16_t>(min<uint32_t>(4, header.widthTiles - 1));
+    }
+    if (!enemyPlaced) {
+        header.enemySpawn[0] = static_cast<uint16_t>(min<uint32_t>(22, header.widthTiles - 1));
+    }
+
+    ofstream out(mapPath, ios::binary | ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    array<uint8_t, kChunkBytes> chunk;
+    for (int chunkY = 0; chunkY < chunksFor(header.heightTiles); ++chunkY) {
+        for (int chunkX = 0; chunkX < chunksFor(header.widthTiles); ++chunkX) {
+            for (int y = 0; y < kChunkTiles; ++y) {
+                const size_t row = static_cast<size_t>(chunkY * kChunkTiles + y);
+                for (int x = 0; x < kChunkTiles; ++x) {
+                    const size_t column = static_cast<size_t>(chunkX * kChunkTiles + x);
+                    const char c = row < rows.size() && column < rows[row].size() ? rows[row][column] : ' ';
+                    const Tile tile = c == '#' ? Tile::Ground : c == '=' ? Tile::Platform : Tile::Empty;
+                    chunk[static_cast<size_t>(y * kChunkTiles + x)] = static_cast<uint8_t>(tile);
+                }
+            }
+            out.write(reinterpret_cast<const char*>(chunk.data()), static_cast<streamsize>(chunk.size()));
+        }
+    }
+    if (!out) {
+        cerr << "Warning: could not write " << mapPath << '\n';
+        return false;
+    }
+    return true;
+}
+
+string levelMapFor(const string& path) {
+    const filesystem::path source(path);
+    if (source.extension() != ".txt") {
+        return path;
+    }
+    const string mapPath = filesystem::path(source).replace_extension(".map").string();
+    error_code error;
+    const bool stale = !filesystem::exists(mapPath, error) ||
+                       filesystem::last_write_time(mapPath, error) < filesystem::last_write_time(source, error);
+    if (stale && !bakeLevel(path, mapPath)) {
+        return string();
+    }
+    return mapPath;
+}
+
+bool loadLevelLayout(const string& mapPath, LevelLayout& layout) {
+    FILE* file = fopen(mapPath.c_str(), "rb");
+    LevelFileHeader header;
+    if (!file || !readHeader(file, header)) {
+        cerr << "Warning: " << mapPath << " is not a level this build can read\n";
+        if (file) {
+            fclose(file);
+        }
+        return false;
+    }
+    layout.widthTiles = static_cast<int>(header.widthTiles);
+    layout.heightTiles = static_cast<int>(header.heightTiles);
+    layout.playerSpawn = spawnPoint(header.playerSpawn);
+    layout.enemySpawn = spawnPoint(header.enemySpawn);
+
+    // One chunk row at a time: a solid tile is a surface when the tile above
+    // it, possibly in the chunk row before, is not solid
+    const int chunksX = chunksFor(header.widthTiles);
+    vector<uint8_t> band(static_cast<size_t>(chunksX) * kChunkBytes);
+    vector<uint8_t> above(static_cast<size_t>(chunksX) * kChunkTiles, 0);
+    vector<vector<uint16_t>> columns(header.widthTiles);
+    bool ok = true;
+    for (int chunkY = 0; ok && chunkY < chunksFor(header.heightTiles); ++chunkY) {
+        ok = fread(band.data(), 1, band.size(), file) == band.size();
+        for (int y = 0; ok && y < kChunkTiles; ++y) {
+            const int row = chunkY * kChunkTiles + y;
+            for (size_t column = 0; column < header.widthTiles; ++column) {
+                const size_t chunk = column / kChunkTiles;
+                const uint8_t tile = band[chunk * kChunkBytes + static_cast<size_t>(y * kChunkTiles) +
+                                          column % kChunkTiles];
+                if (isSolid(tile) && !isSolid(above[column])) {
+                    columns[column].push_back(static_cast<uint16_t>(row));
+                }
+                above[column] = tile;
+            }
+        }
+    }
+    fclose(file);
+    if (!ok) {
+        cerr << "Warning: " << mapPath << " is cut short\n";
+        return false;
+    }
+
+    layout.columnStarts.assign(1, 0);
+    layout.surfaceRows.clear();
+    for (const auto& rows : columns) {
+        layout.surfaceRows.insert(layout.surfaceRows.end(), rows.begin(), rows.end());
+        layout.columnStarts.push_back(static_cast<uint32_t>(layout.surfaceRows.size()));
+    }
+    return true;
+}
+
+TileStreamer::TileStreamer(const string& mapPath, sf::Vector2f viewSize) {
+    file = fopen(mapPath.c_str(), "rb");
+    LevelFileHeader header;
+    if (!file || !readHeader(file, header)) {
+        cerr << "Warning: could not stream tiles from " << mapPath << '\n';
+        if (file) {
+            fclose(file);
+            file = nullptr;
+        }
+        return;
+    }
+    chunksX = chunksFor(header.widthTiles);
+    chunksY = chunksFor(header.heightTiles);
+
+    // Chunks a view can touch at once, plus the ring kept around it
+    constexpr float kChunkPixels = kChunkTiles * kTileSize;
+    const size_t across = static_cast<size_t>(viewSize.x / kChunkPixels) + 2 + 2;
+    const size_t down = static_cast<size_t>(viewSize.y / kChunkPixels) + 2 + 2;
+    slots.resize(across * down);
+    for (Slot& slot : slots) {
+        // Two quads per tile at most: the tile and its top edge
+        slot.mesh.reserve(kChunkBytes * 12);
+    }
+    loader = thread([this] { load(); });
+}
+
+TileStreamer::~TileStreamer() {
+    stopping.store(true, memory_order_release);
+    if (loader.joinable()) {
+        loader.join();
+    }
+    if (file) {
+        fclose(file);
+    }
+}
+
+void TileStreamer::update(const sf::FloatRect& visible) {
+    if (!isOpen()) {
+        return;
+    }
+    arrivals.drain([&](const ChunkData& data) {
+        for (Slot& slot : slots) {
+            // A slot recycled while its read was in flight no longer matches
+            if (slot.inUse && !slot.loaded && slot.coord.x == data.coord.x && slot.coord.y == data.coord.y) {
+                buildMesh(slot, data);
+            }
+        }
+    });
+
+    constexpr float kChunkPixels = kChunkTiles * kTileSize;
+    const int left = max(0, static_cast<int>(visible.position.x / kChunkPixels) - 1);
+    const int top = max(0, static_cast<int>(visible.position.y / kChunkPixels) - 1);
+    const int right = min(chunksX - 1, static_cast<int>((visible.position.x + visible.size.x) / kChunkPixels) + 1);
+    const int bottom = min(chunksY - 1, static_cast<int>((visible.position.y + visible.size.y) / kChunkPixels) + 1);
+    for (Slot& slot : slots) {
+        if (slot.inUse && (slot.coord.x < left || slot.coord.x > right || slot.coord.y < top ||
+                           slot.coord.y > bottom)) {
+            slot.inUse = false;
+        }
+    }
+    for (int y = top; y <= bottom; ++y) {
+        for (int x = left; x <= right; ++x) {
+            const bool resident = any_of(slots.begin(), slots.end(), [&](const Slot& slot) {
+                return slot.inUse && slot.coord.x == x && slot.coord.y == y;
+            });
+            if (resident) {
+                continue;
+            }
+            const auto free = find_if(slots.begin(), slots.end(), [](const Slot& slot) { return !slot.inUse; });
+            // A full queue just means this chunk is asked for next frame
+            if (free == slots.end() || !requests.push(ChunkCoord{x, y})) {
+                return;
+            }
+            free->coord = ChunkCoord{x, y};
+            free->inUse = true;
+            free->loaded = false;
+            free->mesh.clear();
+        }
+    }
+}
+
+int TileStreamer::draw(sf::RenderTarget& target, const sf::FloatRect& visible) const {
+    constexpr float kChunkPixels = kChunkTiles * kTileSize;
+    int drawCalls = 0;
+    for (const Slot& slot : slots) {
+        if (!slot.inUse || !slot.loaded || slot.mesh.empty()) {
+            continue;
+        }
+        const sf::FloatRect bounds({slot.coord.x * kChunkPixels, slot.coord.y * kChunkPixels},
+                                   {kChunkPixels, kChunkPixels});
+        if (bounds.findIntersection(visible)) {
+            target.draw(slot.mesh.data(), slot.mesh.size(), sf::PrimitiveType::Triangles);
+            ++drawCalls;
+        }
+    }
+    return drawCalls;
+}
+
+size_t TileStreamer::residentChunks() const {
+    return static_cast<size_t>(count_if(slots.begin(), slots.end(), [](const Slot& slot) { return slot.loaded; }));
+}
+
+size_t TileStreamer::memoryBytes() const {
+    size_t bytes = sizeof(requests) + sizeof(arrivals);
+    for (const Slot& slot : slots) {
+        bytes += slot.mesh.capacity() * sizeof(sf::Vertex);
+    }
+    return bytes;
+}
+
+void TileStreamer::buildMesh(Slot& slot, const ChunkData& data) {
+    slot.mesh.clear();
+    const sf::Vector2f origin{static_cast<float>(data.coord.x * kChunkTiles * kTileSize),
+                              static_cast<float>(data.coord.y * kChunkTiles * kTileSize)};
+    for (int y = 0; y < kChunkTiles; ++y) {
+        for (int x = 0; x < kChunkTiles; ++x) {
+            const uint8_t tile = data.tiles[static_cast<size_t>(y * kChunkTiles + x)];
+            // The top row's neighbour lives in another chunk; edging it anyway
+            // only costs a thin line where a column crosses a chunk border
+            const bool exposed = y == 0 || !isSolid(data.tiles[static_cast<size_t>((y - 1) * kChunkTiles + x)]);
+            const sf::Vector2f corner = origin + sf::Vector2f{static_cast<float>(x * kTileSize),
+                                                              static_cast<float>(y * kTileSize)};
+            if (tile == static_cast<uint8_t>(Tile::Ground)) {
+                addQuad(slot.mesh, sf::FloatRect(corner, {kTileSize, kTileSize}), kGroundFill);
+                if (exposed) {
+                    addQuad(slot.mesh, sf::FloatRect(corner, {kTileSize, kGroundTopHeight}), kGroundTop);
+                }
+            } else if (tile == static_cast<uint8_t>(Tile::Platform)) {
+                addQuad(slot.mesh, sf::FloatRect(corner, {kTileSize, kPlatformHeight}), kPlatformFill);
+                addQuad(slot.mesh, sf::FloatRect(corner, {kTileSize, kPlatformTopHeight}), kPlatformTop);
+            }
+        }
+    }
+    slot.loaded = true;
+}
+
+void TileStreamer::load() {
+    SessionTrace::instance().nameThread("tile loader");
+    while (!stopping.load(memory_order_acquire)) {
+        ChunkData data;
+        const size_t handled = requests.drain([&](const ChunkCoord& coord) {
+            TraceSpan span("read chunk", "tiles");
+            data.coord = coord;
+            const size_t chunk = static_cast<size_t>(coord.y) * static_cast<size_t>(chunksX) + static_cast<size_t>(coord.x);
+            // A chunk that cannot be read streams in as empty
+            if (fseek(file, static_cast<long>(sizeof(LevelFileHeader) + chunk * kChunkBytes), SEEK_SET) != 0 ||
+                fread(data.tiles.data(), 1, kChunkBytes, file) != kChunkBytes) {
+                data.tiles.fill(0);
+            }
+            // The draw thread empties this every frame
+            while (!arrivals.push(data) && !stopping.load(memory_order_acquire)) {
+                this_thread::sleep_for(kLoaderIdle);
+            }
+        });
+        if (handled == 0) {
+            this_thread::sleep_for(kLoaderIdle);
+        }
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+#include "FixedPoint.hpp"
+#include "SpscQueue.hpp"
+
+constexpr int kTileSize = 32;
+// Chunks are kChunkTiles square, 512 px: the unit the renderer streams
+constexpr int kChunkTiles = 16;
+// Fixed tops out near 32767, and bullets fly a little past the edge
+constexpr int kMaxLevelTiles = 30000 / kTileSize;
+
+enum class Tile : uint8_t {
+    Empty = 0,
+    Ground = 1,    // '#'
+    Platform = 2,  // '='
+};
+
+// What the simulation needs from a level: its size, the spawns and, for
+// every tile column, the tops fighters can stand on. Built by one pass over
+// the file; nothing here grows with the area of the level.
+struct LevelLayout {
+    int widthTiles = 0;
+    int heightTiles = 0;
+    FixedVec2 playerSpawn;  // bottom middle of the spawn tile
+    FixedVec2 enemySpawn;
+    // Column c's surface rows are surfaceRows[columnStarts[c] .. columnStarts[c + 1]), top first
+    vector<uint32_t> columnStarts;
+    vector<uint16_t> surfaceRows;
+
+    Fixed width() const { return Fixed::fromInt(widthTiles * kTileSize); }
+    Fixed height() const { return Fixed::fromInt(heightTiles * kTileSize); }
+    // Top of the first surface under `x` at or below `y`; the bottom of the
+    // level if there is none. Surfaces are one-way: only their tops count.
+    Fixed surfaceBelow(Fixed x, Fixed y) const;
+};
+
+// Turns a text level into the chunked file the game streams. One character
+// per tile: '#' ground, '=' platform, 'P' and 'E' the two spawns, anything
+// else empty. Lines may differ in length.
+bool bakeLevel(const string& textPath, const string& mapPath);
+// The chunked file for `path`, baking it first when `path` is a .txt newer
+// than its .map
+string levelMapFor(const string& path);
+bool loadLevelLayout(const string& mapPath, LevelLayout& layout);
+
+// Keeps the chunks around the camera resident and draws the visible ones.
+// Chunk reads happen on a loader thread; the draw thread only meshes what
+// has arrived. The slot pool is sized from the view once, so memory and
+// draw calls follow the view, not the level.
+class TileStreamer {
+public:
+    TileStreamer(const string& mapPath, sf::Vector2f viewSize);
+    ~TileStreamer();
+    TileStreamer(const TileStreamer&) = delete;
+    TileStreamer& operator=(const TileStreamer&) = delete;
+
+    bool isOpen() const { return loader.joinable(); }
+    // Call once a frame with the camera's rect, before draw()
+    void update(const sf::FloatRect& visible);
+    // Returns the draw calls used: one per visible chunk that has tiles
+    int draw(sf::RenderTarget& target, const sf::FloatRect& visible) const;
+    size_t residentChunks() const;
+    size_t memoryBytes() const;
+
+private:
+    static constexpr size_t kQueueDepth = 32;
+
+    struct ChunkCoord {
+        int x = -1;
+        int y = -1;
+    };
+    struct ChunkData {
+        ChunkCoord coord;
+        array<uint8_t, kChunkTiles * kChunkTiles> tiles{};
+    };
+    struct Slot {
+        ChunkCoord coord;
+        bool inUse = false;
+        bool loaded = false;
+        vector<sf::Vertex> mesh;
+    };
+
+    void buildMesh(Slot& slot, const ChunkData& data);
+    void load();
+
+    FILE* file = nullptr;
+    int chunksX = 0;
+    int chunksY = 0;
+    vector<Slot> slots;
+    SpscQueue<ChunkCoord, kQueueDepth> requests;  // draw thread -> loader
+    SpscQueue<ChunkData, kQueueDepth> arrivals;   // loader -> draw thread
+    atomic<bool> stopping{false};
+    thread loader;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+using namespace std;
+
+// Lock-free triple buffer for one writer thread and one reader thread. The
+// writer fills writeBuffer() and publishes it; the reader picks up the newest
+// published value with acquire() and keeps reading it until the next
+// acquire(). Neither side ever waits on the other, and a reader that falls
+// behind simply skips values.
+template <typename T>
+class TripleBuffer {
+public:
+    T& writeBuffer() { return slots[backIndex]; }
+    // True when writeBuffer() holds a published value the reader never
+    // acquired: the one before the latest publish()
+    bool writeBufferSkipped() const { return backSkipped; }
+
+    void publish() {
+        // The filled slot becomes the shared middle one; whatever was there
+        // (stale or never read) is the next one to write
+        const uint8_t previous = middle.exchange(static_cast<uint8_t>(backIndex | kFreshBit), memory_order_acq_rel);
+        backIndex = previous & kIndexMask;
+        backSkipped = (previous & kFreshBit) != 0;
+    }
+
+    // True when a newer value was picked up
+    bool acquire() {
+        if (!(middle.load(memory_order_relaxed) & kFreshBit)) {
+            return false;
+        }
+        const uint8_t previous = middle.exchange(frontIndex, memory_order_acq_rel);
+        frontIndex = previous & kIndexMask;
+        return true;
+    }
+
+    const T& read() const { return slots[frontIndex]; }
+
+private:
+    static constexpr uint8_t kIndexMask = 0x3;
+    static constexpr uint8_t kFreshBit = 0x4;
+
+    array<T, 3> slots{};
+    uint8_t backIndex = 0;
+    bool backSkipped = false;
+    uint8_t frontIndex = 1;
+    alignas(64) atomic<uint8_t> middle{2};
+};